@@ -1,44 +1,90 @@
+import heapq
 import json
+import queue
 import socket
 import struct
+import threading
+import zlib
+from collections import deque
+from concurrent.futures import ThreadPoolExecutor
+from itertools import chain
 from typing import Any
 
 import config
 
+try:
+    import msgpack
+except ImportError:  # optional: JSON is always available
+    msgpack = None
+
 
 class CppClient:
     """Python client for the C++ VectorDB server.
 
-    Uses length-prefixed framing (4-byte big-endian uint32 + JSON payload)
-    over a TCP socket to communicate with the server.
+    Uses length-prefixed framing (4-byte big-endian uint32 + payload) over a
+    TCP socket, or a Unix domain socket when socket_path is set (the server
+    must then run with --unix PATH), to communicate with the server. The
+    payload is MessagePack when the msgpack package is installed (and
+    encoding allows it), else JSON. The server detects the encoding of each
+    request and answers in the same one, so either works against any
+    server build.
+
+    Connections are persistent: the server serves any number of framed
+    requests per socket, so finished sockets go back to a small pool and
+    are reused by later calls. With pool_size=0 every request opens and
+    closes its own connection.
     """
 
-    def __init__(self, host: str | None = None, port: int | None = None):
+    def __init__(
+        self,
+        host: str | None = None,
+        port: int | None = None,
+        pool_size: int | None = None,
+        encoding: str | None = None,
+        socket_path: str | None = None,
+    ):
         self.host = host or config.CPP_SERVER_HOST
         self.port = port or config.CPP_SERVER_PORT
+        self.socket_path = config.CPP_SERVER_SOCKET if socket_path is None else socket_path
+        self.pool_size = config.CPP_SERVER_POOL_SIZE if pool_size is None else pool_size
+        encoding = encoding or config.CPP_SERVER_ENCODING
+        if encoding not in ("json", "msgpack"):
+            raise ValueError(f"Unknown encoding: {encoding}")
+        self.encoding = "msgpack" if encoding == "msgpack" and msgpack is not None else "json"
+        self._pool: list[socket.socket] = []
+        self._pool_lock = threading.Lock()
 
     def connect(self) -> bool:
         """Verify the C++ server is reachable (probe connection, then close).
 
-        The server handles one request per connection, so we don't keep
-        a persistent socket. Each store/search call opens its own connection.
+        Request sockets are opened lazily by the first store/search call.
         """
         if not self.is_alive():
-            print(f"  [ERROR] Cannot connect to cpp_server at {self.host}:{self.port}")
+            print(f"  [ERROR] Cannot connect to cpp_server at {self.address}")
             print(f"  Start it first: ./cpp_server/build/vectordb_server")
             return False
         return True
 
+    @property
+    def address(self) -> str:
+        """Human-readable server address, for messages."""
+        if self.socket_path:
+            return f"unix:{self.socket_path}"
+        return f"{self.host}:{self.port}"
+
     def close(self):
-        """No-op. Connections are per-request; kept for interface compatibility."""
-        pass
+        """Close all pooled connections. The client stays usable afterwards."""
+        with self._pool_lock:
+            pooled, self._pool = self._pool, []
+        for sock in pooled:
+            sock.close()
 
     def is_alive(self) -> bool:
         """Check if the server is reachable by opening a fresh connection."""
         try:
-            sock = socket.socket(socket.AF_INET, socket.SOCK_STREAM)
+            sock = self._new_socket()
             sock.settimeout(2.0)
-            sock.connect((self.host, self.port))
+            sock.connect(self._connect_address())
             sock.close()
             return True
         except (ConnectionRefusedError, OSError):
@@ -50,9 +96,11 @@ class CppClient:
         doc_id: str,
         text: str,
         metadata: dict[str, Any] | None = None,
+        content_hash: str | None = None,
     ) -> dict:
         """Send a store request to the C++ server.
 
+        ``content_hash`` is kept with the chunk for :meth:`diff_chunks`.
         Returns the server response dict (e.g. {"status": "ok"}).
         """
         request = {
@@ -62,17 +110,54 @@ class CppClient:
             "text": text,
             "metadata": metadata or {},
         }
+        if content_hash is not None:
+            request["content_hash"] = content_hash
         return self._send_request(request)
 
+    def store_chunks(self, chunks: list[dict[str, Any]]) -> int:
+        """Store several chunks with one store_batch request.
+
+        Each chunk dict has chunk_id, doc_id, text and optional metadata
+        and content_hash.
+        The server embeds the batch in parallel and inserts it atomically:
+        either every chunk is stored or the request fails. Keep batches
+        well under the 10 MB frame limit.
+
+        Returns the number of chunks stored.
+        """
+        records = []
+        for c in chunks:
+            record = {
+                "chunk_id": c["chunk_id"],
+                "doc_id": c["doc_id"],
+                "text": c["text"],
+                "metadata": c.get("metadata") or {},
+            }
+            if c.get("content_hash") is not None:
+                record["content_hash"] = c["content_hash"]
+            records.append(record)
+        response = self._send_request({"action": "store_batch", "chunks": records})
+        return int(response.get("stored", 0))
+
     def search(
         self,
         query: str,
         top_k: int = 5,
         doc_id: str = "",
+        fields: list[str] | None = None,
+        approximate: bool = False,
+        ef_search: int | None = None,
     ) -> list[dict]:
         """Send a search request to the C++ server.
 
-        Returns a list of result dicts, each with chunk_id, score, and text.
+        Returns a list of result dicts, each with chunk_id, score, text, and
+        metadata. ``fields`` limits each result to the named keys; an entry
+        such as ``"metadata.page_start"`` keeps just that metadata key.
+
+        ``approximate`` uses the server's HNSW graph (when started with
+        ``--hnsw``) for unfiltered searches: faster on large stores but may
+        miss some of the best matches. ``ef_search`` widens its beam for
+        better recall.
         """
         request: dict[str, Any] = {
             "action": "search",
@@ -81,39 +166,190 @@ class CppClient:
         }
         if doc_id:
             request["doc_id"] = doc_id
+        if fields is not None:
+            request["fields"] = list(fields)
+        if approximate:
+            request["mode"] = "approx"
+            if ef_search is not None:
+                request["ef_search"] = ef_search
+
+        response = self._send_request(request)
+        return response.get("results", [])
+
+    def search_batch(
+        self,
+        queries: list[str],
+        top_k: int = 5,
+        doc_id: str = "",
+        fields: list[str] | None = None,
+    ) -> list[list[dict]]:
+        """Run several searches in one request.
+
+        Returns one result list per query, in order, each shaped as
+        :meth:`search` returns. The server scores filtered searches for a
+        whole block of queries in a single pass over the document's chunks,
+        so this is much cheaper than calling :meth:`search` per query when
+        ``doc_id`` is set.
+        """
+        request: dict[str, Any] = {
+            "action": "search_batch",
+            "queries": list(queries),
+            "top_k": top_k,
+        }
+        if doc_id:
+            request["doc_id"] = doc_id
+        if fields is not None:
+            request["fields"] = list(fields)
 
         response = self._send_request(request)
         return response.get("results", [])
 
+    def store_pipeline(self, batch_size: int = 64, max_pending: int = 256,
+                       window: int = 4) -> "StorePipeline":
+        """Open a :class:`StorePipeline` streaming stores to this server."""
+        return StorePipeline(self, batch_size, max_pending, window)
+
+    def diff_chunks(
+        self,
+        doc_id: str,
+        chunks: list[tuple[str, str]],
+        fields: list[str] | None = None,
+    ) -> dict[str, list]:
+        """Compare (chunk_id, content_hash) pairs with what is stored.
+
+        Returns a dict with ``changed``: the chunk_ids not stored with that
+        hash (absent, stored with another, or with none); ``unchanged``: one
+        dict per chunk that matched, with its chunk_id plus the ``fields``
+        asked for, as in :meth:`search`; and ``stale``: chunk_ids of
+        ``doc_id`` that are not in ``chunks``.
+        """
+        request: dict[str, Any] = {
+            "action": "diff_chunks",
+            "doc_id": doc_id,
+            "chunks": [{"chunk_id": chunk_id, "content_hash": content_hash}
+                       for chunk_id, content_hash in chunks],
+        }
+        if fields is not None:
+            request["fields"] = list(fields)
+
+        response = self._send_request(request)
+        return {key: response.get(key, []) for key in ("changed", "unchanged", "stale")}
+
+    def delete_doc(self, doc_id: str) -> int:
+        """Remove every chunk of a document. Returns how many were removed."""
+        response = self._send_request({"action": "delete_doc", "doc_id": doc_id})
+        return int(response.get("deleted", 0))
+
+    def delete_chunk(self, chunk_id: str) -> bool:
+        """Remove one chunk. Returns False if it was not stored."""
+        response = self._send_request({"action": "delete_chunk", "chunk_id": chunk_id})
+        return int(response.get("deleted", 0)) > 0
+
+    def stats(self) -> dict[str, Any]:
+        """Server counters: per-action latency percentiles, store size,
+        memory, connections and cache hit rates."""
+        response = self._send_request({"action": "stats"})
+        response.pop("status", None)
+        return response
+
     # ------------------------------------------------------------------
     # Internal helpers
     # ------------------------------------------------------------------
 
     def _send_request(self, request: dict) -> dict:
-        """Open a connection, send one request, read the response, close."""
-        sock = socket.socket(socket.AF_INET, socket.SOCK_STREAM)
-        sock.settimeout(30.0)
+        """Send one request over a pooled connection and return the response.
+
+        A pooled socket may have been closed by the server since its last
+        use; in that case the request is retried once on a fresh connection.
+        Both store and search are idempotent, so the retry is safe.
+        """
+        sock, reused = self._acquire()
         try:
-            sock.connect((self.host, self.port))
-            payload = json.dumps(request).encode("utf-8")
+            response = self._exchange(sock, request)
+        except ConnectionError:
+            sock.close()
+            if not reused:
+                raise
+            sock = self._open_socket()
+            try:
+                response = self._exchange(sock, request)
+            except BaseException:
+                sock.close()
+                raise
+        except BaseException:
+            sock.close()
+            raise
 
-            # Write: 4-byte big-endian length + payload
-            sock.sendall(struct.pack("!I", len(payload)) + payload)
+        # The full response frame was read, so the socket is reusable even
+        # if the server reported an error.
+        self._release(sock)
 
-            # Read: 4-byte big-endian length header
-            length_buf = self._recv_exact(sock, 4)
-            length = struct.unpack("!I", length_buf)[0]
+        if response.get("status") == "error":
+            raise RuntimeError(f"Server error: {response.get('message', 'unknown')}")
 
-            # Read: payload
-            response_buf = self._recv_exact(sock, length)
-            response = json.loads(response_buf.decode("utf-8"))
+        return response
 
-            if response.get("status") == "error":
-                raise RuntimeError(f"Server error: {response.get('message', 'unknown')}")
+    def _new_socket(self) -> socket.socket:
+        family = socket.AF_UNIX if self.socket_path else socket.AF_INET
+        return socket.socket(family, socket.SOCK_STREAM)
 
-            return response
-        finally:
+    def _connect_address(self) -> str | tuple[str, int]:
+        return self.socket_path if self.socket_path else (self.host, self.port)
+
+    def _open_socket(self) -> socket.socket:
+        sock = self._new_socket()
+        sock.settimeout(30.0)
+        try:
+            sock.connect(self._connect_address())
+        except BaseException:
             sock.close()
+            raise
+        return sock
+
+    def _acquire(self) -> tuple[socket.socket, bool]:
+        """Return (socket, reused): a pooled socket if available, else a new one."""
+        with self._pool_lock:
+            if self._pool:
+                return self._pool.pop(), True
+        return self._open_socket(), False
+
+    def _release(self, sock: socket.socket):
+        with self._pool_lock:
+            if len(self._pool) < self.pool_size:
+                self._pool.append(sock)
+                return
+        sock.close()
+
+    def _exchange(self, sock: socket.socket, request: dict) -> dict:
+        """Write one framed request and read its framed response."""
+        self._write_frame(sock, request)
+        return self._read_frame(sock)
+
+    def _write_frame(self, sock: socket.socket, request: dict):
+        # 4-byte big-endian length + payload
+        payload = self._encode(request)
+        sock.sendall(struct.pack("!I", len(payload)) + payload)
+
+    def _read_frame(self, sock: socket.socket) -> dict:
+        length_buf = self._recv_exact(sock, 4)
+        length = struct.unpack("!I", length_buf)[0]
+        return self._decode(self._recv_exact(sock, length))
+
+    def _encode(self, request: dict) -> bytes:
+        if self.encoding == "msgpack":
+            return msgpack.packb(request, use_bin_type=True)
+        return json.dumps(request).encode("utf-8")
+
+    @staticmethod
+    def _decode(payload: bytes) -> dict:
+        """Decode a response in whichever encoding the server used.
+
+        JSON objects start with '{' (possibly after whitespace); MessagePack
+        maps never do.
+        """
+        if payload.lstrip()[:1] == b"{" or msgpack is None:
+            return json.loads(payload.decode("utf-8"))
+        return msgpack.unpackb(payload, raw=False)
 
     @staticmethod
     def _recv_exact(sock: socket.socket, n: int) -> bytes:
@@ -125,3 +361,357 @@ class CppClient:
                 raise ConnectionError("Connection closed while reading response")
             buf.extend(chunk)
         return bytes(buf)
+
+
+class StorePipeline:
+    """Streams chunk records to the server while the caller keeps working.
+
+    put() queues a record and returns at once; a background thread sends
+    whatever has queued up as one store_batch request (at most batch_size
+    chunks) on its own connection. Up to ``window`` batches are in flight
+    unacknowledged: the server answers pipelined requests in order and
+    echoes each request's id, so responses are matched as they arrive.
+    When ``max_pending`` records are waiting, put() blocks until the
+    sender catches up.
+
+    Stores never raise from here: a batch the server rejects, or that was
+    in flight when the connection failed, is handed back by close() for
+    the caller to retry or report. Should the sender itself fail, every
+    record it still held, and any put() after, is handed back the same
+    way and put() raises from then on; the error is kept in ``error``.
+    """
+
+    _CLOSE = object()
+
+    def __init__(self, client: CppClient, batch_size: int = 64, max_pending: int = 256,
+                 window: int = 4):
+        self._client = client
+        self._batch_size = max(1, batch_size)
+        self._window = max(1, window)
+        self._queue: queue.Queue = queue.Queue(maxsize=max(1, max_pending))
+        self._sock: socket.socket | None = None
+        self._in_flight: deque[tuple[int, list[dict]]] = deque()
+        self._unsent: list[dict] = []
+        self._next_id = 0
+        self._closed = False
+        self._stopped = False
+        self.stored = 0
+        self.failed: list[dict] = []
+        self.error: Exception | None = None
+        self._thread = threading.Thread(target=self._run, name="store-pipeline", daemon=True)
+        self._thread.start()
+
+    def put(self, record: dict):
+        """Queue one record shaped as for CppClient.store_chunks()."""
+        if self._closed or self._stopped:
+            raise RuntimeError("StorePipeline is closed")
+        self._queue.put(record)
+
+    def close(self) -> tuple[int, list[dict]]:
+        """Send what is queued, wait for every response and return
+        (stored count, records that failed)."""
+        if not self._closed:
+            self._closed = True
+            self._queue.put(self._CLOSE)
+            self._thread.join()
+        return self.stored, self.failed
+
+    def __enter__(self) -> "StorePipeline":
+        return self
+
+    def __exit__(self, *exc):
+        self.close()
+
+    def _run(self):
+        try:
+            self._pump()
+        except Exception as e:
+            self.error = e
+            self._stopped = True
+            self.failed.extend(self._unsent)
+            try:
+                self._drop_connection()
+            except OSError:
+                self._sock = None
+            # Keep taking records until close(), so neither a put() racing
+            # the stop nor one blocked on a full queue waits forever.
+            while True:
+                record = self._queue.get()
+                if record is self._CLOSE:
+                    break
+                self.failed.append(record)
+
+    def _pump(self):
+        done = False
+        while not done:
+            record = self._queue.get()
+            batch: list[dict] = []
+            # Take whatever else is already waiting, so batches grow when
+            # the producer outpaces the server and stay small otherwise.
+            while record is not self._CLOSE:
+                batch.append(record)
+                if len(batch) >= self._batch_size:
+                    break
+                try:
+                    record = self._queue.get_nowait()
+                except queue.Empty:
+                    break
+            done = record is self._CLOSE
+            if batch:
+                self._unsent = batch
+                self._send(batch)
+                self._unsent = []
+        while self._in_flight:
+            self._receive()
+        if self._sock is not None:
+            self._sock.close()
+            self._sock = None
+
+    def _send(self, batch: list[dict]):
+        while len(self._in_flight) >= self._window:
+            self._receive()
+        request_id = self._next_id
+        self._next_id += 1
+        request = {"action": "store_batch", "id": request_id, "chunks": batch}
+        try:
+            if self._sock is None:
+                self._sock = self._client._open_socket()
+            self._client._write_frame(self._sock, request)
+        except (OSError, ValueError, TypeError):
+            self.failed.extend(batch)
+            self._drop_connection()
+            return
+        self._in_flight.append((request_id, batch))
+
+    def _receive(self):
+        # The batch stays in flight until answered, so a failure here
+        # reports it along with the rest.
+        request_id, batch = self._in_flight[0]
+        try:
+            response = self._client._read_frame(self._sock)
+            if response.get("id") != request_id:
+                raise ConnectionError("Pipelined response out of order")
+        except (OSError, ValueError):
+            # Anything unanswered may or may not have been stored; report
+            # it all so the caller's retry (stores are idempotent) settles it.
+            self._drop_connection()
+            return
+        self._in_flight.popleft()
+        if response.get("status") == "error":
+            self.failed.extend(batch)
+        else:
+            self.stored += int(response.get("stored", len(batch)))
+
+    def _drop_connection(self):
+        for _, batch in self._in_flight:
+            self.failed.extend(batch)
+        self._in_flight.clear()
+        if self._sock is not None:
+            self._sock.close()
+            self._sock = None
+
+
+def make_client() -> "CppClient | ShardedClient":
+    """The client the configuration asks for: a ShardedClient when
+    CPP_SERVER_SHARDS is set, else a CppClient."""
+    if config.CPP_SERVER_SHARDS:
+        return ShardedClient.from_spec(config.CPP_SERVER_SHARDS)
+    return CppClient()
+
+
+class ShardedClient:
+    """Spreads the store over several vectordb_server instances.
+
+    Each document lives on one shard, picked by a stable hash of its
+    doc_id. Storing or deleting a document's chunks, or a search filtered
+    to it, touches that shard only. Unfiltered searches go to every shard
+    in parallel and the per-shard top-k lists are merged by score, so each
+    shard holds and scans only its share of the chunks.
+
+    The shard list decides where documents live: adding, removing or
+    reordering shards strands the documents already stored (there is no
+    rebalancing).
+
+    Offers the same methods as CppClient.
+    """
+
+    def __init__(self, shards: list[CppClient]):
+        if not shards:
+            raise ValueError("ShardedClient needs at least one shard")
+        self.shards = list(shards)
+        self._fanout = ThreadPoolExecutor(max_workers=len(self.shards),
+                                          thread_name_prefix="shard")
+
+    @classmethod
+    def from_spec(cls, spec: str, **kwargs) -> "ShardedClient":
+        """Shards from "host:port,host:port,unix:PATH"; kwargs (pool_size,
+        encoding) are passed to each shard's CppClient."""
+        shards = []
+        for item in spec.split(","):
+            item = item.strip()
+            if not item:
+                continue
+            if item.startswith("unix:"):
+                shards.append(CppClient(socket_path=item[len("unix:"):], **kwargs))
+                continue
+            host, sep, port = item.rpartition(":")
+            if not sep or not host or not port.isdigit():
+                raise ValueError(f"Invalid shard address: {item!r} (expected host:port)")
+            shards.append(CppClient(host=host, port=int(port), socket_path="", **kwargs))
+        return cls(shards)
+
+    def shard_index(self, doc_id: str) -> int:
+        return zlib.crc32(doc_id.encode("utf-8")) % len(self.shards)
+
+    def shard_for(self, doc_id: str) -> CppClient:
+        return self.shards[self.shard_index(doc_id)]
+
+    def connect(self) -> bool:
+        """Verify every shard is reachable (reports each one that is not)."""
+        return all([shard.connect() for shard in self.shards])
+
+    @property
+    def address(self) -> str:
+        return ",".join(shard.address for shard in self.shards)
+
+    def close(self):
+        for shard in self.shards:
+            shard.close()
+
+    def is_alive(self) -> bool:
+        return all(self._each(lambda shard: shard.is_alive()))
+
+    def store_chunk(
+        self,
+        chunk_id: str,
+        doc_id: str,
+        text: str,
+        metadata: dict[str, Any] | None = None,
+        content_hash: str | None = None,
+    ) -> dict:
+        return self.shard_for(doc_id).store_chunk(chunk_id, doc_id, text, metadata,
+                                                  content_hash)
+
+    def store_chunks(self, chunks: list[dict[str, Any]]) -> int:
+        """Store chunks on their shards, one store_batch per shard, sent in
+        parallel. Raises if any shard fails; the others may have stored."""
+        groups: dict[int, list[dict[str, Any]]] = {}
+        for chunk in chunks:
+            groups.setdefault(self.shard_index(chunk["doc_id"]), []).append(chunk)
+        stored = self._fanout.map(lambda item: self.shards[item[0]].store_chunks(item[1]),
+                                  groups.items())
+        return sum(stored)
+
+    def store_pipeline(self, batch_size: int = 64, max_pending: int = 256,
+                       window: int = 4) -> "ShardedStorePipeline":
+        return ShardedStorePipeline(self, batch_size, max_pending, window)
+
+    def search(
+        self,
+        query: str,
+        top_k: int = 5,
+        doc_id: str = "",
+        fields: list[str] | None = None,
+        approximate: bool = False,
+        ef_search: int | None = None,
+    ) -> list[dict]:
+        if doc_id:
+            return self.shard_for(doc_id).search(query, top_k, doc_id, fields,
+                                                 approximate, ef_search)
+        shard_fields, drop_score = self._with_score(fields)
+        per_shard = self._each(lambda shard: shard.search(
+            query, top_k, "", shard_fields, approximate, ef_search))
+        return self._merge(per_shard, top_k, drop_score)
+
+    def search_batch(
+        self,
+        queries: list[str],
+        top_k: int = 5,
+        doc_id: str = "",
+        fields: list[str] | None = None,
+    ) -> list[list[dict]]:
+        if doc_id:
+            return self.shard_for(doc_id).search_batch(queries, top_k, doc_id, fields)
+        shard_fields, drop_score = self._with_score(fields)
+        per_shard = self._each(lambda shard: shard.search_batch(
+            queries, top_k, "", shard_fields))
+        return [self._merge(lists, top_k, drop_score) for lists in zip(*per_shard)]
+
+    def diff_chunks(
+        self,
+        doc_id: str,
+        chunks: list[tuple[str, str]],
+        fields: list[str] | None = None,
+    ) -> dict[str, list]:
+        return self.shard_for(doc_id).diff_chunks(doc_id, chunks, fields)
+
+    def delete_doc(self, doc_id: str) -> int:
+        return self.shard_for(doc_id).delete_doc(doc_id)
+
+    def delete_chunk(self, chunk_id: str) -> bool:
+        """A chunk id does not name its document, so every shard is asked."""
+        return any(self._each(lambda shard: shard.delete_chunk(chunk_id)))
+
+    def stats(self) -> dict[str, Any]:
+        """Each shard's stats(), with its address."""
+        per_shard = self._each(lambda shard: shard.stats())
+        return {"shards": [dict(stats, address=shard.address)
+                           for shard, stats in zip(self.shards, per_shard)]}
+
+    def _each(self, call) -> list:
+        """call(shard) for every shard, in parallel; results in shard order."""
+        if len(self.shards) == 1:
+            return [call(self.shards[0])]
+        return list(self._fanout.map(call, self.shards))
+
+    @staticmethod
+    def _with_score(fields: list[str] | None) -> tuple[list[str] | None, bool]:
+        """Fields to ask shards for: merging needs the score even when the
+        caller did not ask for it, in which case it is dropped after."""
+        if fields is None or "score" in fields:
+            return fields, False
+        return list(fields) + ["score"], True
+
+    @staticmethod
+    def _merge(per_shard: list[list[dict]], top_k: int, drop_score: bool) -> list[dict]:
+        # nlargest is stable, so equal scores keep shard order.
+        merged = heapq.nlargest(top_k, chain.from_iterable(per_shard),
+                                key=lambda hit: hit["score"])
+        if drop_score:
+            for hit in merged:
+                hit.pop("score", None)
+        return merged
+
+
+class ShardedStorePipeline:
+    """StorePipeline for a ShardedClient: one per shard, opened on first
+    use, with each record routed by its doc_id."""
+
+    def __init__(self, client: ShardedClient, batch_size: int = 64,
+                 max_pending: int = 256, window: int = 4):
+        self._client = client
+        self._options = (batch_size, max_pending, window)
+        self._pipelines: dict[int, StorePipeline] = {}
+
+    def put(self, record: dict):
+        index = self._client.shard_index(record["doc_id"])
+        pipeline = self._pipelines.get(index)
+        if pipeline is None:
+            pipeline = self._client.shards[index].store_pipeline(*self._options)
+            self._pipelines[index] = pipeline
+        pipeline.put(record)
+
+    def close(self) -> tuple[int, list[dict]]:
+        stored = 0
+        failed: list[dict] = []
+        for pipeline in self._pipelines.values():
+            shard_stored, shard_failed = pipeline.close()
+            stored += shard_stored
+            failed.extend(shard_failed)
+        return stored, failed
+
+    def __enter__(self) -> "ShardedStorePipeline":
+        return self
+
+    def __exit__(self, *exc):
+        self.close()
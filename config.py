@@ -15,18 +15,41 @@ load_dotenv()
 GROQ_API_KEY = os.getenv("GROQ_API_KEY", "")
 GROQ_MODEL_TRANSLATE = os.getenv("GROQ_MODEL_TRANSLATE", "llama-3.1-8b-instant")
 GROQ_MODEL_QA = os.getenv("GROQ_MODEL_QA", "llama-3.3-70b-versatile")
+# Translation requests in flight at once; 1 = one at a time with a fixed delay
+TRANSLATE_CONCURRENCY = int(os.getenv("TRANSLATE_CONCURRENCY", "1"))
+# Account limits concurrent translation stays under; 0 = unlimited
+GROQ_REQUESTS_PER_MIN = int(os.getenv("GROQ_REQUESTS_PER_MIN", "30"))
+GROQ_TOKENS_PER_MIN = int(os.getenv("GROQ_TOKENS_PER_MIN", "6000"))
 
 # =============================================================================
 # C++ Server Configuration
 # =============================================================================
 CPP_SERVER_HOST = os.getenv("CPP_SERVER_HOST", "localhost")
 CPP_SERVER_PORT = int(os.getenv("CPP_SERVER_PORT", "50051"))
+# Unix domain socket path; when set, used instead of host/port (server: --unix PATH)
+CPP_SERVER_SOCKET = os.getenv("CPP_SERVER_SOCKET", "")
+# Comma-separated vectordb_server shards ("host:port" or "unix:PATH"); when set,
+# documents are partitioned across them by doc_id instead of using one server
+CPP_SERVER_SHARDS = os.getenv("CPP_SERVER_SHARDS", "")
+# Idle persistent connections kept per CppClient; 0 = one connection per request
+CPP_SERVER_POOL_SIZE = int(os.getenv("CPP_SERVER_POOL_SIZE", "4"))
+# Request encoding: "msgpack" (used when the msgpack package is installed) or "json"
+CPP_SERVER_ENCODING = os.getenv("CPP_SERVER_ENCODING", "msgpack")
+# Store each chunk as soon as it is translated, overlapping translation with
+# VectorDB writes; "0" stores all originals first and updates them afterwards
+CPP_SERVER_STREAM_STORE = os.getenv("CPP_SERVER_STREAM_STORE", "1") == "1"
+# On re-processing a stored document, translate and store only the chunks whose
+# text (or translation settings) changed; "0" redoes the whole document
+CPP_SERVER_INCREMENTAL = os.getenv("CPP_SERVER_INCREMENTAL", "1") == "1"
 
 # =============================================================================
 # Chunking Configuration
 # =============================================================================
 CHUNK_TOKEN_SIZE = int(os.getenv("CHUNK_TOKEN_SIZE", "1500"))
 CHUNK_OVERLAP_SENTENCES = int(os.getenv("CHUNK_OVERLAP_SENTENCES", "2"))
+# Processes extracting PDF pages; above 1, page ranges are extracted in parallel
+# and chunks stream into translation while the rest of the file is parsed
+PARSE_WORKERS = int(os.getenv("PARSE_WORKERS", "1"))
 
 # =============================================================================
 # Supported Languages
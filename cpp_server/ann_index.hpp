@@ -0,0 +1,64 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "top_k.hpp"
+
+// Similarity of the row in a slot to the current query (or to the row
+// being inserted). Higher is closer.
+using SlotScorer = std::function<float(uint32_t slot)>;
+
+// Similarity of the rows in two slots. Callers ask about one `from` slot
+// at a time, so an implementation may keep per-from state between calls.
+using PairScorer = std::function<float(uint32_t from, uint32_t to)>;
+
+// Approximate nearest-neighbour index over VectorDB slots. It never sees
+// embeddings: every similarity comes from the scorer it is handed, so an
+// implementation works unchanged over float or quantized rows.
+//
+// Not thread-safe; VectorDB calls insert(), apply_remove(), load() and
+// clear() under its writer lock and search(), plan_remove() and save()
+// under its reader lock.
+class AnnIndex {
+public:
+    virtual ~AnnIndex() = default;
+
+    // Add the row stored in slot; score rates existing slots against it.
+    virtual void insert(uint32_t slot, const SlotScorer& score) = 0;
+
+    // Push the best positive-scoring slots found for which accept() holds
+    // into top. effort trades speed for recall; 0 picks the default.
+    virtual void search(const SlotScorer& score, size_t effort,
+                        const std::function<bool(uint32_t)>& accept, TopK& top) const = 0;
+
+    // Removing slots takes two steps, so that the costly one does not
+    // block searches. plan_remove() works out, without changing the index,
+    // how to relink the nodes that point at the slots so the graph stays
+    // navigable; score rates the candidates. apply_remove() then drops the
+    // slots and installs the new links, and the slots may be inserted
+    // again. Nothing may change the index in between.
+    struct RemovalPlan {
+        virtual ~RemovalPlan() = default;
+    };
+    virtual std::unique_ptr<RemovalPlan> plan_remove(const std::vector<uint32_t>& slots,
+                                                     const PairScorer& score) const = 0;
+    virtual void apply_remove(RemovalPlan& plan) = 0;
+
+    // Forget every slot.
+    virtual void clear() = 0;
+
+    // Append the index to out with slot s renumbered to renumber[s].
+    // Slots renumbered to UINT32_MAX are left out and, like a removal,
+    // linked around with score.
+    virtual void save(std::string& out, const std::vector<uint32_t>& renumber,
+                      const PairScorer& score) const = 0;
+
+    // Replace the index by one save() wrote, over slots [0, slots).
+    // Returns false, leaving the index empty, if the data is malformed.
+    virtual bool load(const char* data, size_t n, size_t slots) = 0;
+};
@@ -0,0 +1,203 @@
+// Microbenchmarks for the store's hot paths: embedding, the dot-product
+// kernels, whole searches across corpus sizes, filter selectivities, k
+// and batch sizes, and top-k selection on its own. Run from the build directory:
+//
+//     ./vectordb_bench --benchmark_filter=Search
+//
+// Corpora are synthetic (bench/corpus.hpp) and seeded, so numbers are
+// comparable between builds on the same machine.
+
+#include <benchmark/benchmark.h>
+
+#include <memory>
+#include <string>
+#include <tuple>
+#include <vector>
+
+#include "corpus.hpp"
+#include "embedder.hpp"
+#include "simd.hpp"
+#include "top_k.hpp"
+#include "vector_db.hpp"
+
+namespace {
+
+// Words per stored chunk and per query; close to what parse.py's chunker
+// and typical questions produce.
+constexpr size_t CHUNK_WORDS = 120;
+constexpr size_t QUERY_WORDS = 6;
+
+// Queries cycled through, so neither the CPU caches nor the branch
+// predictor learn a single one.
+constexpr size_t NUM_QUERIES = 64;
+
+// A corpus of `entries` chunks of which `filtered_percent` belong to doc
+// "hot" (the rest spread over 100 others). Only the latest shape is kept:
+// benchmarks run in order, so each one builds it once at most.
+const VectorDB& corpus(size_t entries, size_t filtered_percent = 1, bool quantize = false) {
+    using Key = std::tuple<size_t, size_t, bool>;
+    static Key built_key;
+    static std::unique_ptr<VectorDB> db;
+    Key key{entries, filtered_percent, quantize};
+    if (!db || built_key != key) {
+        db.reset();
+        built_key = key;
+        VectorDBOptions options;
+        options.quantize = quantize;
+        db = std::make_unique<VectorDB>(options);
+        SyntheticText text(entries);
+        std::vector<VectorEntry> batch;
+        for (size_t i = 0; i < entries; ++i) {
+            VectorEntry entry;
+            entry.chunk_id = "c" + std::to_string(i);
+            entry.doc_id = i * 100 < filtered_percent * entries
+                ? "hot" : "d" + std::to_string(i % 100);
+            entry.text = text.words(CHUNK_WORDS);
+            entry.metadata = {{"page", i % 300}};
+            entry.embedding = embed(entry.text);
+            batch.push_back(std::move(entry));
+        }
+        db->store_batch(std::move(batch));
+    }
+    return *db;
+}
+
+const std::vector<SparseVector>& queries() {
+    static const std::vector<SparseVector> embedded = [] {
+        SyntheticText text(7);
+        std::vector<SparseVector> out;
+        for (size_t i = 0; i < NUM_QUERIES; ++i) {
+            out.push_back(embed(text.words(QUERY_WORDS)));
+        }
+        return out;
+    }();
+    return embedded;
+}
+
+void run_searches(benchmark::State& state, const VectorDB& db, int top_k,
+                  const std::string& filter, SearchMode mode, size_t scanned) {
+    const auto& qs = queries();
+    size_t q = 0;
+    size_t hits = 0;
+    for (auto _ : state) {
+        db.search(qs[q++ % qs.size()], top_k, filter, mode, 0,
+                  [&](const SearchHit&) { ++hits; });
+    }
+    benchmark::DoNotOptimize(hits);
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * scanned));
+}
+
+// ---------------------------------------------------------------------------
+// Embedding
+// ---------------------------------------------------------------------------
+
+void BM_Embed(benchmark::State& state) {
+    SyntheticText text(1);
+    std::string input = text.words(static_cast<size_t>(state.range(0)));
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(embed(input));
+    }
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * input.size()));
+}
+BENCHMARK(BM_Embed)->Arg(QUERY_WORDS)->Arg(CHUNK_WORDS)->Arg(1000);
+
+// ---------------------------------------------------------------------------
+// Kernels
+// ---------------------------------------------------------------------------
+
+void BM_SimdDot(benchmark::State& state) {
+    auto n = static_cast<size_t>(state.range(0));
+    std::vector<float> a(n, 0.5f), b(n, 0.25f);
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(simd::dot(a.data(), b.data(), n));
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * n));
+    state.SetLabel(simd::active_kernel());
+}
+BENCHMARK(BM_SimdDot)->Arg(64)->Arg(512)->Arg(EMBED_DIM);
+
+// Selection alone: n scores pushed into a TopK(k).
+void BM_TopK(benchmark::State& state) {
+    auto k = static_cast<size_t>(state.range(0));
+    constexpr size_t n = 100000;
+    SyntheticText rng(3);
+    std::vector<float> scores(n);
+    for (float& s : scores) {
+        s = static_cast<float>(rng.unit());
+    }
+    for (auto _ : state) {
+        TopK top(k);
+        for (size_t i = 0; i < n; ++i) {
+            top.push(scores[i], static_cast<uint32_t>(i));
+        }
+        benchmark::DoNotOptimize(top.take_sorted());
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * n));
+}
+BENCHMARK(BM_TopK)->Arg(1)->Arg(10)->Arg(100)->Arg(1000);
+
+// ---------------------------------------------------------------------------
+// Searches (result cache off, one search thread)
+// ---------------------------------------------------------------------------
+
+// Unfiltered, by corpus size; items are entries in the corpus.
+void BM_SearchScan(benchmark::State& state) {
+    auto entries = static_cast<size_t>(state.range(0));
+    run_searches(state, corpus(entries), 10, "", SearchMode::Scan, entries);
+}
+BENCHMARK(BM_SearchScan)->RangeMultiplier(10)->Range(1000, 100000)->Unit(benchmark::kMicrosecond);
+
+void BM_SearchScanQuantized(benchmark::State& state) {
+    auto entries = static_cast<size_t>(state.range(0));
+    run_searches(state, corpus(entries, 1, true), 10, "", SearchMode::Scan, entries);
+}
+BENCHMARK(BM_SearchScanQuantized)->RangeMultiplier(10)->Range(1000, 100000)
+    ->Unit(benchmark::kMicrosecond);
+
+void BM_SearchIndex(benchmark::State& state) {
+    auto entries = static_cast<size_t>(state.range(0));
+    run_searches(state, corpus(entries), 10, "", SearchMode::Index, entries);
+}
+BENCHMARK(BM_SearchIndex)->RangeMultiplier(10)->Range(1000, 100000)->Unit(benchmark::kMicrosecond);
+
+// Filtered to one doc holding range(0) percent of 100k entries.
+void BM_SearchFiltered(benchmark::State& state) {
+    constexpr size_t entries = 100000;
+    auto percent = static_cast<size_t>(state.range(0));
+    run_searches(state, corpus(entries, percent), 10, "hot", SearchMode::Auto,
+                 entries * percent / 100);
+    state.SetLabel(std::to_string(percent) + "% selected");
+}
+BENCHMARK(BM_SearchFiltered)->Arg(1)->Arg(10)->Arg(50)->Arg(100)->Unit(benchmark::kMicrosecond);
+
+// Cost of a larger k over 100k entries, per exact path.
+void BM_SearchTopK(benchmark::State& state) {
+    constexpr size_t entries = 100000;
+    auto k = static_cast<int>(state.range(0));
+    auto mode = state.range(1) == 0 ? SearchMode::Index : SearchMode::Scan;
+    run_searches(state, corpus(entries), k, "", mode, entries);
+    state.SetLabel(mode == SearchMode::Index ? "index" : "scan");
+}
+BENCHMARK(BM_SearchTopK)->ArgsProduct({{1, 10, 100, 1000}, {0, 1}})->Unit(benchmark::kMicrosecond);
+
+// range(0) queries per search_batch over 100k entries, scanned in one
+// pass per simd::QUERY_BLOCK of them; items are rows times queries, so
+// the rate compares directly with BM_SearchScan/100000.
+void BM_SearchBatchScan(benchmark::State& state) {
+    constexpr size_t entries = 100000;
+    auto n = static_cast<size_t>(state.range(0));
+    const VectorDB& db = corpus(entries);
+    std::vector<SparseVector> batch(queries().begin(), queries().begin() + n);
+    size_t hits = 0;
+    for (auto _ : state) {
+        db.search_batch(batch, 10, "", SearchMode::Scan, 0,
+                        [&](size_t, const SearchHit&) { ++hits; });
+    }
+    benchmark::DoNotOptimize(hits);
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * entries * n));
+}
+BENCHMARK(BM_SearchBatchScan)->Arg(1)->Arg(4)->Arg(16)->Arg(64)->Unit(benchmark::kMillisecond);
+
+} // namespace
+
+BENCHMARK_MAIN();
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Vocabulary synthetic texts draw from.
+constexpr size_t SYNTHETIC_VOCABULARY = 20000;
+
+// Deterministic stand-in for document text. Word ranks are drawn
+// log-uniformly over the vocabulary, so a handful of words are very
+// common and most are rare, as in prose; that is what decides how long
+// the inverted index's posting lists get.
+class SyntheticText {
+public:
+    explicit SyntheticText(uint64_t seed) : state_(seed * 2 + 1) {}
+
+    // xorshift64*: fast, and good enough to pick words.
+    uint64_t next() {
+        state_ ^= state_ >> 12;
+        state_ ^= state_ << 25;
+        state_ ^= state_ >> 27;
+        return state_ * 0x2545F4914F6CDD1DULL;
+    }
+
+    // Uniform in [0, n).
+    size_t below(size_t n) { return static_cast<size_t>(next() % n); }
+
+    // Uniform in [0, 1).
+    double unit() { return static_cast<double>(next() >> 11) * 0x1.0p-53; }
+
+    std::string words(size_t n) {
+        std::string text;
+        text.reserve(n * 7);
+        for (size_t i = 0; i < n; ++i) {
+            if (i > 0) {
+                text += ' ';
+            }
+            auto rank = static_cast<size_t>(
+                std::exp(unit() * std::log(static_cast<double>(SYNTHETIC_VOCABULARY))));
+            append_word(text, rank - 1);
+        }
+        return text;
+    }
+
+private:
+    uint64_t state_;
+
+    // Rank spelled in base 26, at least two letters.
+    static void append_word(std::string& text, size_t rank) {
+        char letters[8];
+        size_t len = 0;
+        do {
+            letters[len++] = static_cast<char>('a' + rank % 26);
+            rank /= 26;
+        } while (rank > 0 || len < 2);
+        text.append(letters, len);
+    }
+};
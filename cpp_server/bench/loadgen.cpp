@@ -0,0 +1,343 @@
+// Closed-loop load generator for a running vectordb_server. Each client
+// thread holds one persistent connection and sends its next request as
+// soon as the previous response arrives, mixing stores and searches. Run
+// at several connection counts, it traces throughput against latency:
+//
+//     ./vectordb_loadgen --port 50051 --connections 1,2,4,8 --duration 10
+//
+// Stores overwrite chunks of the preloaded corpus, so the store keeps its
+// size however long the run.
+
+#include <arpa/inet.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <nlohmann/json.hpp>
+
+#include "corpus.hpp"
+#include "metrics.hpp"
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+constexpr size_t CHUNK_WORDS = 120;
+constexpr size_t QUERY_WORDS = 6;
+constexpr size_t PRELOAD_BATCH = 256;
+
+struct Options {
+    std::string host = "localhost";
+    int port = 50051;
+    std::string unix_path;
+    std::vector<size_t> connections = {1, 2, 4, 8};
+    double duration_sec = 10.0;
+    double warmup_sec = 1.0;
+    double store_fraction = 0.1;
+    size_t preload = 10000;
+    size_t docs = 100;
+    int top_k = 5;
+};
+
+// One persistent connection speaking the server's framing: a 4-byte
+// big-endian length, then the JSON payload.
+class Connection {
+public:
+    explicit Connection(const Options& options) {
+        if (!options.unix_path.empty()) {
+            fd_ = socket(AF_UNIX, SOCK_STREAM, 0);
+            struct sockaddr_un addr;
+            std::memset(&addr, 0, sizeof(addr));
+            addr.sun_family = AF_UNIX;
+            std::strncpy(addr.sun_path, options.unix_path.c_str(), sizeof(addr.sun_path) - 1);
+            if (fd_ < 0 || connect(fd_, reinterpret_cast<struct sockaddr*>(&addr),
+                                   sizeof(addr)) < 0) {
+                throw std::runtime_error("Cannot connect to unix:" + options.unix_path + ": " +
+                                         strerror(errno));
+            }
+            return;
+        }
+
+        struct addrinfo hints;
+        std::memset(&hints, 0, sizeof(hints));
+        hints.ai_family = AF_UNSPEC;
+        hints.ai_socktype = SOCK_STREAM;
+        struct addrinfo* found = nullptr;
+        std::string port = std::to_string(options.port);
+        if (getaddrinfo(options.host.c_str(), port.c_str(), &hints, &found) != 0) {
+            throw std::runtime_error("Cannot resolve " + options.host);
+        }
+        for (struct addrinfo* ai = found; ai; ai = ai->ai_next) {
+            fd_ = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+            if (fd_ >= 0 && connect(fd_, ai->ai_addr, ai->ai_addrlen) == 0) {
+                break;
+            }
+            if (fd_ >= 0) {
+                close(fd_);
+                fd_ = -1;
+            }
+        }
+        freeaddrinfo(found);
+        if (fd_ < 0) {
+            throw std::runtime_error("Cannot connect to " + options.host + ":" + port);
+        }
+        int nodelay = 1;
+        setsockopt(fd_, IPPROTO_TCP, TCP_NODELAY, &nodelay, sizeof(nodelay));
+    }
+
+    ~Connection() {
+        if (fd_ >= 0) {
+            close(fd_);
+        }
+    }
+
+    Connection(const Connection&) = delete;
+    Connection& operator=(const Connection&) = delete;
+
+    // Sends request and returns the raw response payload. Throws
+    // std::runtime_error if the connection fails.
+    const std::string& call(const std::string& request) {
+        auto length = static_cast<uint32_t>(request.size());
+        uint8_t header[4] = {
+            static_cast<uint8_t>(length >> 24), static_cast<uint8_t>(length >> 16),
+            static_cast<uint8_t>(length >> 8), static_cast<uint8_t>(length)};
+        out_.assign(reinterpret_cast<const char*>(header), 4);
+        out_ += request;
+        write_all(out_.data(), out_.size());
+
+        read_all(header, 4);
+        length = (uint32_t(header[0]) << 24) | (uint32_t(header[1]) << 16) |
+                 (uint32_t(header[2]) << 8) | uint32_t(header[3]);
+        response_.resize(length);
+        read_all(&response_[0], length);
+        return response_;
+    }
+
+private:
+    int fd_ = -1;
+    std::string out_;
+    std::string response_;
+
+    void write_all(const char* data, size_t n) {
+        while (n > 0) {
+            ssize_t sent = write(fd_, data, n);
+            if (sent < 0 && errno == EINTR) continue;
+            if (sent <= 0) {
+                throw std::runtime_error("Failed to write request");
+            }
+            data += sent;
+            n -= static_cast<size_t>(sent);
+        }
+    }
+
+    void read_all(void* buf, size_t n) {
+        auto* p = static_cast<char*>(buf);
+        while (n > 0) {
+            ssize_t got = read(fd_, p, n);
+            if (got < 0 && errno == EINTR) continue;
+            if (got <= 0) {
+                throw std::runtime_error("Connection closed by server");
+            }
+            p += got;
+            n -= static_cast<size_t>(got);
+        }
+    }
+};
+
+// Responses carry keys in sorted order, so an error always contains this.
+bool is_error(const std::string& response) {
+    return response.find("\"status\":\"error\"") != std::string::npos;
+}
+
+nlohmann::json chunk(size_t i, const Options& options, SyntheticText& text) {
+    return {{"chunk_id", "lg-" + std::to_string(i)},
+            {"doc_id", "lg-doc-" + std::to_string(i % options.docs)},
+            {"text", text.words(CHUNK_WORDS)},
+            {"metadata", {{"page", i % 300}}}};
+}
+
+void preload(const Options& options) {
+    Connection conn(options);
+    SyntheticText text(1);
+    for (size_t begin = 0; begin < options.preload; begin += PRELOAD_BATCH) {
+        nlohmann::json batch = {{"action", "store_batch"}, {"chunks", nlohmann::json::array()}};
+        for (size_t i = begin; i < std::min(options.preload, begin + PRELOAD_BATCH); ++i) {
+            batch["chunks"].push_back(chunk(i, options, text));
+        }
+        const std::string& response = conn.call(batch.dump());
+        if (is_error(response)) {
+            throw std::runtime_error("Preload failed: " + response);
+        }
+    }
+}
+
+struct LevelResult {
+    size_t connections;
+    double seconds;
+    LatencyHistogram::Summary search;
+    LatencyHistogram::Summary store;
+    uint64_t errors;
+};
+
+LevelResult run_level(const Options& options, size_t connections) {
+    LatencyHistogram search_latency;
+    LatencyHistogram store_latency;
+    std::atomic<uint64_t> errors{0};
+    std::atomic<bool> failed{false};
+
+    Clock::time_point start = Clock::now();
+    auto warm = start + std::chrono::duration_cast<Clock::duration>(
+                            std::chrono::duration<double>(options.warmup_sec));
+    auto end = warm + std::chrono::duration_cast<Clock::duration>(
+                          std::chrono::duration<double>(options.duration_sec));
+
+    std::vector<std::thread> clients;
+    for (size_t c = 0; c < connections; ++c) {
+        clients.emplace_back([&, c] {
+            try {
+                Connection conn(options);
+                SyntheticText text(connections * 1000 + c);
+                for (Clock::time_point now = Clock::now(); now < end; ) {
+                    bool store = text.unit() < options.store_fraction;
+                    nlohmann::json request;
+                    if (store) {
+                        request = chunk(text.below(std::max<size_t>(options.preload, 1)),
+                                        options, text);
+                        request["action"] = "store";
+                    } else {
+                        request = {{"action", "search"},
+                                   {"query", text.words(QUERY_WORDS)},
+                                   {"top_k", options.top_k}};
+                    }
+                    std::string payload = request.dump();
+
+                    Clock::time_point sent = Clock::now();
+                    const std::string& response = conn.call(payload);
+                    now = Clock::now();
+                    if (sent < warm) {
+                        continue;
+                    }
+                    (store ? store_latency : search_latency).record(now - sent);
+                    if (is_error(response)) {
+                        errors.fetch_add(1, std::memory_order_relaxed);
+                    }
+                }
+            } catch (const std::exception& e) {
+                if (!failed.exchange(true)) {
+                    std::cerr << "[loadgen] " << e.what() << std::endl;
+                }
+            }
+        });
+    }
+    for (auto& client : clients) {
+        client.join();
+    }
+    if (failed.load()) {
+        throw std::runtime_error("A client failed; results discarded");
+    }
+
+    return {connections, std::chrono::duration<double>(Clock::now() - warm).count(),
+            search_latency.summarize(), store_latency.summarize(), errors.load()};
+}
+
+std::vector<size_t> parse_list(const std::string& arg) {
+    std::vector<size_t> values;
+    size_t pos = 0;
+    while (pos < arg.size()) {
+        size_t comma = arg.find(',', pos);
+        std::string item = arg.substr(pos, comma == std::string::npos ? std::string::npos
+                                                                      : comma - pos);
+        values.push_back(static_cast<size_t>(std::stoul(item)));
+        if (values.back() == 0) {
+            throw std::invalid_argument("connection counts must be positive");
+        }
+        pos = comma == std::string::npos ? arg.size() : comma + 1;
+    }
+    return values;
+}
+
+void print_usage() {
+    std::cerr << "Usage: vectordb_loadgen [--host HOST] [--port PORT | --unix PATH]"
+                 " [--connections N,N,...] [--duration SEC] [--warmup SEC]"
+                 " [--store-fraction F] [--preload N] [--docs N] [--top-k K]" << std::endl;
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    Options options;
+    try {
+        for (int i = 1; i < argc; ++i) {
+            std::string arg = argv[i];
+            bool has_value = i + 1 < argc;
+            if (arg == "--host" && has_value) {
+                options.host = argv[++i];
+            } else if (arg == "--port" && has_value) {
+                options.port = std::stoi(argv[++i]);
+            } else if (arg == "--unix" && has_value) {
+                options.unix_path = argv[++i];
+            } else if (arg == "--connections" && has_value) {
+                options.connections = parse_list(argv[++i]);
+            } else if (arg == "--duration" && has_value) {
+                options.duration_sec = std::stod(argv[++i]);
+            } else if (arg == "--warmup" && has_value) {
+                options.warmup_sec = std::stod(argv[++i]);
+            } else if (arg == "--store-fraction" && has_value) {
+                options.store_fraction = std::stod(argv[++i]);
+            } else if (arg == "--preload" && has_value) {
+                options.preload = static_cast<size_t>(std::stoul(argv[++i]));
+            } else if (arg == "--docs" && has_value) {
+                options.docs = std::max<size_t>(1, std::stoul(argv[++i]));
+            } else if (arg == "--top-k" && has_value) {
+                options.top_k = std::stoi(argv[++i]);
+            } else {
+                print_usage();
+                return 1;
+            }
+        }
+    } catch (const std::exception&) {
+        print_usage();
+        return 1;
+    }
+
+    try {
+        std::cout << "[loadgen] Preloading " << options.preload << " chunks over "
+                  << options.docs << " docs" << std::endl;
+        preload(options);
+
+        std::printf("%5s %10s  %26s  %26s %8s\n", "conns", "req/s",
+                    "search p50/p99/p999 (us)", "store p50/p99/p999 (us)", "errors");
+        for (size_t connections : options.connections) {
+            LevelResult r = run_level(options, connections);
+            auto us = [](double seconds) { return seconds * 1e6; };
+            double rate = static_cast<double>(r.search.count + r.store.count) / r.seconds;
+            std::printf("%5zu %10.0f  %8.0f /%7.0f /%7.0f  %8.0f /%7.0f /%7.0f %8llu\n",
+                        r.connections, rate,
+                        us(r.search.p50_seconds), us(r.search.p99_seconds),
+                        us(r.search.p999_seconds),
+                        us(r.store.p50_seconds), us(r.store.p99_seconds),
+                        us(r.store.p999_seconds),
+                        static_cast<unsigned long long>(r.errors));
+            std::fflush(stdout);
+        }
+    } catch (const std::exception& e) {
+        std::cerr << "[loadgen] Fatal: " << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
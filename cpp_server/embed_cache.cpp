@@ -0,0 +1,47 @@
+#include "embed_cache.hpp"
+
+namespace {
+
+// Per-entry bookkeeping beyond the embedding arrays: list node, map slot,
+// control block and vector headers, roughly.
+constexpr size_t ENTRY_OVERHEAD_BYTES = 176;
+
+// Seed of the confirming hash (wyhash's third secret).
+constexpr uint64_t CHECK_SEED = 0x8ebc6af09c88c6e3ull;
+
+} // namespace
+
+EmbedCache::EmbedCache(size_t capacity_bytes) : cache_(capacity_bytes) {}
+
+SparseVector EmbedCache::embed(std::string_view text) {
+    if (cache_.capacity_bytes() == 0) {
+        misses_.fetch_add(1, std::memory_order_relaxed);
+        return ::embed(text);
+    }
+
+    uint64_t key = stable_hash(text);
+    uint64_t check = seeded_hash(text, CHECK_SEED);
+    std::shared_ptr<const SparseVector> cached;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        const Entry* found = cache_.find(key);
+        if (found != nullptr && found->check == check && found->length == text.size()) {
+            cached = found->embedding;
+        }
+    }
+    if (cached) {
+        // Copied outside the lock; the entry may be evicted meanwhile.
+        hits_.fetch_add(1, std::memory_order_relaxed);
+        return *cached;
+    }
+
+    misses_.fetch_add(1, std::memory_order_relaxed);
+    auto computed = std::make_shared<const SparseVector>(::embed(text));
+    size_t bytes = ENTRY_OVERHEAD_BYTES +
+                   computed->nnz() * (sizeof(uint16_t) + sizeof(float));
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        cache_.insert(key, {check, text.size(), computed}, bytes);
+    }
+    return *computed;
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string_view>
+
+#include "embedder.hpp"
+#include "lru_cache.hpp"
+
+// Bounded LRU cache in front of embed(), keyed by the 64-bit stable_hash
+// of the text. Texts are not kept for comparison; instead a hit must also
+// match the text's length and a second, independently seeded hash, so
+// colliding texts would have to collide twice. Thread-safe; misses are
+// embedded outside the lock.
+class EmbedCache {
+public:
+    // capacity_bytes bounds the cached embeddings' approximate footprint;
+    // 0 disables caching.
+    explicit EmbedCache(size_t capacity_bytes);
+
+    EmbedCache(const EmbedCache&) = delete;
+    EmbedCache& operator=(const EmbedCache&) = delete;
+
+    // embed(text), from the cache when possible.
+    SparseVector embed(std::string_view text);
+
+    uint64_t hits() const { return hits_.load(std::memory_order_relaxed); }
+    uint64_t misses() const { return misses_.load(std::memory_order_relaxed); }
+
+private:
+    struct Entry {
+        uint64_t check; // seeded_hash of the text
+        size_t length;
+        std::shared_ptr<const SparseVector> embedding;
+    };
+
+    std::mutex mutex_;
+    LruCache<uint64_t, Entry> cache_;
+    std::atomic<uint64_t> hits_{0};
+    std::atomic<uint64_t> misses_{0};
+};
@@ -1,39 +1,144 @@
 #include "embedder.hpp"
+#include "simd.hpp"
 
 #include <algorithm>
-#include <cctype>
+#include <array>
 #include <cmath>
-#include <functional>
+#include <string>
 
-std::vector<float> embed(const std::string& text) {
-    std::vector<float> vec(EMBED_DIM, 0.0f);
+namespace {
 
-    // Tokenize: lowercase, split on non-alphanumeric
-    std::string token;
-    for (char c : text) {
-        if (std::isalnum(static_cast<unsigned char>(c))) {
-            token += static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+// Lowercased byte for ASCII letters and digits, 0 for separators. Same
+// classification as std::tolower/std::isalnum in the "C" locale, without
+// the per-byte locale lookup.
+constexpr std::array<char, 256> TOKEN_CHARS = [] {
+    std::array<char, 256> table{};
+    for (int c = '0'; c <= '9'; ++c) {
+        table[c] = static_cast<char>(c);
+    }
+    for (int c = 'a'; c <= 'z'; ++c) {
+        table[c] = static_cast<char>(c);
+        table[c - 'a' + 'A'] = static_cast<char>(c);
+    }
+    return table;
+}();
+
+// Little-endian loads, so the hash does not depend on host byte order.
+inline uint64_t load_le(const char* p, size_t n) {
+    uint64_t v = 0;
+    for (size_t i = 0; i < n; ++i) {
+        v |= static_cast<uint64_t>(static_cast<unsigned char>(p[i])) << (8 * i);
+    }
+    return v;
+}
+
+// Full 64x64->128 multiply, halves folded together.
+inline uint64_t mix(uint64_t a, uint64_t b) {
+    __uint128_t r = static_cast<__uint128_t>(a) * b;
+    return static_cast<uint64_t>(r) ^ static_cast<uint64_t>(r >> 64);
+}
+
+// Seed of the token hash (wyhash's first secret).
+constexpr uint64_t TOKEN_SEED = 0xa0761d6478bd642full;
+
+// Hash in the style of wyhash (its secret constants and multiply-fold
+// rounds), though not bit-compatible with a wyhash release. Part of the
+// embedding format with TOKEN_SEED: changing either requires an
+// EMBEDDER_VERSION bump.
+uint64_t hash_token(const char* p, size_t n, uint64_t seed) {
+    constexpr uint64_t S1 = 0xe7037ed1a0b428dbull;
+
+    uint64_t a, b;
+    if (n <= 16) {
+        if (n >= 4) {
+            size_t mid = (n >> 3) << 2;
+            a = (load_le(p, 4) << 32) | load_le(p + mid, 4);
+            b = (load_le(p + n - 4, 4) << 32) | load_le(p + n - 4 - mid, 4);
+        } else if (n > 0) {
+            a = (static_cast<uint64_t>(static_cast<unsigned char>(p[0])) << 16) |
+                (static_cast<uint64_t>(static_cast<unsigned char>(p[n >> 1])) << 8) |
+                static_cast<unsigned char>(p[n - 1]);
+            b = 0;
         } else {
-            if (!token.empty()) {
-                size_t h = std::hash<std::string>{}(token) % EMBED_DIM;
-                vec[h] += 1.0f;
-                token.clear();
-            }
+            a = b = 0;
+        }
+    } else {
+        size_t i = n;
+        for (; i > 16; i -= 16, p += 16) {
+            seed = mix(load_le(p, 8) ^ S1, load_le(p + 8, 8) ^ seed);
+        }
+        a = load_le(p + i - 16, 8);
+        b = load_le(p + i - 8, 8);
+    }
+    return mix(S1 ^ n, mix(a ^ S1, b ^ seed));
+}
+
+// Per-thread dense scratch for counting. Only touched buckets are reset,
+// so a short text never pays for clearing all EMBED_DIM slots.
+struct CountScratch {
+    std::vector<float> counts = std::vector<float>(EMBED_DIM, 0.0f);
+    std::vector<uint16_t> touched;
+    std::string lowered;
+
+    void add(const char* token, size_t n) {
+        size_t bucket = hash_token(token, n, TOKEN_SEED) & (EMBED_DIM - 1);
+        if (counts[bucket] == 0.0f) {
+            touched.push_back(static_cast<uint16_t>(bucket));
         }
+        counts[bucket] += 1.0f;
     }
-    if (!token.empty()) {
-        size_t h = std::hash<std::string>{}(token) % EMBED_DIM;
-        vec[h] += 1.0f;
+};
+
+} // namespace
+
+uint64_t stable_hash(std::string_view bytes) {
+    return hash_token(bytes.data(), bytes.size(), TOKEN_SEED);
+}
+
+uint64_t seeded_hash(std::string_view bytes, uint64_t seed) {
+    return hash_token(bytes.data(), bytes.size(), seed);
+}
+
+SparseVector embed(std::string_view text) {
+    thread_local CountScratch scratch;
+
+    // Map the whole text through the table into a reused buffer; tokens
+    // are then hashed in place, with no per-token copy or allocation.
+    std::string& lowered = scratch.lowered;
+    lowered.resize(text.size());
+    for (size_t i = 0; i < text.size(); ++i) {
+        lowered[i] = TOKEN_CHARS[static_cast<unsigned char>(text[i])];
+    }
+    const char* p = lowered.data();
+    const char* end = p + lowered.size();
+    while (p != end) {
+        while (p != end && *p == 0) {
+            ++p;
+        }
+        const char* start = p;
+        while (p != end && *p != 0) {
+            ++p;
+        }
+        if (p != start) {
+            scratch.add(start, static_cast<size_t>(p - start));
+        }
     }
 
-    // L2-normalize
-    float norm = 0.0f;
-    for (float v : vec) {
-        norm += v * v;
+    SparseVector vec;
+    std::sort(scratch.touched.begin(), scratch.touched.end());
+    vec.indices = scratch.touched;
+    vec.values.reserve(vec.indices.size());
+    for (uint16_t idx : vec.indices) {
+        vec.values.push_back(scratch.counts[idx]);
+        scratch.counts[idx] = 0.0f;
     }
+    scratch.touched.clear();
+
+    // L2-normalize
+    float norm = simd::dot(vec.values.data(), vec.values.data(), vec.values.size());
     if (norm > 0.0f) {
         norm = std::sqrt(norm);
-        for (float& v : vec) {
+        for (float& v : vec.values) {
             v /= norm;
         }
     }
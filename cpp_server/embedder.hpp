@@ -1,10 +1,42 @@
 #pragma once
 
-#include <string>
+#include <cstdint>
+#include <string_view>
 #include <vector>
 
 constexpr size_t EMBED_DIM = 4096;
+static_assert(EMBED_DIM <= 65536, "sparse indices are stored as uint16_t");
+static_assert((EMBED_DIM & (EMBED_DIM - 1)) == 0, "buckets are picked with a mask");
+
+// Identifies what embed() computes. Bump it whenever some text would embed
+// differently; snapshots and WAL records carry it, and embeddings stored
+// under another version are recomputed from their text when loaded.
+// Version 0 hashed with std::hash, which varied between standard libraries.
+constexpr uint32_t EMBEDDER_VERSION = 1;
+
+// Sparse embedding: the non-zero buckets of an EMBED_DIM-dimensional
+// vector. indices is strictly ascending; values[i] belongs to indices[i].
+struct SparseVector {
+    std::vector<uint16_t> indices;
+    std::vector<float> values;
+
+    size_t nnz() const { return indices.size(); }
+};
 
 // Hash-based bag-of-words embedder (hashing trick).
 // Tokenizes text, hashes each token into a fixed-size vector, then L2-normalizes.
-std::vector<float> embed(const std::string& text);
+// Only touched buckets are returned, so a chunk costs a few hundred entries
+// and a short query a dozen, instead of EMBED_DIM floats.
+//
+// Tokens are maximal runs of ASCII letters and digits, lowercased; every
+// other byte separates them. Each is hashed with a fixed wyhash-style
+// function, so a text embeds identically on every build and platform.
+SparseVector embed(std::string_view text);
+
+// The 64-bit hash embed() applies to tokens; stable across builds, so it
+// can also key caches of embeddings by content.
+uint64_t stable_hash(std::string_view bytes);
+
+// The same hash under another seed, which makes it independent of
+// stable_hash: for confirming a match found by it.
+uint64_t seeded_hash(std::string_view bytes, uint64_t seed);
@@ -0,0 +1,390 @@
+#include "hnsw.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <functional>
+#include <limits>
+#include <queue>
+
+namespace {
+
+constexpr uint32_t NO_ENTRY = std::numeric_limits<uint32_t>::max();
+
+// Draws stop growing here; 16 layers already cover far more nodes than
+// slots can number.
+constexpr int MAX_LEVEL = 16;
+
+// Per-thread visited set over slots. Marks are epoch numbers, so starting
+// a new search is O(1) instead of clearing one flag per slot.
+class VisitedSet {
+public:
+    explicit VisitedSet(size_t slots) {
+        auto& marks = this->marks();
+        if (marks.size() < slots) {
+            marks.resize(slots, 0);
+        }
+        if (++epoch() == 0) {
+            std::fill(marks.begin(), marks.end(), 0);
+            epoch() = 1;
+        }
+    }
+
+    // True the first time a slot is seen in this search.
+    bool insert(uint32_t slot) {
+        uint32_t& mark = marks()[slot];
+        if (mark == epoch()) {
+            return false;
+        }
+        mark = epoch();
+        return true;
+    }
+
+private:
+    static std::vector<uint32_t>& marks() {
+        thread_local std::vector<uint32_t> buf;
+        return buf;
+    }
+    static uint32_t& epoch() {
+        thread_local uint32_t value = 0;
+        return value;
+    }
+};
+
+} // namespace
+
+// Fixed seed: the same stores build the same graph.
+HnswIndex::HnswIndex() : entry_(NO_ENTRY), rng_(42) {}
+
+int HnswIndex::random_level() {
+    std::uniform_real_distribution<double> uniform(0.0, 1.0);
+    double u = std::max(uniform(rng_), std::numeric_limits<double>::min());
+    int level = static_cast<int>(-std::log(u) / std::log(static_cast<double>(HNSW_M)));
+    return std::min(level, MAX_LEVEL);
+}
+
+void HnswIndex::insert(uint32_t slot, const SlotScorer& score) {
+    int level = random_level();
+    if (slot >= nodes_.size()) {
+        nodes_.resize(slot + 1);
+    }
+    nodes_[slot].layers.assign(level + 1, {});
+
+    if (entry_ == NO_ENTRY) {
+        entry_ = slot;
+        max_level_ = level;
+        return;
+    }
+
+    Candidate from{score(entry_), entry_};
+    for (int l = max_level_; l > level; --l) {
+        from = greedy(score, from, l);
+    }
+    for (int l = std::min(level, max_level_); l >= 0; --l) {
+        std::vector<Candidate> found = search_layer(score, from, HNSW_EF_CONSTRUCTION, l);
+        size_t max_links = l == 0 ? 2 * HNSW_M : HNSW_M;
+        size_t keep = std::min(found.size(), HNSW_M);
+
+        for (size_t i = 0; i < keep; ++i) {
+            const auto& [s, neighbour] = found[i];
+            nodes_[slot].layers[l].push_back({neighbour, s});
+
+            // Link back, dropping the neighbour's weakest link if it is
+            // now over budget.
+            auto& links = nodes_[neighbour].layers[l];
+            links.push_back({slot, s});
+            if (links.size() > max_links) {
+                auto weakest = std::min_element(links.begin(), links.end(),
+                                                [](const Link& a, const Link& b) {
+                                                    return a.score < b.score;
+                                                });
+                *weakest = links.back();
+                links.pop_back();
+            }
+        }
+        if (!found.empty()) {
+            from = found.front();
+        }
+    }
+
+    if (level > max_level_) {
+        entry_ = slot;
+        max_level_ = level;
+    }
+}
+
+std::unique_ptr<AnnIndex::RemovalPlan> HnswIndex::plan_remove(const std::vector<uint32_t>& slots,
+                                                              const PairScorer& score) const {
+    auto plan = std::make_unique<Removal>();
+    std::vector<char>& removed = plan->removed;
+    removed.assign(nodes_.size(), 0);
+    for (uint32_t slot : slots) {
+        if (slot < nodes_.size()) {
+            removed[slot] = 1;
+            plan->slots.push_back(slot);
+        }
+    }
+    auto dropped = [&](uint32_t slot) { return removed[slot] != 0; };
+
+    for (uint32_t slot = 0; slot < nodes_.size(); ++slot) {
+        if (removed[slot]) {
+            continue;
+        }
+        const auto& layers = nodes_[slot].layers;
+        for (size_t l = 0; l < layers.size(); ++l) {
+            if (std::any_of(layers[l].begin(), layers[l].end(),
+                            [&](const Link& link) { return dropped(link.slot); })) {
+                plan->relinks.emplace_back(slot, l, relinked(slot, l, dropped, score));
+            }
+        }
+    }
+    return plan;
+}
+
+void HnswIndex::apply_remove(RemovalPlan& plan) {
+    // The old links are moved into the plan, to be freed with it.
+    auto& removal = static_cast<Removal&>(plan);
+    for (auto& [slot, level, links] : removal.relinks) {
+        nodes_[slot].layers[level].swap(links);
+    }
+    for (uint32_t slot : removal.slots) {
+        removal.dropped.push_back(std::move(nodes_[slot]));
+        nodes_[slot] = Node();
+    }
+    if (entry_ != NO_ENTRY && entry_ < removal.removed.size() && removal.removed[entry_]) {
+        entry_ = NO_ENTRY;
+        max_level_ = -1;
+        for (uint32_t slot = 0; slot < nodes_.size(); ++slot) {
+            if (static_cast<int>(nodes_[slot].layers.size()) - 1 > max_level_) {
+                entry_ = slot;
+                max_level_ = static_cast<int>(nodes_[slot].layers.size()) - 1;
+            }
+        }
+    }
+}
+
+std::vector<HnswIndex::Link> HnswIndex::relinked(uint32_t slot, size_t level,
+                                                 const std::function<bool(uint32_t)>& dropped,
+                                                 const PairScorer& score) const {
+    std::vector<Link> kept;
+    std::vector<uint32_t> via;
+    for (const Link& link : nodes_[slot].layers[level]) {
+        if (dropped(link.slot)) {
+            via.push_back(link.slot);
+        } else {
+            kept.push_back(link);
+        }
+    }
+    for (uint32_t dropped_slot : via) {
+        for (const Link& second : nodes_[dropped_slot].layers[level]) {
+            if (dropped(second.slot) || second.slot == slot ||
+                std::any_of(kept.begin(), kept.end(),
+                            [&](const Link& k) { return k.slot == second.slot; })) {
+                continue;
+            }
+            kept.push_back({second.slot, score(slot, second.slot)});
+        }
+    }
+    size_t max_links = level == 0 ? 2 * HNSW_M : HNSW_M;
+    if (kept.size() > max_links) {
+        std::partial_sort(kept.begin(), kept.begin() + max_links, kept.end(),
+                          [](const Link& a, const Link& b) { return a.score > b.score; });
+        kept.resize(max_links);
+    }
+    return kept;
+}
+
+void HnswIndex::search(const SlotScorer& score, size_t effort,
+                       const std::function<bool(uint32_t)>& accept, TopK& top) const {
+    if (entry_ == NO_ENTRY) {
+        return;
+    }
+    Candidate from{score(entry_), entry_};
+    for (int l = max_level_; l > 0; --l) {
+        from = greedy(score, from, l);
+    }
+    size_t ef = std::max(effort == 0 ? HNSW_EF_SEARCH : effort, top.k());
+    for (const auto& [s, slot] : search_layer(score, from, ef, 0)) {
+        if (s > 0.0f && accept(slot)) {
+            top.push(s, slot);
+        }
+    }
+}
+
+void HnswIndex::clear() {
+    nodes_.clear();
+    entry_ = NO_ENTRY;
+    max_level_ = -1;
+}
+
+// Serialized as uint32 words: node count and entry slot, then per node
+// its layer count and, per layer, a link count and the links themselves.
+void HnswIndex::save(std::string& out, const std::vector<uint32_t>& renumber,
+                     const PairScorer& score) const {
+    constexpr uint32_t DROPPED = std::numeric_limits<uint32_t>::max();
+    auto put = [&](const void* data, size_t n) {
+        out.append(static_cast<const char*>(data), n);
+    };
+
+    std::vector<uint32_t> old_slot;
+    for (uint32_t slot = 0; slot < nodes_.size() && slot < renumber.size(); ++slot) {
+        if (renumber[slot] != DROPPED) {
+            if (renumber[slot] >= old_slot.size()) {
+                old_slot.resize(renumber[slot] + 1, NO_ENTRY);
+            }
+            old_slot[renumber[slot]] = slot;
+        }
+    }
+    auto kept = [&](uint32_t slot) { return slot < renumber.size() && renumber[slot] != DROPPED; };
+    auto dropped = [&](uint32_t slot) { return !kept(slot); };
+
+    // A dropped entry point is replaced by the highest kept node.
+    uint32_t entry = NO_ENTRY;
+    if (entry_ != NO_ENTRY && kept(entry_)) {
+        entry = renumber[entry_];
+    } else {
+        size_t best = 0;
+        for (uint32_t slot : old_slot) {
+            if (slot != NO_ENTRY && nodes_[slot].layers.size() > best) {
+                best = nodes_[slot].layers.size();
+                entry = renumber[slot];
+            }
+        }
+    }
+
+    uint32_t count = static_cast<uint32_t>(old_slot.size());
+    put(&count, sizeof(count));
+    put(&entry, sizeof(entry));
+    std::vector<Link> links;
+    for (uint32_t slot : old_slot) {
+        uint32_t levels = slot == NO_ENTRY ? 0 : static_cast<uint32_t>(nodes_[slot].layers.size());
+        put(&levels, sizeof(levels));
+        for (uint32_t l = 0; l < levels; ++l) {
+            // Links to dropped nodes are spliced around them, as a removal
+            // would.
+            links = relinked(slot, l, dropped, score);
+            for (Link& link : links) {
+                link.slot = renumber[link.slot];
+            }
+            uint32_t n = static_cast<uint32_t>(links.size());
+            put(&n, sizeof(n));
+            put(links.data(), links.size() * sizeof(Link));
+        }
+    }
+}
+
+bool HnswIndex::load(const char* data, size_t n, size_t slots) {
+    clear();
+    size_t pos = 0;
+    auto get = [&](void* into, size_t bytes) {
+        if (bytes > n - pos) {
+            return false;
+        }
+        std::memcpy(into, data + pos, bytes);
+        pos += bytes;
+        return true;
+    };
+
+    uint32_t count, entry;
+    bool ok = get(&count, sizeof(count)) && get(&entry, sizeof(entry)) && count <= slots;
+    if (ok) {
+        nodes_.resize(count);
+    }
+    for (uint32_t slot = 0; ok && slot < count; ++slot) {
+        uint32_t levels;
+        ok = get(&levels, sizeof(levels)) && levels <= static_cast<uint32_t>(MAX_LEVEL) + 1;
+        if (ok) {
+            nodes_[slot].layers.resize(levels);
+        }
+        for (uint32_t l = 0; ok && l < levels; ++l) {
+            uint32_t links;
+            ok = get(&links, sizeof(links)) && links <= 2 * HNSW_M;
+            if (ok) {
+                nodes_[slot].layers[l].resize(links);
+                ok = get(nodes_[slot].layers[l].data(), links * sizeof(Link));
+            }
+        }
+    }
+    // Searches follow links without checks, so every link must land on a
+    // node that has the layer it was made on.
+    for (uint32_t slot = 0; ok && slot < count; ++slot) {
+        const auto& layers = nodes_[slot].layers;
+        for (size_t l = 0; ok && l < layers.size(); ++l) {
+            for (const Link& link : layers[l]) {
+                if (link.slot >= count || nodes_[link.slot].layers.size() <= l) {
+                    ok = false;
+                    break;
+                }
+            }
+        }
+    }
+    if (ok && entry != NO_ENTRY) {
+        ok = entry < count && !nodes_[entry].layers.empty();
+        if (ok) {
+            entry_ = entry;
+            max_level_ = static_cast<int>(nodes_[entry].layers.size()) - 1;
+        }
+    }
+    if (!ok || pos != n) {
+        clear();
+        return false;
+    }
+    return true;
+}
+
+HnswIndex::Candidate HnswIndex::greedy(const SlotScorer& score, Candidate from,
+                                       int level) const {
+    for (bool moved = true; moved;) {
+        moved = false;
+        for (const Link& link : nodes_[from.second].layers[level]) {
+            float s = score(link.slot);
+            if (s > from.first) {
+                from = {s, link.slot};
+                moved = true;
+            }
+        }
+    }
+    return from;
+}
+
+std::vector<HnswIndex::Candidate> HnswIndex::search_layer(const SlotScorer& score,
+                                                          Candidate from, size_t ef,
+                                                          int level) const {
+    VisitedSet visited(nodes_.size());
+    visited.insert(from.second);
+
+    // Frontier best first; results worst first, so the one to evict is on top.
+    std::priority_queue<Candidate> frontier;
+    std::priority_queue<Candidate, std::vector<Candidate>, std::greater<Candidate>> results;
+    frontier.push(from);
+    results.push(from);
+
+    while (!frontier.empty()) {
+        Candidate current = frontier.top();
+        if (results.size() >= ef && current.first < results.top().first) {
+            break;
+        }
+        frontier.pop();
+
+        for (const Link& link : nodes_[current.second].layers[level]) {
+            if (!visited.insert(link.slot)) {
+                continue;
+            }
+            float s = score(link.slot);
+            if (results.size() < ef || s > results.top().first) {
+                frontier.push({s, link.slot});
+                results.push({s, link.slot});
+                if (results.size() > ef) {
+                    results.pop();
+                }
+            }
+        }
+    }
+
+    std::vector<Candidate> found(results.size());
+    for (size_t i = found.size(); i > 0; --i) {
+        found[i - 1] = results.top();
+        results.pop();
+    }
+    return found;
+}
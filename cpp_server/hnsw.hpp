@@ -0,0 +1,87 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <random>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+#include "ann_index.hpp"
+
+// Links per node on the upper layers; layer 0 allows twice as many.
+constexpr size_t HNSW_M = 32;
+
+// Candidates kept while linking a new node.
+constexpr size_t HNSW_EF_CONSTRUCTION = 200;
+
+// Candidates kept by a search when the caller does not pick ef_search.
+constexpr size_t HNSW_EF_SEARCH = 64;
+
+// Hierarchical navigable small world graph (Malkov & Yashunin). Each node
+// sits on layers 0..level, with level drawn from a geometric
+// distribution; a search descends greedily through the sparse upper
+// layers, then beam-searches layer 0 keeping the ef best candidates.
+//
+// A new node links to the closest nodes found. Each link stores its
+// score, so trimming an overfull neighbour list never has to compare two
+// stored rows with each other. A removed node's neighbours inherit its
+// links instead, keeping the best-scoring ones within budget.
+class HnswIndex : public AnnIndex {
+public:
+    HnswIndex();
+
+    void insert(uint32_t slot, const SlotScorer& score) override;
+    void search(const SlotScorer& score, size_t effort,
+                const std::function<bool(uint32_t)>& accept, TopK& top) const override;
+    std::unique_ptr<RemovalPlan> plan_remove(const std::vector<uint32_t>& slots,
+                                             const PairScorer& score) const override;
+    void apply_remove(RemovalPlan& plan) override;
+    void clear() override;
+    void save(std::string& out, const std::vector<uint32_t>& renumber,
+              const PairScorer& score) const override;
+    bool load(const char* data, size_t n, size_t slots) override;
+
+private:
+    // (score, slot)
+    using Candidate = std::pair<float, uint32_t>;
+
+    struct Link {
+        uint32_t slot;
+        float score;
+    };
+
+    // Indexed by slot; a slot not in the graph has no layers.
+    struct Node {
+        std::vector<std::vector<Link>> layers;
+    };
+    std::vector<Node> nodes_;
+    uint32_t entry_;
+    int max_level_ = -1;
+
+    struct Removal : RemovalPlan {
+        std::vector<char> removed; // by slot
+        std::vector<uint32_t> slots;
+        // (slot, level, links): the new links of every node that changes
+        std::vector<std::tuple<uint32_t, size_t, std::vector<Link>>> relinks;
+        std::vector<Node> dropped; // filled by apply_remove()
+    };
+    std::mt19937 rng_;
+
+    int random_level();
+
+    // Follow the best-scoring link on `level` until none improves.
+    Candidate greedy(const SlotScorer& score, Candidate from, int level) const;
+
+    // Beam search on `level` from `from`; the ef best found, best first.
+    std::vector<Candidate> search_layer(const SlotScorer& score, Candidate from,
+                                        size_t ef, int level) const;
+
+    // slot's links on `level`, those to dropped nodes replaced by the
+    // dropped nodes' own surviving links, the best kept within budget.
+    std::vector<Link> relinked(uint32_t slot, size_t level,
+                               const std::function<bool(uint32_t)>& dropped,
+                               const PairScorer& score) const;
+};
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <cstddef>
+#include <list>
+#include <unordered_map>
+#include <utility>
+
+// Least-recently-used cache bounded by a byte budget the caller accounts
+// for: every insert states what its entry costs. Not thread-safe.
+template <typename Key, typename Value>
+class LruCache {
+public:
+    explicit LruCache(size_t capacity_bytes) : capacity_bytes_(capacity_bytes) {}
+
+    size_t capacity_bytes() const { return capacity_bytes_; }
+
+    // The cached value, now the most recently used; nullptr if absent.
+    // Valid until the next insert.
+    const Value* find(const Key& key) {
+        auto it = index_.find(key);
+        if (it == index_.end()) {
+            return nullptr;
+        }
+        lru_.splice(lru_.begin(), lru_, it->second);
+        return &it->second->value;
+    }
+
+    // Insert or replace, then evict least recently used entries until the
+    // total is back within budget. An entry bigger than the whole budget
+    // is not cached.
+    void insert(const Key& key, Value value, size_t bytes) {
+        auto it = index_.find(key);
+        if (it != index_.end()) {
+            bytes_ -= it->second->bytes;
+            lru_.erase(it->second);
+            index_.erase(it);
+        }
+        if (bytes > capacity_bytes_) {
+            return;
+        }
+        lru_.push_front({key, std::move(value), bytes});
+        index_.emplace(key, lru_.begin());
+        bytes_ += bytes;
+        while (bytes_ > capacity_bytes_) {
+            Entry& victim = lru_.back();
+            bytes_ -= victim.bytes;
+            index_.erase(victim.key);
+            lru_.pop_back();
+        }
+    }
+
+private:
+    struct Entry {
+        Key key;
+        Value value;
+        size_t bytes;
+    };
+
+    size_t capacity_bytes_;
+    std::list<Entry> lru_; // most recently used first
+    std::unordered_map<Key, typename std::list<Entry>::iterator> index_;
+    size_t bytes_ = 0;
+};
@@ -4,23 +4,43 @@
 #include <string>
 
 int main(int argc, char* argv[]) {
-    std::string host = "localhost";
-    int port = 50051;
+    ServerOptions options;
 
     for (int i = 1; i < argc; ++i) {
         std::string arg = argv[i];
         if (arg == "--host" && i + 1 < argc) {
-            host = argv[++i];
+            options.host = argv[++i];
         } else if (arg == "--port" && i + 1 < argc) {
-            port = std::stoi(argv[++i]);
+            options.port = std::stoi(argv[++i]);
+        } else if (arg == "--unix" && i + 1 < argc) {
+            options.unix_path = argv[++i];
+        } else if (arg == "--workers" && i + 1 < argc) {
+            options.num_workers = static_cast<size_t>(std::stoul(argv[++i]));
+        } else if (arg == "--search-threads" && i + 1 < argc) {
+            options.search_threads = static_cast<size_t>(std::stoul(argv[++i]));
+        } else if (arg == "--quantize") {
+            options.quantize = true;
+        } else if (arg == "--hnsw") {
+            options.hnsw = true;
+        } else if (arg == "--embed-cache-mb" && i + 1 < argc) {
+            options.embed_cache_bytes = static_cast<size_t>(std::stoul(argv[++i])) << 20;
+        } else if (arg == "--result-cache-mb" && i + 1 < argc) {
+            options.result_cache_bytes = static_cast<size_t>(std::stoul(argv[++i])) << 20;
+        } else if (arg == "--data-dir" && i + 1 < argc) {
+            options.data_dir = argv[++i];
+        } else if (arg == "--fsync" && i + 1 < argc && parse_fsync_policy(argv[i + 1], options.fsync)) {
+            ++i;
         } else {
-            std::cerr << "Usage: vectordb_server [--host HOST] [--port PORT]" << std::endl;
+            std::cerr << "Usage: vectordb_server [--host HOST] [--port PORT | --unix PATH] [--workers N]"
+                      " [--search-threads N] [--quantize] [--hnsw] [--embed-cache-mb N]"
+                      " [--result-cache-mb N] [--data-dir DIR]"
+                      " [--fsync always|interval|never]" << std::endl;
             return 1;
         }
     }
 
     try {
-        Server server(host, port);
+        Server server(options);
         server.run();
     } catch (const std::exception& e) {
         std::cerr << "[vectordb] Fatal: " << e.what() << std::endl;
@@ -0,0 +1,122 @@
+#include "metrics.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <utility>
+
+void LatencyHistogram::record(std::chrono::nanoseconds elapsed) {
+    uint64_t ns = elapsed.count() > 0 ? static_cast<uint64_t>(elapsed.count()) : 0;
+    buckets_[bucket_of(ns)].fetch_add(1, std::memory_order_relaxed);
+    sum_ns_.fetch_add(ns, std::memory_order_relaxed);
+    uint64_t max = max_ns_.load(std::memory_order_relaxed);
+    while (ns > max && !max_ns_.compare_exchange_weak(max, ns, std::memory_order_relaxed)) {
+    }
+}
+
+LatencyHistogram::Summary LatencyHistogram::summarize() const {
+    std::array<uint64_t, NUM_BUCKETS> counts;
+    Summary s;
+    for (size_t b = 0; b < NUM_BUCKETS; ++b) {
+        counts[b] = buckets_[b].load(std::memory_order_relaxed);
+        s.count += counts[b];
+    }
+    s.sum_seconds = sum_ns_.load(std::memory_order_relaxed) * 1e-9;
+    s.max_seconds = max_ns_.load(std::memory_order_relaxed) * 1e-9;
+    if (s.count == 0) {
+        return s;
+    }
+
+    auto quantile = [&](double q) {
+        // Smallest bucket holding the ceil(q * count)-th sample.
+        auto rank = static_cast<uint64_t>(q * static_cast<double>(s.count));
+        if (static_cast<double>(rank) < q * static_cast<double>(s.count)) {
+            ++rank;
+        }
+        rank = std::max<uint64_t>(rank, 1);
+        uint64_t seen = 0;
+        for (size_t b = 0; b < NUM_BUCKETS; ++b) {
+            seen += counts[b];
+            if (seen >= rank) {
+                return std::min(bucket_midpoint(b) * 1e-9, s.max_seconds);
+            }
+        }
+        return s.max_seconds;
+    };
+    s.p50_seconds = quantile(0.5);
+    s.p99_seconds = quantile(0.99);
+    s.p999_seconds = quantile(0.999);
+    return s;
+}
+
+size_t LatencyHistogram::bucket_of(uint64_t ns) {
+    // Below 2 * LATENCY_SUB_BUCKETS every nanosecond has its own bucket;
+    // above, power p's steps are 2^(p - LATENCY_SUB_BITS) wide.
+    if (ns < 2 * LATENCY_SUB_BUCKETS) {
+        return static_cast<size_t>(ns);
+    }
+    size_t power = 63 - static_cast<size_t>(__builtin_clzll(ns));
+    if (power >= LATENCY_MAX_POWER) {
+        return NUM_BUCKETS - 1;
+    }
+    size_t shift = power - LATENCY_SUB_BITS;
+    return shift * LATENCY_SUB_BUCKETS + static_cast<size_t>(ns >> shift);
+}
+
+double LatencyHistogram::bucket_midpoint(size_t bucket) {
+    if (bucket < 2 * LATENCY_SUB_BUCKETS) {
+        return static_cast<double>(bucket);
+    }
+    size_t shift = bucket / LATENCY_SUB_BUCKETS - 1;
+    uint64_t lower = static_cast<uint64_t>(bucket % LATENCY_SUB_BUCKETS + LATENCY_SUB_BUCKETS)
+                     << shift;
+    return static_cast<double>(lower) + static_cast<double>(uint64_t(1) << shift) / 2.0;
+}
+
+void PrometheusWriter::summary(const std::string& name, const std::string& help,
+                               const std::string& labels, const LatencyHistogram::Summary& s) {
+    header(name, help, "summary");
+    std::string prefix = labels.empty() ? "" : labels + ",";
+    const std::pair<const char*, double> quantiles[] = {
+        {"0.5", s.p50_seconds}, {"0.99", s.p99_seconds}, {"0.999", s.p999_seconds}};
+    char number[32];
+    for (const auto& [q, seconds] : quantiles) {
+        std::snprintf(number, sizeof(number), "%.9g", seconds);
+        sample(name, prefix + "quantile=\"" + q + "\"", number);
+    }
+    std::snprintf(number, sizeof(number), "%.9g", s.sum_seconds);
+    sample(name + "_sum", labels, number);
+    sample(name + "_count", labels, std::to_string(s.count));
+}
+
+void PrometheusWriter::counter(const std::string& name, const std::string& help,
+                               const std::string& labels, uint64_t value) {
+    header(name, help, "counter");
+    sample(name, labels, std::to_string(value));
+}
+
+void PrometheusWriter::gauge(const std::string& name, const std::string& help,
+                             const std::string& labels, double value) {
+    header(name, help, "gauge");
+    char number[32];
+    std::snprintf(number, sizeof(number), "%.9g", value);
+    sample(name, labels, number);
+}
+
+void PrometheusWriter::header(const std::string& name, const std::string& help,
+                              const char* type) {
+    if (name == last_name_) {
+        return;
+    }
+    last_name_ = name;
+    out_ += "# HELP " + name + " " + help + "\n";
+    out_ += "# TYPE " + name + " " + type + "\n";
+}
+
+void PrometheusWriter::sample(const std::string& name, const std::string& labels,
+                              const std::string& value) {
+    out_ += name;
+    if (!labels.empty()) {
+        out_ += "{" + labels + "}";
+    }
+    out_ += " " + value + "\n";
+}
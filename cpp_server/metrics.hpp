@@ -0,0 +1,70 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Latency histogram any number of threads record into without locking: a
+// sample is a few relaxed atomic adds, so measuring a request costs about
+// as much as reading the clock for it.
+//
+// Buckets are log-linear over nanoseconds: each power of two is split into
+// LATENCY_SUB_BUCKETS equal steps, so a reported percentile is within an
+// eighth of the true one from 8 ns up to ~18 minutes (longer samples land
+// in the last bucket).
+class LatencyHistogram {
+public:
+    void record(std::chrono::nanoseconds elapsed);
+
+    // Percentiles are bucket midpoints, capped at the largest sample. Read
+    // while others record, so a summary may miss samples still landing.
+    struct Summary {
+        uint64_t count = 0;
+        double sum_seconds = 0.0;
+        double p50_seconds = 0.0;
+        double p99_seconds = 0.0;
+        double p999_seconds = 0.0;
+        double max_seconds = 0.0;
+    };
+    Summary summarize() const;
+
+private:
+    static constexpr size_t LATENCY_SUB_BITS = 3;
+    static constexpr size_t LATENCY_SUB_BUCKETS = size_t(1) << LATENCY_SUB_BITS;
+    static constexpr size_t LATENCY_MAX_POWER = 40;
+    static constexpr size_t NUM_BUCKETS = (LATENCY_MAX_POWER - 2) * LATENCY_SUB_BUCKETS;
+
+    static size_t bucket_of(uint64_t ns);
+    static double bucket_midpoint(size_t bucket);
+
+    std::array<std::atomic<uint64_t>, NUM_BUCKETS> buckets_{};
+    std::atomic<uint64_t> sum_ns_{0};
+    std::atomic<uint64_t> max_ns_{0};
+};
+
+// Builds a Prometheus text exposition (format 0.0.4). A HELP/TYPE header
+// is written whenever the name differs from the previous call's, so
+// consecutive calls for one name with different labels form one family.
+class PrometheusWriter {
+public:
+    // labels is the inside of the braces, e.g. `action="search"`; may be
+    // empty.
+    void summary(const std::string& name, const std::string& help,
+                 const std::string& labels, const LatencyHistogram::Summary& s);
+    void counter(const std::string& name, const std::string& help,
+                 const std::string& labels, uint64_t value);
+    void gauge(const std::string& name, const std::string& help,
+               const std::string& labels, double value);
+
+    const std::string& text() const { return out_; }
+
+private:
+    void header(const std::string& name, const std::string& help, const char* type);
+    void sample(const std::string& name, const std::string& labels, const std::string& value);
+
+    std::string out_;
+    std::string last_name_;
+};
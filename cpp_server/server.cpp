@@ -1,13 +1,28 @@
 #include "server.hpp"
 #include "embedder.hpp"
+#include "simd.hpp"
 
+#include <algorithm>
 #include <arpa/inet.h>
+#include <chrono>
+#include <cmath>
 #include <csignal>
+#include <cstdio>
 #include <cstring>
+#include <fcntl.h>
 #include <iostream>
 #include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <stdexcept>
 #include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <sys/un.h>
+#include <thread>
 #include <unistd.h>
+#include <unordered_set>
 
 std::atomic<bool> Server::shutdown_requested{false};
 
@@ -15,16 +30,229 @@ static void signal_handler(int) {
     Server::shutdown_requested.store(true);
 }
 
-Server::Server(const std::string& host, int port)
-    : host_(host), port_(port) {}
+// Upper bound on how long a worker waits for a stalled client mid-message.
+static constexpr int CLIENT_IO_TIMEOUT_SEC = 30;
+
+// Requests a worker serves back to back from one pipelining connection
+// before handing it back to the poll loop, so a client streaming stores
+// cannot keep a worker from everyone else.
+static constexpr size_t MAX_REQUESTS_PER_TURN = 64;
+
+// Floor for the WAL growth that triggers a background checkpoint.
+static constexpr size_t CHECKPOINT_MIN_WAL_BYTES = 64 << 20;
+
+// Longest HTTP request head (request line plus headers) a metrics scrape
+// may send.
+static constexpr size_t HTTP_MAX_HEAD_BYTES = 8192;
+
+// Indexed by Server::Action and Server::Phase; action names are those of
+// the protocol.
+static const char* const ACTION_NAMES[] = {
+    "store", "store_batch", "search", "search_batch", "delete_doc", "delete_chunk",
+    "diff_chunks", "stats",
+};
+static const char* const PHASE_NAMES[] = {"embed", "write", "scan", "serialize"};
+
+static size_t hardware_threads() {
+    return std::max(1u, std::thread::hardware_concurrency());
+}
+
+// Resident set size from /proc/self/statm; 0 where that is unavailable.
+static size_t resident_bytes() {
+    FILE* statm = std::fopen("/proc/self/statm", "r");
+    if (!statm) {
+        return 0;
+    }
+    unsigned long total_pages = 0, resident_pages = 0;
+    int fields = std::fscanf(statm, "%lu %lu", &total_pages, &resident_pages);
+    std::fclose(statm);
+    if (fields != 2) {
+        return 0;
+    }
+    return static_cast<size_t>(resident_pages) * static_cast<size_t>(sysconf(_SC_PAGESIZE));
+}
+
+// A store request's metadata, moved out; an empty object if absent.
+static nlohmann::json take_metadata(nlohmann::json& request) {
+    auto it = request.find("metadata");
+    if (it == request.end()) {
+        return nlohmann::json::object();
+    }
+    return std::move(*it);
+}
+
+// A store request's content hash, moved out; empty if absent.
+static std::string take_content_hash(nlohmann::json& request) {
+    auto it = request.find("content_hash");
+    if (it == request.end()) {
+        return {};
+    }
+    return std::move(it->get_ref<std::string&>());
+}
+
+// Which keys of each search result to return. "metadata.<key>" selects a
+// single metadata key; the others name top-level result keys.
+struct SearchFields {
+    bool chunk_id = true;
+    bool score = true;
+    bool text = true;
+    bool metadata = true;
+    std::vector<std::string> metadata_keys;
+};
+
+// Throws std::invalid_argument naming the offending field.
+static SearchFields parse_search_fields(const nlohmann::json& fields) {
+    if (!fields.is_array()) {
+        throw std::invalid_argument("search fields must be an array of strings");
+    }
+    SearchFields selected;
+    selected.chunk_id = selected.score = selected.text = selected.metadata = false;
+    for (const auto& field : fields) {
+        if (!field.is_string()) {
+            throw std::invalid_argument("search fields must be an array of strings");
+        }
+        const std::string& name = field.get_ref<const std::string&>();
+        if (name == "chunk_id") {
+            selected.chunk_id = true;
+        } else if (name == "score") {
+            selected.score = true;
+        } else if (name == "text") {
+            selected.text = true;
+        } else if (name == "metadata") {
+            selected.metadata = true;
+        } else if (name.compare(0, 9, "metadata.") == 0 && name.size() > 9) {
+            selected.metadata_keys.push_back(name.substr(9));
+        } else {
+            throw std::invalid_argument("Unknown search field: " + name);
+        }
+    }
+    return selected;
+}
+
+// What search and search_batch take besides their queries.
+struct SearchOptions {
+    int top_k = 5;
+    std::string doc_id_filter;
+    SearchMode mode = SearchMode::Auto;
+    size_t ef_search = 0;
+    SearchFields fields;
+};
+
+// Throws std::invalid_argument naming the offending field.
+static SearchOptions parse_search_options(const nlohmann::json& request) {
+    SearchOptions options;
+    options.top_k = request.value("top_k", 5);
+    options.doc_id_filter = request.value("doc_id", std::string(""));
+
+    // "scan" brute-forces every candidate, for verifying the index path;
+    // "approx" trades exactness for speed when --hnsw built a graph.
+    std::string mode_name = request.value("mode", std::string("auto"));
+    if (mode_name == "auto") {
+        options.mode = SearchMode::Auto;
+    } else if (mode_name == "index") {
+        options.mode = SearchMode::Index;
+    } else if (mode_name == "scan") {
+        options.mode = SearchMode::Scan;
+    } else if (mode_name == "approx") {
+        options.mode = SearchMode::Approx;
+    } else {
+        throw std::invalid_argument("Unknown search mode: " + mode_name);
+    }
+    if (request.contains("ef_search")) {
+        const auto& ef = request["ef_search"];
+        if (!ef.is_number_unsigned() || ef.get<uint64_t>() == 0) {
+            throw std::invalid_argument("ef_search must be a positive integer");
+        }
+        options.ef_search = ef.get<size_t>();
+    }
+    if (request.contains("fields")) {
+        options.fields = parse_search_fields(request["fields"]);
+    }
+    return options;
+}
+
+// One search result with the selected fields.
+static nlohmann::json hit_json(const SearchHit& hit, const SearchFields& fields) {
+    nlohmann::json result = nlohmann::json::object();
+    if (fields.chunk_id) {
+        result["chunk_id"] = hit.chunk_id;
+    }
+    if (fields.score) {
+        result["score"] = hit.score;
+    }
+    if (fields.text) {
+        result["text"] = hit.text;
+    }
+    if (fields.metadata) {
+        result["metadata"] = hit.metadata();
+    } else if (!fields.metadata_keys.empty()) {
+        nlohmann::json all = hit.metadata();
+        nlohmann::json metadata = nlohmann::json::object();
+        for (const auto& key : fields.metadata_keys) {
+            auto it = all.find(key);
+            if (it != all.end()) {
+                metadata[key] = std::move(*it);
+            }
+        }
+        result["metadata"] = std::move(metadata);
+    }
+    return result;
+}
+
+Server::Server(const ServerOptions& options)
+    : host_(options.host), port_(options.port),
+      num_workers_(options.num_workers == 0 ? hardware_threads() : options.num_workers),
+      search_threads_(options.search_threads == 0 ? hardware_threads() : options.search_threads),
+      unix_path_(options.unix_path),
+      data_dir_(options.data_dir),
+      fsync_policy_(options.fsync),
+      db_(VectorDBOptions{search_threads_, options.quantize, options.hnsw,
+                          options.result_cache_bytes}),
+      embed_cache_(options.embed_cache_bytes),
+      compute_pool_(hardware_threads()),
+      started_(Clock::now()) {}
 
 Server::~Server() {
+    // Only reached with the checkpointer running if run() threw.
+    {
+        std::lock_guard<std::mutex> lock(checkpointer_mutex_);
+        checkpointer_stop_ = true;
+    }
+    checkpointer_cv_.notify_one();
+    if (checkpointer_.joinable()) {
+        checkpointer_.join();
+    }
+    db_.attach_wal(nullptr);
     if (listen_fd_ >= 0) {
         close(listen_fd_);
     }
+    for (int fd : wake_pipe_) {
+        if (fd >= 0) {
+            close(fd);
+        }
+    }
 }
 
 void Server::setup_socket() {
+    if (!unix_path_.empty()) {
+        setup_unix_socket();
+    } else {
+        setup_tcp_socket();
+    }
+
+    // Backlog: the kernel maximum, so a burst of connects is queued rather
+    // than refused while the poll loop catches up.
+    if (listen(listen_fd_, SOMAXCONN) < 0) {
+        close(listen_fd_);
+        listen_fd_ = -1;
+        throw std::runtime_error("Failed to listen: " + std::string(strerror(errno)));
+    }
+
+    // Non-blocking so run() can drain every pending connection per wakeup.
+    fcntl(listen_fd_, F_SETFL, O_NONBLOCK);
+}
+
+void Server::setup_tcp_socket() {
     listen_fd_ = socket(AF_INET, SOCK_STREAM, 0);
     if (listen_fd_ < 0) {
         throw std::runtime_error("Failed to create socket: " + std::string(strerror(errno)));
@@ -51,14 +279,127 @@ void Server::setup_socket() {
         throw std::runtime_error("Failed to bind: " + std::string(strerror(errno)));
     }
     freeaddrinfo(res);
+}
+
+void Server::setup_unix_socket() {
+    struct sockaddr_un addr{};
+    addr.sun_family = AF_UNIX;
+    if (unix_path_.size() >= sizeof(addr.sun_path)) {
+        throw std::runtime_error("Unix socket path too long: " + unix_path_);
+    }
+    std::memcpy(addr.sun_path, unix_path_.c_str(), unix_path_.size() + 1);
 
-    if (listen(listen_fd_, 8) < 0) {
+    // A socket file left by a server that did not shut down cleanly would
+    // make bind fail. Remove it, but never anything that is not a socket.
+    struct stat st;
+    if (lstat(unix_path_.c_str(), &st) == 0) {
+        if (!S_ISSOCK(st.st_mode)) {
+            throw std::runtime_error(unix_path_ + " exists and is not a socket");
+        }
+        unlink(unix_path_.c_str());
+    }
+
+    listen_fd_ = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listen_fd_ < 0) {
+        throw std::runtime_error("Failed to create socket: " + std::string(strerror(errno)));
+    }
+    if (bind(listen_fd_, reinterpret_cast<struct sockaddr*>(&addr), sizeof(addr)) < 0) {
         close(listen_fd_);
         listen_fd_ = -1;
-        throw std::runtime_error("Failed to listen: " + std::string(strerror(errno)));
+        throw std::runtime_error("Failed to bind " + unix_path_ + ": " + strerror(errno));
     }
 }
 
+std::string Server::snapshot_path() const {
+    return data_dir_ + "/vectordb.snapshot";
+}
+
+void Server::open_data_dir() {
+    if (mkdir(data_dir_.c_str(), 0755) < 0 && errno != EEXIST) {
+        throw std::runtime_error("Cannot create data dir " + data_dir_ + ": " + strerror(errno));
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    std::string path = snapshot_path();
+    struct stat st;
+    if (stat(path.c_str(), &st) == 0) {
+        db_.load_snapshot(path);
+        last_snapshot_bytes_ = static_cast<size_t>(st.st_size);
+    }
+
+    wal_ = std::make_unique<WriteAheadLog>(data_dir_, fsync_policy_);
+    size_t replayed = wal_->replay(db_.applied_lsn(),
+        [this](uint64_t lsn, WriteAheadLog::RecordType type, const char* payload, size_t length) {
+            db_.replay_wal_record(lsn, type, payload, length);
+        });
+    db_.attach_wal(wal_.get());
+
+    auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now() - start).count();
+    std::cout << "[vectordb] Restored " << db_.size() << " chunks from " << data_dir_
+              << " (" << replayed << " WAL records replayed) in " << ms << " ms" << std::endl;
+
+    checkpointer_ = std::thread(&Server::checkpointer_loop, this);
+}
+
+void Server::close_data_dir() {
+    {
+        std::lock_guard<std::mutex> lock(checkpointer_mutex_);
+        checkpointer_stop_ = true;
+    }
+    checkpointer_cv_.notify_one();
+    if (checkpointer_.joinable()) {
+        checkpointer_.join();
+    }
+    if (wal_) {
+        try {
+            checkpoint();
+        } catch (const std::exception& e) {
+            std::cerr << "[vectordb] Final checkpoint failed: " << e.what()
+                      << "; the WAL is replayed at the next start" << std::endl;
+        }
+        db_.attach_wal(nullptr);
+        wal_.reset();
+    }
+}
+
+void Server::checkpointer_loop() {
+    std::unique_lock<std::mutex> lock(checkpointer_mutex_);
+    while (!checkpointer_cv_.wait_for(lock, std::chrono::seconds(1),
+                                      [this] { return checkpointer_stop_; })) {
+        // Snapshot cost grows with the store, so wait for the WAL to match
+        // the last snapshot's size: amortized, each logged byte is
+        // rewritten into a snapshot about once.
+        size_t threshold = std::max(CHECKPOINT_MIN_WAL_BYTES, last_snapshot_bytes_);
+        if (wal_->bytes_since_checkpoint() < threshold) {
+            continue;
+        }
+        lock.unlock();
+        try {
+            checkpoint();
+        } catch (const std::exception& e) {
+            std::cerr << "[vectordb] Checkpoint failed: " << e.what() << std::endl;
+        }
+        lock.lock();
+    }
+}
+
+void Server::checkpoint() {
+    std::string path = snapshot_path();
+    auto start = std::chrono::steady_clock::now();
+    uint64_t lsn = db_.save_snapshot(path);
+    wal_->checkpoint(lsn);
+
+    struct stat st;
+    if (stat(path.c_str(), &st) == 0) {
+        last_snapshot_bytes_ = static_cast<size_t>(st.st_size);
+    }
+    auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now() - start).count();
+    std::cout << "[vectordb] Checkpoint: saved " << db_.size() << " chunks up to LSN " << lsn
+              << " to " << path << " in " << ms << " ms" << std::endl;
+}
+
 void Server::run() {
     // Ignore SIGPIPE so writing to a closed socket returns an error
     // instead of killing the process.
@@ -72,65 +413,284 @@ void Server::run() {
     sigaction(SIGINT, &sa, nullptr);
     sigaction(SIGTERM, &sa, nullptr);
 
+    if (!data_dir_.empty()) {
+        open_data_dir();
+    }
     setup_socket();
-    std::cout << "[vectordb] Listening on " << host_ << ":" << port_ << std::endl;
 
-    while (!shutdown_requested.load()) {
-        // Use select with timeout so we can check shutdown flag
-        fd_set fds;
-        FD_ZERO(&fds);
-        FD_SET(listen_fd_, &fds);
+    // Self-pipe: workers write a byte after handing a connection back so
+    // the poll loop picks it up without waiting for the timeout.
+    if (pipe(wake_pipe_) < 0) {
+        throw std::runtime_error("Failed to create wake pipe: " + std::string(strerror(errno)));
+    }
+    fcntl(wake_pipe_[0], F_SETFL, O_NONBLOCK);
+    fcntl(wake_pipe_[1], F_SETFL, O_NONBLOCK);
+
+    std::string address = unix_path_.empty()
+        ? host_ + ":" + std::to_string(port_)
+        : "unix:" + unix_path_;
+    std::cout << "[vectordb] Listening on " << address
+              << " (" << num_workers_ << " workers, " << search_threads_
+              << " search threads, " << simd::active_kernel()
+              << " kernels)" << std::endl;
 
-        struct timeval tv;
-        tv.tv_sec = 1;
-        tv.tv_usec = 0;
+    // Connections waiting for their next request. Owned by this loop; a
+    // connection is removed while a worker serves it and handed back via
+    // release_connection() afterwards, so idle keep-alive clients never
+    // occupy a worker.
+    std::vector<int> idle;
 
-        int ready = select(listen_fd_ + 1, &fds, nullptr, nullptr, &tv);
-        if (ready < 0) {
-            if (errno == EINTR) continue;
-            break;
+    {
+        // Scoped so the pool is drained and joined before the remaining
+        // idle connections are closed below.
+        ThreadPool workers(num_workers_);
+
+        std::vector<struct pollfd> pfds;
+        while (!shutdown_requested.load()) {
+            pfds.clear();
+            pfds.push_back({listen_fd_, POLLIN, 0});
+            pfds.push_back({wake_pipe_[0], POLLIN, 0});
+            for (int fd : idle) {
+                pfds.push_back({fd, POLLIN, 0});
+            }
+
+            // Timeout so we can check the shutdown flag
+            int ready = poll(pfds.data(), pfds.size(), 1000);
+            if (ready < 0) {
+                if (errno == EINTR) continue;
+                break;
+            }
+            if (ready == 0) continue;
+
+            // Hand readable (or hung-up) connections to the workers.
+            std::vector<int> still_idle;
+            still_idle.reserve(idle.size());
+            for (size_t i = 2; i < pfds.size(); ++i) {
+                int fd = pfds[i].fd;
+                if (pfds[i].revents == 0) {
+                    still_idle.push_back(fd);
+                    continue;
+                }
+                workers.submit([this, fd] { serve_connection(fd); });
+            }
+            idle.swap(still_idle);
+
+            if (pfds[1].revents & POLLIN) {
+                char drain[64];
+                while (read(wake_pipe_[0], drain, sizeof(drain)) > 0) {}
+
+                std::lock_guard<std::mutex> lock(returned_mutex_);
+                idle.insert(idle.end(), returned_.begin(), returned_.end());
+                returned_.clear();
+            }
+
+            if (pfds[0].revents & POLLIN) {
+                // Take every pending connection, not just one per wakeup.
+                while (true) {
+                    int client_fd = accept(listen_fd_, nullptr, nullptr);
+                    if (client_fd < 0) {
+                        if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+                            std::cerr << "[vectordb] Accept error: " << strerror(errno) << std::endl;
+                        }
+                        break;
+                    }
+                    configure_client(client_fd);
+                    connections_accepted_.fetch_add(1, std::memory_order_relaxed);
+                    connections_open_.fetch_add(1, std::memory_order_relaxed);
+                    idle.push_back(client_fd);
+                }
+            }
         }
-        if (ready == 0) continue; // timeout, check shutdown flag
+    }
 
-        int client_fd = accept(listen_fd_, nullptr, nullptr);
-        if (client_fd < 0) {
-            if (errno == EINTR) continue;
-            std::cerr << "[vectordb] Accept error: " << strerror(errno) << std::endl;
-            continue;
+    for (int fd : idle) {
+        close_connection(fd);
+    }
+    {
+        std::lock_guard<std::mutex> lock(returned_mutex_);
+        for (int fd : returned_) {
+            close_connection(fd);
         }
+        returned_.clear();
+    }
+
+    std::cout << "\n[vectordb] Shutting down (embed cache: " << embed_cache_.hits()
+              << " hits, " << embed_cache_.misses() << " misses; result cache: "
+              << db_.result_cache_hits() << " hits, " << db_.result_cache_misses()
+              << " misses)." << std::endl;
+    if (!unix_path_.empty()) {
+        unlink(unix_path_.c_str());
+    }
+    if (!data_dir_.empty()) {
+        close_data_dir();
+    }
+}
+
+void Server::configure_client(int client_fd) {
+    // Some platforms hand out accepted sockets with the listener's
+    // O_NONBLOCK; workers rely on blocking reads with a timeout.
+    int flags = fcntl(client_fd, F_GETFL);
+    if (flags >= 0) {
+        fcntl(client_fd, F_SETFL, flags & ~O_NONBLOCK);
+    }
 
-        handle_connection(client_fd);
-        close(client_fd);
+    struct timeval io_timeout;
+    io_timeout.tv_sec = CLIENT_IO_TIMEOUT_SEC;
+    io_timeout.tv_usec = 0;
+    setsockopt(client_fd, SOL_SOCKET, SO_RCVTIMEO, &io_timeout, sizeof(io_timeout));
+    setsockopt(client_fd, SOL_SOCKET, SO_SNDTIMEO, &io_timeout, sizeof(io_timeout));
+
+    if (unix_path_.empty()) {
+        int nodelay = 1;
+        setsockopt(client_fd, IPPROTO_TCP, TCP_NODELAY, &nodelay, sizeof(nodelay));
+    }
+}
+
+void Server::release_connection(int client_fd) {
+    {
+        std::lock_guard<std::mutex> lock(returned_mutex_);
+        returned_.push_back(client_fd);
     }
+    char byte = 1;
+    // A full pipe already guarantees a pending wakeup, so EAGAIN is fine.
+    ssize_t ignored = write(wake_pipe_[1], &byte, 1);
+    (void)ignored;
+}
+
+void Server::close_connection(int client_fd) {
+    close(client_fd);
+    connections_open_.fetch_sub(1, std::memory_order_relaxed);
+}
 
-    std::cout << "\n[vectordb] Shutting down." << std::endl;
+void Server::serve_connection(int client_fd) {
+    for (size_t served = 0; served < MAX_REQUESTS_PER_TURN; ++served) {
+        if (!handle_request(client_fd)) {
+            close_connection(client_fd);
+            return;
+        }
+        // A pipelining client usually has its next frame buffered already;
+        // serving it here saves a round trip through the poll loop.
+        struct pollfd pfd = {client_fd, POLLIN, 0};
+        if (poll(&pfd, 1, 0) <= 0) {
+            break;
+        }
+    }
+    release_connection(client_fd);
 }
 
-void Server::handle_connection(int client_fd) {
+bool Server::handle_request(int client_fd) {
+    std::string msg;
+    bool http = false;
     try {
-        std::string msg = read_message(client_fd);
-        nlohmann::json request = nlohmann::json::parse(msg);
-        nlohmann::json response = dispatch(request);
-        write_message(client_fd, response.dump());
-    } catch (const nlohmann::json::parse_error& e) {
-        nlohmann::json err = {{"status", "error"}, {"message", std::string("JSON parse error: ") + e.what()}};
-        write_message(client_fd, err.dump());
+        if (!read_message(client_fd, msg, http)) {
+            return false; // client closed the connection
+        }
     } catch (const std::exception& e) {
+        // Framing is lost (bad length, timeout, reset): report and drop.
         nlohmann::json err = {{"status", "error"}, {"message", e.what()}};
         try {
             write_message(client_fd, err.dump());
         } catch (...) {
             // Client may have disconnected; ignore write failure
         }
+        return false;
+    }
+
+    if (http) {
+        serve_http(client_fd);
+        return false;
+    }
+
+    // A complete frame was consumed, so the connection stays usable even
+    // when the request itself fails. Timing starts here: neither idle time
+    // nor a slow client's upload counts towards the request's latency.
+    Clock::time_point received = Clock::now();
+    requests_in_flight_.fetch_add(1, std::memory_order_relaxed);
+    Encoding encoding = detect_encoding(msg);
+    nlohmann::json response;
+    Action action = Action::Unknown;
+    Clock::duration serialize_time{};
+    nlohmann::json id;
+    try {
+        nlohmann::json request = encoding == Encoding::MsgPack
+            ? nlohmann::json::from_msgpack(msg)
+            : nlohmann::json::parse(msg);
+        // Taken before anything can throw, so an error reply to a
+        // pipelined request still names the request it answers.
+        try {
+            auto id_field = request.find("id");
+            if (id_field != request.end()) {
+                id = std::move(*id_field);
+            }
+        } catch (const nlohmann::json::exception&) {
+        }
+        action = action_of(request);
+        response = dispatch(action, request, serialize_time);
+    } catch (const nlohmann::json::parse_error& e) {
+        const char* kind = encoding == Encoding::MsgPack ? "MessagePack" : "JSON";
+        response = {{"status", "error"}, {"message", std::string(kind) + " parse error: " + e.what()}};
+    } catch (const std::exception& e) {
+        response = {{"status", "error"}, {"message", e.what()}};
+    }
+    if (!id.is_null()) {
+        response["id"] = std::move(id);
+    }
+
+    bool written = true;
+    try {
+        Clock::time_point encode_start = Clock::now();
+        std::string payload = encode(response, encoding);
+        serialize_time += Clock::now() - encode_start;
+        write_message(client_fd, payload);
+    } catch (const std::exception&) {
+        written = false;
+    }
+
+    requests_in_flight_.fetch_sub(1, std::memory_order_relaxed);
+    if (action != Action::Unknown) {
+        ActionMetrics& metrics = metrics_[static_cast<size_t>(action)];
+        metrics.phases[static_cast<size_t>(Phase::Serialize)].record(serialize_time);
+        metrics.latency.record(Clock::now() - received);
+        auto status = response.find("status");
+        if (status != response.end() && *status == "error") {
+            metrics.errors.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+    return written;
+}
+
+Server::Encoding Server::detect_encoding(const std::string& payload) {
+    // Every request is an object. A JSON object starts with '{', possibly
+    // after whitespace; a MessagePack map starts with a fixmap (0x80-0x8f),
+    // map16 (0xde) or map32 (0xdf) marker, none of which is valid JSON.
+    if (!payload.empty()) {
+        auto first = static_cast<unsigned char>(payload[0]);
+        if ((first & 0xF0) == 0x80 || first == 0xDE || first == 0xDF) {
+            return Encoding::MsgPack;
+        }
     }
+    return Encoding::Json;
 }
 
-std::string Server::read_message(int fd) {
+std::string Server::encode(const nlohmann::json& response, Encoding encoding) {
+    if (encoding == Encoding::MsgPack) {
+        std::string out;
+        nlohmann::json::to_msgpack(response, out);
+        return out;
+    }
+    return response.dump();
+}
+
+bool Server::read_message(int fd, std::string& payload, bool& http) {
     // Read 4-byte length header (big-endian)
     uint8_t len_buf[4];
     size_t total = 0;
     while (total < 4) {
         ssize_t n = read(fd, len_buf + total, 4 - total);
+        if (n < 0 && errno == EINTR) continue;
+        if (n == 0 && total == 0) {
+            return false; // orderly shutdown between messages
+        }
         if (n <= 0) {
             throw std::runtime_error("Failed to read message length");
         }
@@ -142,22 +702,28 @@ std::string Server::read_message(int fd) {
                       (static_cast<uint32_t>(len_buf[2]) << 8)  |
                       (static_cast<uint32_t>(len_buf[3]));
 
+    if (std::memcmp(len_buf, "GET ", 4) == 0) {
+        http = true;
+        return true;
+    }
+
     if (length == 0 || length > 10 * 1024 * 1024) {
         throw std::runtime_error("Invalid message length: " + std::to_string(length));
     }
 
     // Read payload
-    std::string payload(length, '\0');
+    payload.assign(length, '\0');
     total = 0;
     while (total < length) {
         ssize_t n = read(fd, &payload[total], length - total);
+        if (n < 0 && errno == EINTR) continue;
         if (n <= 0) {
             throw std::runtime_error("Failed to read message payload");
         }
         total += static_cast<size_t>(n);
     }
 
-    return payload;
+    return true;
 }
 
 void Server::write_message(int fd, const std::string& msg) {
@@ -169,78 +735,474 @@ void Server::write_message(int fd, const std::string& msg) {
         static_cast<uint8_t>(length & 0xFF)
     };
 
-    size_t total = 0;
-    while (total < 4) {
-        ssize_t n = write(fd, len_buf + total, 4 - total);
+    // Header and payload go out in one writev() so a persistent connection
+    // never leaves a 4-byte header waiting on Nagle/delayed-ACK.
+    struct iovec iov[2];
+    iov[0].iov_base = len_buf;
+    iov[0].iov_len = 4;
+    iov[1].iov_base = const_cast<char*>(msg.data());
+    iov[1].iov_len = msg.size();
+
+    struct iovec* cur = iov;
+    int iov_count = 2;
+    while (iov_count > 0) {
+        ssize_t n = writev(fd, cur, iov_count);
+        if (n < 0 && errno == EINTR) continue;
         if (n <= 0) {
-            throw std::runtime_error("Failed to write message length");
+            throw std::runtime_error("Failed to write message");
+        }
+        size_t written = static_cast<size_t>(n);
+        while (iov_count > 0 && written >= cur->iov_len) {
+            written -= cur->iov_len;
+            ++cur;
+            --iov_count;
+        }
+        if (iov_count > 0) {
+            cur->iov_base = static_cast<char*>(cur->iov_base) + written;
+            cur->iov_len -= written;
         }
-        total += static_cast<size_t>(n);
     }
+}
 
-    total = 0;
-    while (total < msg.size()) {
-        ssize_t n = write(fd, msg.data() + total, msg.size() - total);
-        if (n <= 0) {
-            throw std::runtime_error("Failed to write message payload");
+Server::Action Server::action_of(const nlohmann::json& request) {
+    static_assert(sizeof(ACTION_NAMES) / sizeof(ACTION_NAMES[0]) == NUM_ACTIONS &&
+                  sizeof(PHASE_NAMES) / sizeof(PHASE_NAMES[0]) == NUM_PHASES,
+                  "one name per action and phase");
+    auto it = request.find("action");
+    if (it == request.end() || !it->is_string()) {
+        return Action::Unknown;
+    }
+    const std::string& action = it->get_ref<const std::string&>();
+    for (size_t i = 0; i < NUM_ACTIONS; ++i) {
+        if (action == ACTION_NAMES[i]) {
+            return static_cast<Action>(i);
         }
-        total += static_cast<size_t>(n);
     }
+    return Action::Unknown;
 }
 
-nlohmann::json Server::dispatch(const nlohmann::json& request) {
-    if (!request.contains("action") || !request["action"].is_string()) {
-        return {{"status", "error"}, {"message", "Missing or invalid 'action' field"}};
+nlohmann::json Server::dispatch(Action action, nlohmann::json& request,
+                                Clock::duration& serialize_time) {
+    switch (action) {
+    case Action::Store:
+        return handle_store(request);
+    case Action::StoreBatch:
+        return handle_store_batch(request);
+    case Action::Search:
+        return handle_search(request, serialize_time);
+    case Action::SearchBatch:
+        return handle_search_batch(request, serialize_time);
+    case Action::DeleteDoc:
+        return handle_delete_doc(request);
+    case Action::DeleteChunk:
+        return handle_delete_chunk(request);
+    case Action::DiffChunks:
+        return handle_diff_chunks(request);
+    case Action::Stats:
+        return handle_stats(request);
+    case Action::Unknown:
+        break;
     }
 
-    const std::string& action = request["action"].get_ref<const std::string&>();
-
-    if (action == "store") {
-        return handle_store(request);
-    } else if (action == "search") {
-        return handle_search(request);
-    } else {
-        return {{"status", "error"}, {"message", "Unknown action: " + action}};
+    if (!request.contains("action") || !request["action"].is_string()) {
+        return {{"status", "error"}, {"message", "Missing or invalid 'action' field"}};
     }
+    return {{"status", "error"},
+            {"message", "Unknown action: " + request["action"].get<std::string>()}};
 }
 
-nlohmann::json Server::handle_store(const nlohmann::json& request) {
+nlohmann::json Server::handle_store(nlohmann::json& request) {
     if (!request.contains("chunk_id") || !request.contains("doc_id") || !request.contains("text")) {
         return {{"status", "error"}, {"message", "store requires chunk_id, doc_id, and text"}};
     }
 
-    const std::string& chunk_id = request["chunk_id"].get_ref<const std::string&>();
-    const std::string& doc_id = request["doc_id"].get_ref<const std::string&>();
-    const std::string& text = request["text"].get_ref<const std::string&>();
-    nlohmann::json metadata = request.value("metadata", nlohmann::json::object());
-
-    std::vector<float> embedding = embed(text);
-    db_.store(chunk_id, doc_id, text, metadata, embedding);
+    VectorEntry entry;
+    entry.chunk_id = std::move(request["chunk_id"].get_ref<std::string&>());
+    entry.doc_id = std::move(request["doc_id"].get_ref<std::string&>());
+    entry.text = std::move(request["text"].get_ref<std::string&>());
+    entry.metadata = take_metadata(request);
+    entry.content_hash = take_content_hash(request);
+    Clock::time_point embed_start = Clock::now();
+    entry.embedding = embed_cache_.embed(entry.text);
+    Clock::time_point write_start = Clock::now();
+    db_.store(std::move(entry));
+    record_phase(Action::Store, Phase::Embed, write_start - embed_start);
+    record_phase(Action::Store, Phase::Write, Clock::now() - write_start);
 
     return {{"status", "ok"}};
 }
 
-nlohmann::json Server::handle_search(const nlohmann::json& request) {
+nlohmann::json Server::handle_store_batch(nlohmann::json& request) {
+    if (!request.contains("chunks") || !request["chunks"].is_array()) {
+        return {{"status", "error"}, {"message", "store_batch requires a chunks array"}};
+    }
+
+    // Validate and move out every chunk first so a bad entry rejects the
+    // whole batch before anything is stored.
+    auto& chunks = request["chunks"];
+    std::vector<VectorEntry> entries(chunks.size());
+    for (size_t i = 0; i < chunks.size(); ++i) {
+        auto& chunk = chunks[i];
+        if (!chunk.is_object() || !chunk.contains("chunk_id") ||
+            !chunk.contains("doc_id") || !chunk.contains("text")) {
+            return {{"status", "error"},
+                    {"message", "store_batch chunk " + std::to_string(i) +
+                                " requires chunk_id, doc_id, and text"}};
+        }
+        entries[i].chunk_id = std::move(chunk["chunk_id"].get_ref<std::string&>());
+        entries[i].doc_id = std::move(chunk["doc_id"].get_ref<std::string&>());
+        entries[i].text = std::move(chunk["text"].get_ref<std::string&>());
+        entries[i].metadata = take_metadata(chunk);
+        entries[i].content_hash = take_content_hash(chunk);
+    }
+
+    Clock::time_point embed_start = Clock::now();
+    compute_pool_.parallel_for(entries.size(), [this, &entries](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+            entries[i].embedding = embed_cache_.embed(entries[i].text);
+        }
+    });
+
+    size_t stored = entries.size();
+    Clock::time_point write_start = Clock::now();
+    db_.store_batch(std::move(entries));
+    record_phase(Action::StoreBatch, Phase::Embed, write_start - embed_start);
+    record_phase(Action::StoreBatch, Phase::Write, Clock::now() - write_start);
+
+    return {{"status", "ok"}, {"stored", stored}};
+}
+
+nlohmann::json Server::handle_search(const nlohmann::json& request,
+                                     Clock::duration& serialize_time) {
     if (!request.contains("query")) {
         return {{"status", "error"}, {"message", "search requires query"}};
     }
 
     const std::string& query = request["query"].get_ref<const std::string&>();
-    int top_k = request.value("top_k", 5);
-    std::string doc_id_filter = request.value("doc_id", std::string(""));
-
-    std::vector<float> query_embedding = embed(query);
-    auto results = db_.search(query_embedding, top_k, doc_id_filter);
+    SearchOptions options;
+    try {
+        options = parse_search_options(request);
+    } catch (const std::invalid_argument& e) {
+        return {{"status", "error"}, {"message", e.what()}};
+    }
 
+    // Results are serialized straight from the store's entries, so text
+    // and metadata that were not asked for are never copied or decoded.
+    // That happens inside the search, so its time is split out of the scan.
+    Clock::time_point embed_start = Clock::now();
+    SparseVector query_embedding = embed_cache_.embed(query);
+    Clock::time_point scan_start = Clock::now();
+    Clock::duration build_time{};
     nlohmann::json result_array = nlohmann::json::array();
-    for (const auto& r : results) {
-        result_array.push_back({
-            {"chunk_id", r.chunk_id},
-            {"score", r.score},
-            {"text", r.text},
-            {"metadata", r.metadata}
-        });
-    }
+    db_.search(query_embedding, options.top_k, options.doc_id_filter, options.mode,
+               options.ef_search, [&](const SearchHit& hit) {
+        Clock::time_point build_start = Clock::now();
+        result_array.push_back(hit_json(hit, options.fields));
+        build_time += Clock::now() - build_start;
+    });
+    record_phase(Action::Search, Phase::Embed, scan_start - embed_start);
+    record_phase(Action::Search, Phase::Scan, Clock::now() - scan_start - build_time);
+    serialize_time += build_time;
 
     return {{"status", "ok"}, {"results", result_array}};
 }
+
+nlohmann::json Server::handle_search_batch(const nlohmann::json& request,
+                                           Clock::duration& serialize_time) {
+    if (!request.contains("queries") || !request["queries"].is_array()) {
+        return {{"status", "error"}, {"message", "search_batch requires a queries array"}};
+    }
+    const auto& queries = request["queries"];
+    for (const auto& query : queries) {
+        if (!query.is_string()) {
+            return {{"status", "error"}, {"message", "search_batch queries must be strings"}};
+        }
+    }
+    SearchOptions options;
+    try {
+        options = parse_search_options(request);
+    } catch (const std::invalid_argument& e) {
+        return {{"status", "error"}, {"message", e.what()}};
+    }
+
+    Clock::time_point embed_start = Clock::now();
+    std::vector<SparseVector> embeddings;
+    embeddings.reserve(queries.size());
+    for (const auto& query : queries) {
+        embeddings.push_back(embed_cache_.embed(query.get_ref<const std::string&>()));
+    }
+    Clock::time_point scan_start = Clock::now();
+    Clock::duration build_time{};
+    nlohmann::json result_arrays(queries.size(), nlohmann::json::array());
+    db_.search_batch(embeddings, options.top_k, options.doc_id_filter, options.mode,
+                     options.ef_search, [&](size_t i, const SearchHit& hit) {
+        Clock::time_point build_start = Clock::now();
+        result_arrays[i].push_back(hit_json(hit, options.fields));
+        build_time += Clock::now() - build_start;
+    });
+    record_phase(Action::SearchBatch, Phase::Embed, scan_start - embed_start);
+    record_phase(Action::SearchBatch, Phase::Scan, Clock::now() - scan_start - build_time);
+    serialize_time += build_time;
+
+    return {{"status", "ok"}, {"results", std::move(result_arrays)}};
+}
+
+nlohmann::json Server::handle_delete_doc(const nlohmann::json& request) {
+    if (!request.contains("doc_id")) {
+        return {{"status", "error"}, {"message", "delete_doc requires doc_id"}};
+    }
+
+    const std::string& doc_id = request["doc_id"].get_ref<const std::string&>();
+    Clock::time_point write_start = Clock::now();
+    size_t deleted = db_.delete_doc(doc_id);
+    record_phase(Action::DeleteDoc, Phase::Write, Clock::now() - write_start);
+
+    return {{"status", "ok"}, {"deleted", deleted}};
+}
+
+nlohmann::json Server::handle_delete_chunk(const nlohmann::json& request) {
+    if (!request.contains("chunk_id")) {
+        return {{"status", "error"}, {"message", "delete_chunk requires chunk_id"}};
+    }
+
+    const std::string& chunk_id = request["chunk_id"].get_ref<const std::string&>();
+    Clock::time_point write_start = Clock::now();
+    size_t deleted = db_.delete_chunk(chunk_id);
+    record_phase(Action::DeleteChunk, Phase::Write, Clock::now() - write_start);
+
+    return {{"status", "ok"}, {"deleted", deleted}};
+}
+
+nlohmann::json Server::handle_diff_chunks(const nlohmann::json& request) {
+    if (!request.contains("chunks") || !request["chunks"].is_array()) {
+        return {{"status", "error"}, {"message", "diff_chunks requires a chunks array"}};
+    }
+    const auto& chunks = request["chunks"];
+    std::vector<std::string> chunk_ids;
+    chunk_ids.reserve(chunks.size());
+    for (size_t i = 0; i < chunks.size(); ++i) {
+        const auto& chunk = chunks[i];
+        if (!chunk.is_object() || !chunk.contains("chunk_id") || !chunk["chunk_id"].is_string() ||
+            !chunk.contains("content_hash") || !chunk["content_hash"].is_string()) {
+            return {{"status", "error"},
+                    {"message", "diff_chunks chunk " + std::to_string(i) +
+                                " requires chunk_id and content_hash strings"}};
+        }
+        chunk_ids.push_back(chunk["chunk_id"].get<std::string>());
+    }
+
+    // Unchanged chunks come back with the selected fields (only chunk_id
+    // by default), so a client can reuse what it stored with them.
+    SearchFields fields;
+    fields.text = fields.metadata = false;
+    if (request.contains("fields")) {
+        try {
+            fields = parse_search_fields(request["fields"]);
+        } catch (const std::invalid_argument& e) {
+            return {{"status", "error"}, {"message", e.what()}};
+        }
+        fields.chunk_id = true;
+    }
+    fields.score = false;
+
+    // A chunk stored without a hash cannot be shown current, so it counts
+    // as changed.
+    Clock::time_point scan_start = Clock::now();
+    std::vector<uint8_t> current(chunks.size(), 0);
+    nlohmann::json unchanged = nlohmann::json::array();
+    db_.lookup(chunk_ids, [&](size_t i, std::string_view hash, const SearchHit& hit) {
+        if (!hash.empty() && hash == chunks[i]["content_hash"].get_ref<const std::string&>()) {
+            current[i] = 1;
+            unchanged.push_back(hit_json(hit, fields));
+        }
+    });
+    nlohmann::json changed = nlohmann::json::array();
+    for (size_t i = 0; i < chunk_ids.size(); ++i) {
+        if (!current[i]) {
+            changed.push_back(chunk_ids[i]);
+        }
+    }
+    nlohmann::json response = {
+        {"status", "ok"}, {"changed", std::move(changed)}, {"unchanged", std::move(unchanged)}};
+
+    // With a doc_id, also name the doc's chunks the list no longer has.
+    if (request.contains("doc_id")) {
+        std::unordered_set<std::string_view> listed(chunk_ids.begin(), chunk_ids.end());
+        nlohmann::json stale = nlohmann::json::array();
+        for (const auto& chunk_id : db_.doc_chunk_ids(request["doc_id"].get<std::string>())) {
+            if (listed.count(chunk_id) == 0) {
+                stale.push_back(chunk_id);
+            }
+        }
+        response["stale"] = std::move(stale);
+    }
+    record_phase(Action::DiffChunks, Phase::Scan, Clock::now() - scan_start);
+    return response;
+}
+
+nlohmann::json Server::handle_stats(const nlohmann::json& request) {
+    std::string format = request.value("format", std::string("json"));
+    if (format == "json") {
+        nlohmann::json response = stats_json();
+        response["status"] = "ok";
+        return response;
+    } else if (format == "prometheus") {
+        return {{"status", "ok"}, {"text", metrics_text()}};
+    } else {
+        return {{"status", "error"}, {"message", "Unknown stats format: " + format}};
+    }
+}
+
+nlohmann::json Server::stats_json() const {
+    // Whole nanoseconds, in microseconds.
+    auto micros = [](double seconds) { return std::round(seconds * 1e9) / 1e3; };
+    auto summary_json = [&](const LatencyHistogram::Summary& s) {
+        return nlohmann::json{
+            {"count", s.count},
+            {"mean_us", s.count == 0 ? 0.0 : micros(s.sum_seconds) / static_cast<double>(s.count)},
+            {"p50_us", micros(s.p50_seconds)},
+            {"p99_us", micros(s.p99_seconds)},
+            {"p999_us", micros(s.p999_seconds)},
+            {"max_us", micros(s.max_seconds)},
+        };
+    };
+
+    nlohmann::json actions = nlohmann::json::object();
+    for (size_t a = 0; a < NUM_ACTIONS; ++a) {
+        const ActionMetrics& metrics = metrics_[a];
+        nlohmann::json entry = summary_json(metrics.latency.summarize());
+        entry["errors"] = metrics.errors.load(std::memory_order_relaxed);
+        nlohmann::json phases = nlohmann::json::object();
+        for (size_t p = 0; p < NUM_PHASES; ++p) {
+            LatencyHistogram::Summary phase = metrics.phases[p].summarize();
+            if (phase.count > 0) {
+                phases[PHASE_NAMES[p]] = summary_json(phase);
+            }
+        }
+        entry["phases"] = std::move(phases);
+        actions[ACTION_NAMES[a]] = std::move(entry);
+    }
+
+    VectorDBStats store = db_.stats();
+    return {
+        {"uptime_seconds", std::chrono::duration<double>(Clock::now() - started_).count()},
+        {"actions", std::move(actions)},
+        {"store", {
+            {"entries", store.entries},
+            {"docs", store.docs},
+            {"slots", store.slots},
+            {"live_nnz", store.live_nnz},
+            {"dead_nnz", store.dead_nnz},
+            {"live_string_bytes", store.live_string_bytes},
+            {"dead_string_bytes", store.dead_string_bytes},
+            {"heap_bytes", store.heap_bytes},
+            {"mapped_bytes", store.mapped_bytes},
+        }},
+        {"resident_bytes", resident_bytes()},
+        {"connections", {
+            {"open", connections_open_.load(std::memory_order_relaxed)},
+            {"accepted", connections_accepted_.load(std::memory_order_relaxed)},
+            {"requests_in_flight", requests_in_flight_.load(std::memory_order_relaxed)},
+        }},
+        {"embed_cache", {{"hits", embed_cache_.hits()}, {"misses", embed_cache_.misses()}}},
+        {"result_cache", {{"hits", db_.result_cache_hits()}, {"misses", db_.result_cache_misses()}}},
+    };
+}
+
+std::string Server::metrics_text() const {
+    PrometheusWriter out;
+    for (size_t a = 0; a < NUM_ACTIONS; ++a) {
+        out.summary("vectordb_request_duration_seconds",
+                    "Time from a request's frame arriving to its response written.",
+                    std::string("action=\"") + ACTION_NAMES[a] + "\"",
+                    metrics_[a].latency.summarize());
+    }
+    for (size_t a = 0; a < NUM_ACTIONS; ++a) {
+        for (size_t p = 0; p < NUM_PHASES; ++p) {
+            LatencyHistogram::Summary phase = metrics_[a].phases[p].summarize();
+            if (phase.count > 0) {
+                out.summary("vectordb_request_phase_duration_seconds",
+                            "Time requests spend embedding, writing, scanning and serializing.",
+                            std::string("action=\"") + ACTION_NAMES[a] + "\",phase=\"" +
+                                PHASE_NAMES[p] + "\"",
+                            phase);
+            }
+        }
+    }
+    for (size_t a = 0; a < NUM_ACTIONS; ++a) {
+        out.counter("vectordb_request_errors_total", "Requests answered with an error.",
+                    std::string("action=\"") + ACTION_NAMES[a] + "\"",
+                    metrics_[a].errors.load(std::memory_order_relaxed));
+    }
+
+    VectorDBStats store = db_.stats();
+    out.gauge("vectordb_entries", "Live entries in the store.", "",
+              static_cast<double>(store.entries));
+    out.gauge("vectordb_docs", "Documents with at least one live entry.", "",
+              static_cast<double>(store.docs));
+    out.gauge("vectordb_dead_nnz", "Embedding elements of deleted or overwritten entries "
+              "awaiting compaction.", "", static_cast<double>(store.dead_nnz));
+    out.gauge("vectordb_store_heap_bytes", "Approximate heap held by the store.", "",
+              static_cast<double>(store.heap_bytes));
+    out.gauge("vectordb_store_mapped_bytes", "Snapshot bytes mapped in place.", "",
+              static_cast<double>(store.mapped_bytes));
+    out.gauge("vectordb_resident_memory_bytes", "Resident set size of the process.", "",
+              static_cast<double>(resident_bytes()));
+    out.gauge("vectordb_connections_open", "Client connections currently open.", "",
+              static_cast<double>(connections_open_.load(std::memory_order_relaxed)));
+    out.counter("vectordb_connections_accepted_total", "Client connections accepted.", "",
+                connections_accepted_.load(std::memory_order_relaxed));
+    out.gauge("vectordb_requests_in_flight", "Requests being served right now.", "",
+              static_cast<double>(requests_in_flight_.load(std::memory_order_relaxed)));
+    out.counter("vectordb_embed_cache_hits_total", "Embeddings served from the cache.", "",
+                embed_cache_.hits());
+    out.counter("vectordb_embed_cache_misses_total", "Embeddings computed.", "",
+                embed_cache_.misses());
+    out.counter("vectordb_result_cache_hits_total", "Searches answered from the cache.", "",
+                db_.result_cache_hits());
+    out.counter("vectordb_result_cache_misses_total", "Searches computed.", "",
+                db_.result_cache_misses());
+    out.gauge("vectordb_uptime_seconds", "Seconds since the server started.", "",
+              std::chrono::duration<double>(Clock::now() - started_).count());
+    return out.text();
+}
+
+void Server::serve_http(int fd) {
+    // read_message() consumed "GET "; the request line continues with the
+    // path. Read the rest of the head (bounded) so the client sees a clean
+    // close, then answer and let the caller close.
+    std::string head;
+    char buf[1024];
+    while (head.find("\r\n\r\n") == std::string::npos && head.size() < HTTP_MAX_HEAD_BYTES) {
+        ssize_t n = read(fd, buf, sizeof(buf));
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) {
+            return;
+        }
+        head.append(buf, static_cast<size_t>(n));
+    }
+
+    std::string path = head.substr(0, head.find_first_of(" \r\n"));
+    std::string status = "200 OK";
+    std::string body;
+    if (path == "/metrics" || path.compare(0, 9, "/metrics?") == 0) {
+        body = metrics_text();
+    } else {
+        status = "404 Not Found";
+        body = "Not found: try /metrics\n";
+    }
+    std::string response = "HTTP/1.1 " + status +
+                           "\r\nContent-Type: text/plain; version=0.0.4; charset=utf-8"
+                           "\r\nContent-Length: " + std::to_string(body.size()) +
+                           "\r\nConnection: close\r\n\r\n" + body;
+
+    size_t sent = 0;
+    while (sent < response.size()) {
+        ssize_t n = write(fd, response.data() + sent, response.size() - sent);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) {
+            return;
+        }
+        sent += static_cast<size_t>(n);
+    }
+}
@@ -1,18 +1,67 @@
 #pragma once
 
+#include <array>
 #include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <memory>
+#include <mutex>
 #include <string>
+#include <thread>
+#include <vector>
 
 #include <nlohmann/json.hpp>
 
+#include "embed_cache.hpp"
+#include "metrics.hpp"
+#include "thread_pool.hpp"
 #include "vector_db.hpp"
+#include "wal.hpp"
+
+struct ServerOptions {
+    std::string host = "localhost";
+    int port = 50051;
+    size_t num_workers = 0;    // 0 = std::thread::hardware_concurrency()
+    size_t search_threads = 0; // 0 = std::thread::hardware_concurrency()
+
+    // See VectorDBOptions.
+    bool quantize = false;
+    bool hnsw = false;
+
+    // Memory for embeddings of recently seen texts (queries and stored
+    // chunks); 0 disables the cache.
+    size_t embed_cache_bytes = 64 << 20;
+
+    // See VectorDBOptions; 0 disables the cache.
+    size_t result_cache_bytes = 16 << 20;
+
+    // Listen on this Unix domain socket instead of host:port.
+    std::string unix_path;
+
+    // Directory holding the snapshot and write-ahead log. Empty keeps the
+    // store in memory only.
+    std::string data_dir;
+    FsyncPolicy fsync = FsyncPolicy::Always;
+};
 
 class Server {
 public:
-    Server(const std::string& host, int port);
+    explicit Server(const ServerOptions& options);
     ~Server();
 
-    // Main accept loop. Blocks until shutdown.
+    // With a data_dir, first restores the store from the last snapshot
+    // plus the WAL written since; stores are logged while serving and a
+    // final checkpoint is taken on shutdown.
+    //
+    // Main event loop. Connections are persistent: each one may carry any
+    // number of framed requests until the client closes it. Idle
+    // connections wait in a poll() set; a connection with a pending request
+    // is handed to one of num_workers threads. Blocks until shutdown.
+    //
+    // Clients may pipeline: requests on one connection are answered in
+    // order, and a request's "id" (any JSON value) is echoed in its
+    // response, so a client can keep several in flight and match them up.
     void run();
 
     // Signal handler sets this to trigger clean shutdown.
@@ -21,17 +70,111 @@ public:
 private:
     std::string host_;
     int port_;
+    size_t num_workers_;
+    size_t search_threads_;
+    std::string unix_path_;
+    std::string data_dir_;
+    FsyncPolicy fsync_policy_;
     int listen_fd_ = -1;
+    int wake_pipe_[2] = {-1, -1};
     VectorDB db_;
+    EmbedCache embed_cache_;
+
+    // Durability, when data_dir_ is set. The checkpointer thread folds the
+    // WAL into a new snapshot once it outgrows the last one.
+    std::unique_ptr<WriteAheadLog> wal_;
+    std::thread checkpointer_;
+    std::mutex checkpointer_mutex_;
+    std::condition_variable checkpointer_cv_;
+    bool checkpointer_stop_ = false;
+    size_t last_snapshot_bytes_ = 0;
+
+    // CPU-bound helpers (batch embedding). Separate from the connection
+    // workers so a worker can block on it without starving itself.
+    ThreadPool compute_pool_;
+
+    // Connections handed back by workers, merged into the idle set by run().
+    std::mutex returned_mutex_;
+    std::vector<int> returned_;
+
+    // Request accounting for the stats action and the /metrics page. Only
+    // atomics are touched on the request path, so recording never waits.
+    using Clock = std::chrono::steady_clock;
+    enum class Action {
+        Store, StoreBatch, Search, SearchBatch, DeleteDoc, DeleteChunk, DiffChunks, Stats,
+        Unknown
+    };
+    static constexpr size_t NUM_ACTIONS = static_cast<size_t>(Action::Unknown);
+    // Where a request's time goes: embedding its text, applying a store
+    // or delete, searching, and building plus encoding the response.
+    enum class Phase { Embed, Write, Scan, Serialize, Count };
+    static constexpr size_t NUM_PHASES = static_cast<size_t>(Phase::Count);
+    struct ActionMetrics {
+        LatencyHistogram latency; // frame received to response written
+        std::array<LatencyHistogram, NUM_PHASES> phases;
+        std::atomic<uint64_t> errors{0};
+    };
+    std::array<ActionMetrics, NUM_ACTIONS> metrics_;
+    std::atomic<uint64_t> connections_accepted_{0};
+    std::atomic<uint64_t> connections_open_{0};
+    std::atomic<uint64_t> requests_in_flight_{0};
+    Clock::time_point started_;
+
+    void record_phase(Action action, Phase phase, Clock::duration elapsed) {
+        metrics_[static_cast<size_t>(action)].phases[static_cast<size_t>(phase)].record(elapsed);
+    }
+    static Action action_of(const nlohmann::json& request);
+    nlohmann::json stats_json() const;
+    std::string metrics_text() const;
 
     void setup_socket();
-    void handle_connection(int client_fd);
+    void setup_tcp_socket();
+    void setup_unix_socket();
+    void configure_client(int client_fd);
+    std::string snapshot_path() const;
+    void open_data_dir();
+    void close_data_dir();
+    void checkpointer_loop();
+    void checkpoint();
+    void release_connection(int client_fd);
+    void close_connection(int client_fd);
 
-    // Length-prefixed framing: 4-byte uint32 big-endian + JSON payload
-    std::string read_message(int fd);
+    // Serves the requests a worker was handed a connection for: one, plus
+    // any pipelined behind it that have already arrived. Then returns the
+    // connection to the idle set, or closes it.
+    void serve_connection(int client_fd);
+
+    // Serves one request. Returns false if the connection should be closed.
+    bool handle_request(int client_fd);
+
+    // Length-prefixed framing: 4-byte uint32 big-endian + payload.
+    // Returns false if the peer closed the connection before a new message.
+    // A message starting "GET " is an HTTP request instead (a metrics
+    // scraper on the same port): sets http and reads no further.
+    bool read_message(int fd, std::string& payload, bool& http);
     void write_message(int fd, const std::string& msg);
 
-    nlohmann::json dispatch(const nlohmann::json& request);
-    nlohmann::json handle_store(const nlohmann::json& request);
-    nlohmann::json handle_search(const nlohmann::json& request);
+    // Answers the HTTP request read_message() found with the Prometheus
+    // text on /metrics (404 elsewhere). The connection is closed after.
+    void serve_http(int fd);
+
+    // Payloads are JSON or MessagePack, told apart by their first byte;
+    // each response uses the encoding of its request.
+    enum class Encoding { Json, MsgPack };
+    static Encoding detect_encoding(const std::string& payload);
+    static std::string encode(const nlohmann::json& response, Encoding encoding);
+
+    // Store handlers move fields out of the request instead of copying.
+    // Time spent building the response is added to serialize_time.
+    nlohmann::json dispatch(Action action, nlohmann::json& request,
+                            Clock::duration& serialize_time);
+    nlohmann::json handle_store(nlohmann::json& request);
+    nlohmann::json handle_store_batch(nlohmann::json& request);
+    nlohmann::json handle_search(const nlohmann::json& request, Clock::duration& serialize_time);
+    nlohmann::json handle_search_batch(const nlohmann::json& request,
+                                       Clock::duration& serialize_time);
+    nlohmann::json handle_delete_doc(const nlohmann::json& request);
+    nlohmann::json handle_delete_chunk(const nlohmann::json& request);
+    nlohmann::json handle_diff_chunks(const nlohmann::json& request);
+    nlohmann::json handle_stats(const nlohmann::json& request);
 };
@@ -0,0 +1,288 @@
+#include "simd.hpp"
+
+#include <cstdlib>
+#include <cstring>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define VECTORDB_SIMD_X86 1
+#include <immintrin.h>
+#elif defined(__aarch64__)
+#define VECTORDB_SIMD_NEON 1
+#include <arm_neon.h>
+#endif
+
+namespace simd {
+namespace {
+
+using DotFn = float (*)(const float*, const float*, size_t);
+using BlockDotFn = void (*)(const uint16_t*, const float*, size_t, const float*, float*);
+using BlockDotI8Fn = void (*)(const uint16_t*, const int8_t*, size_t, const float*, float*);
+
+float dot_scalar(const float* a, const float* b, size_t n) {
+    // Independent accumulators break the loop-carried add dependency.
+    float s0 = 0.0f, s1 = 0.0f, s2 = 0.0f, s3 = 0.0f;
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        s0 += a[i] * b[i];
+        s1 += a[i + 1] * b[i + 1];
+        s2 += a[i + 2] * b[i + 2];
+        s3 += a[i + 3] * b[i + 3];
+    }
+    for (; i < n; ++i) {
+        s0 += a[i] * b[i];
+    }
+    return (s0 + s1) + (s2 + s3);
+}
+
+template <typename Value>
+void block_dot_scalar(const uint16_t* idx, const Value* val, size_t nnz,
+                      const float* queries, float* out) {
+    float acc[QUERY_BLOCK] = {};
+    for (size_t k = 0; k < nnz; ++k) {
+        float v = static_cast<float>(val[k]);
+        const float* q = queries + static_cast<size_t>(idx[k]) * QUERY_BLOCK;
+        for (size_t j = 0; j < QUERY_BLOCK; ++j) {
+            acc[j] += v * q[j];
+        }
+    }
+    std::memcpy(out, acc, sizeof(acc));
+}
+
+#if VECTORDB_SIMD_X86
+__attribute__((target("avx2,fma")))
+float dot_avx2(const float* a, const float* b, size_t n) {
+    __m256 acc0 = _mm256_setzero_ps();
+    __m256 acc1 = _mm256_setzero_ps();
+    __m256 acc2 = _mm256_setzero_ps();
+    __m256 acc3 = _mm256_setzero_ps();
+    size_t i = 0;
+    for (; i + 32 <= n; i += 32) {
+        acc0 = _mm256_fmadd_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i), acc0);
+        acc1 = _mm256_fmadd_ps(_mm256_loadu_ps(a + i + 8), _mm256_loadu_ps(b + i + 8), acc1);
+        acc2 = _mm256_fmadd_ps(_mm256_loadu_ps(a + i + 16), _mm256_loadu_ps(b + i + 16), acc2);
+        acc3 = _mm256_fmadd_ps(_mm256_loadu_ps(a + i + 24), _mm256_loadu_ps(b + i + 24), acc3);
+    }
+    for (; i + 8 <= n; i += 8) {
+        acc0 = _mm256_fmadd_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i), acc0);
+    }
+
+    __m256 acc = _mm256_add_ps(_mm256_add_ps(acc0, acc1), _mm256_add_ps(acc2, acc3));
+    __m128 sum = _mm_add_ps(_mm256_castps256_ps128(acc), _mm256_extractf128_ps(acc, 1));
+    sum = _mm_hadd_ps(sum, sum);
+    sum = _mm_hadd_ps(sum, sum);
+    float result = _mm_cvtss_f32(sum);
+
+    for (; i < n; ++i) {
+        result += a[i] * b[i];
+    }
+    return result;
+}
+
+__attribute__((target("avx512f")))
+float dot_avx512(const float* a, const float* b, size_t n) {
+    __m512 acc0 = _mm512_setzero_ps();
+    __m512 acc1 = _mm512_setzero_ps();
+    __m512 acc2 = _mm512_setzero_ps();
+    __m512 acc3 = _mm512_setzero_ps();
+    size_t i = 0;
+    for (; i + 64 <= n; i += 64) {
+        acc0 = _mm512_fmadd_ps(_mm512_loadu_ps(a + i), _mm512_loadu_ps(b + i), acc0);
+        acc1 = _mm512_fmadd_ps(_mm512_loadu_ps(a + i + 16), _mm512_loadu_ps(b + i + 16), acc1);
+        acc2 = _mm512_fmadd_ps(_mm512_loadu_ps(a + i + 32), _mm512_loadu_ps(b + i + 32), acc2);
+        acc3 = _mm512_fmadd_ps(_mm512_loadu_ps(a + i + 48), _mm512_loadu_ps(b + i + 48), acc3);
+    }
+    for (; i + 16 <= n; i += 16) {
+        acc0 = _mm512_fmadd_ps(_mm512_loadu_ps(a + i), _mm512_loadu_ps(b + i), acc0);
+    }
+    if (i < n) {
+        // Masked loads read only the remaining lanes.
+        __mmask16 tail = static_cast<__mmask16>((1u << (n - i)) - 1);
+        acc1 = _mm512_fmadd_ps(_mm512_maskz_loadu_ps(tail, a + i),
+                               _mm512_maskz_loadu_ps(tail, b + i), acc1);
+    }
+
+    __m512 acc = _mm512_add_ps(_mm512_add_ps(acc0, acc1), _mm512_add_ps(acc2, acc3));
+    return _mm512_reduce_add_ps(acc);
+}
+
+static_assert(QUERY_BLOCK == 16, "x86 block kernels hold a block in 16 lanes");
+
+// Two accumulator sets, alternating between row elements, so consecutive
+// FMAs do not wait on each other.
+template <typename Value>
+__attribute__((target("avx2,fma")))
+void block_dot_avx2(const uint16_t* idx, const Value* val, size_t nnz,
+                    const float* queries, float* out) {
+    __m256 lo0 = _mm256_setzero_ps(), hi0 = _mm256_setzero_ps();
+    __m256 lo1 = _mm256_setzero_ps(), hi1 = _mm256_setzero_ps();
+    size_t k = 0;
+    for (; k + 2 <= nnz; k += 2) {
+        const float* q0 = queries + static_cast<size_t>(idx[k]) * QUERY_BLOCK;
+        const float* q1 = queries + static_cast<size_t>(idx[k + 1]) * QUERY_BLOCK;
+        __m256 v0 = _mm256_set1_ps(static_cast<float>(val[k]));
+        __m256 v1 = _mm256_set1_ps(static_cast<float>(val[k + 1]));
+        lo0 = _mm256_fmadd_ps(v0, _mm256_loadu_ps(q0), lo0);
+        hi0 = _mm256_fmadd_ps(v0, _mm256_loadu_ps(q0 + 8), hi0);
+        lo1 = _mm256_fmadd_ps(v1, _mm256_loadu_ps(q1), lo1);
+        hi1 = _mm256_fmadd_ps(v1, _mm256_loadu_ps(q1 + 8), hi1);
+    }
+    if (k < nnz) {
+        const float* q0 = queries + static_cast<size_t>(idx[k]) * QUERY_BLOCK;
+        __m256 v0 = _mm256_set1_ps(static_cast<float>(val[k]));
+        lo0 = _mm256_fmadd_ps(v0, _mm256_loadu_ps(q0), lo0);
+        hi0 = _mm256_fmadd_ps(v0, _mm256_loadu_ps(q0 + 8), hi0);
+    }
+    _mm256_storeu_ps(out, _mm256_add_ps(lo0, lo1));
+    _mm256_storeu_ps(out + 8, _mm256_add_ps(hi0, hi1));
+}
+
+template <typename Value>
+__attribute__((target("avx512f")))
+void block_dot_avx512(const uint16_t* idx, const Value* val, size_t nnz,
+                      const float* queries, float* out) {
+    __m512 acc0 = _mm512_setzero_ps();
+    __m512 acc1 = _mm512_setzero_ps();
+    size_t k = 0;
+    for (; k + 2 <= nnz; k += 2) {
+        const float* q0 = queries + static_cast<size_t>(idx[k]) * QUERY_BLOCK;
+        const float* q1 = queries + static_cast<size_t>(idx[k + 1]) * QUERY_BLOCK;
+        acc0 = _mm512_fmadd_ps(_mm512_set1_ps(static_cast<float>(val[k])),
+                               _mm512_loadu_ps(q0), acc0);
+        acc1 = _mm512_fmadd_ps(_mm512_set1_ps(static_cast<float>(val[k + 1])),
+                               _mm512_loadu_ps(q1), acc1);
+    }
+    if (k < nnz) {
+        const float* q0 = queries + static_cast<size_t>(idx[k]) * QUERY_BLOCK;
+        acc0 = _mm512_fmadd_ps(_mm512_set1_ps(static_cast<float>(val[k])),
+                               _mm512_loadu_ps(q0), acc0);
+    }
+    _mm512_storeu_ps(out, _mm512_add_ps(acc0, acc1));
+}
+#endif
+
+#if VECTORDB_SIMD_NEON
+static_assert(QUERY_BLOCK == 16, "the NEON block kernel holds a block in 4 registers");
+
+template <typename Value>
+void block_dot_neon(const uint16_t* idx, const Value* val, size_t nnz,
+                    const float* queries, float* out) {
+    float32x4_t acc0 = vdupq_n_f32(0.0f), acc1 = vdupq_n_f32(0.0f);
+    float32x4_t acc2 = vdupq_n_f32(0.0f), acc3 = vdupq_n_f32(0.0f);
+    for (size_t k = 0; k < nnz; ++k) {
+        const float* q = queries + static_cast<size_t>(idx[k]) * QUERY_BLOCK;
+        float v = static_cast<float>(val[k]);
+        acc0 = vfmaq_n_f32(acc0, vld1q_f32(q), v);
+        acc1 = vfmaq_n_f32(acc1, vld1q_f32(q + 4), v);
+        acc2 = vfmaq_n_f32(acc2, vld1q_f32(q + 8), v);
+        acc3 = vfmaq_n_f32(acc3, vld1q_f32(q + 12), v);
+    }
+    vst1q_f32(out, acc0);
+    vst1q_f32(out + 4, acc1);
+    vst1q_f32(out + 8, acc2);
+    vst1q_f32(out + 12, acc3);
+}
+
+float dot_neon(const float* a, const float* b, size_t n) {
+    float32x4_t acc0 = vdupq_n_f32(0.0f);
+    float32x4_t acc1 = vdupq_n_f32(0.0f);
+    float32x4_t acc2 = vdupq_n_f32(0.0f);
+    float32x4_t acc3 = vdupq_n_f32(0.0f);
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        acc0 = vfmaq_f32(acc0, vld1q_f32(a + i), vld1q_f32(b + i));
+        acc1 = vfmaq_f32(acc1, vld1q_f32(a + i + 4), vld1q_f32(b + i + 4));
+        acc2 = vfmaq_f32(acc2, vld1q_f32(a + i + 8), vld1q_f32(b + i + 8));
+        acc3 = vfmaq_f32(acc3, vld1q_f32(a + i + 12), vld1q_f32(b + i + 12));
+    }
+    for (; i + 4 <= n; i += 4) {
+        acc0 = vfmaq_f32(acc0, vld1q_f32(a + i), vld1q_f32(b + i));
+    }
+
+    float result = vaddvq_f32(vaddq_f32(vaddq_f32(acc0, acc1), vaddq_f32(acc2, acc3)));
+    for (; i < n; ++i) {
+        result += a[i] * b[i];
+    }
+    return result;
+}
+#endif
+
+struct Kernel {
+    DotFn dot;
+    BlockDotFn block_dot;
+    BlockDotI8Fn block_dot_i8;
+    const char* name;
+};
+
+bool cpu_has(const char* name) {
+#if VECTORDB_SIMD_X86
+    __builtin_cpu_init();
+    if (std::strcmp(name, "avx512") == 0) {
+        return __builtin_cpu_supports("avx512f");
+    }
+    if (std::strcmp(name, "avx2") == 0) {
+        return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+    }
+#elif VECTORDB_SIMD_NEON
+    if (std::strcmp(name, "neon") == 0) {
+        return true; // baseline on AArch64
+    }
+#endif
+    return std::strcmp(name, "scalar") == 0;
+}
+
+Kernel select_kernel() {
+    const Kernel candidates[] = {
+#if VECTORDB_SIMD_X86
+        {dot_avx512, block_dot_avx512<float>, block_dot_avx512<int8_t>, "avx512"},
+        {dot_avx2, block_dot_avx2<float>, block_dot_avx2<int8_t>, "avx2"},
+#elif VECTORDB_SIMD_NEON
+        {dot_neon, block_dot_neon<float>, block_dot_neon<int8_t>, "neon"},
+#endif
+        {dot_scalar, block_dot_scalar<float>, block_dot_scalar<int8_t>, "scalar"},
+    };
+
+    // VECTORDB_SIMD=<name> pins a kernel (e.g. to A/B measure), provided
+    // the CPU supports it.
+    const char* forced = std::getenv("VECTORDB_SIMD");
+    if (forced != nullptr) {
+        for (const auto& k : candidates) {
+            if (std::strcmp(forced, k.name) == 0 && cpu_has(k.name)) {
+                return k;
+            }
+        }
+    }
+
+    for (const auto& k : candidates) {
+        if (cpu_has(k.name)) {
+            return k;
+        }
+    }
+    return {dot_scalar, block_dot_scalar<float>, block_dot_scalar<int8_t>, "scalar"};
+}
+
+const Kernel& kernel() {
+    static const Kernel selected = select_kernel();
+    return selected;
+}
+
+} // namespace
+
+float dot(const float* a, const float* b, size_t n) {
+    return kernel().dot(a, b, n);
+}
+
+void block_dot(const uint16_t* indices, const float* values, size_t nnz,
+               const float* queries, float* out) {
+    kernel().block_dot(indices, values, nnz, queries, out);
+}
+
+void block_dot(const uint16_t* indices, const int8_t* codes, size_t nnz,
+               const float* queries, float* out) {
+    kernel().block_dot_i8(indices, codes, nnz, queries, out);
+}
+
+const char* active_kernel() {
+    return kernel().name;
+}
+
+} // namespace simd
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// Vector kernels with runtime CPU dispatch. The best implementation the
+// host supports (AVX-512F, AVX2+FMA, NEON, else scalar) is picked once on
+// first use; callers never need ISA-specific build flags.
+namespace simd {
+
+// Sum of a[i] * b[i] for i in [0, n).
+float dot(const float* a, const float* b, size_t n);
+
+// Queries block_dot scores together: one AVX-512 register of floats.
+constexpr size_t QUERY_BLOCK = 16;
+
+// One sparse row against a block of queries at once:
+//     out[j] = sum over k of values[k] * queries[indices[k] * QUERY_BLOCK + j]
+// for j in [0, QUERY_BLOCK). queries holds the block bucket-major (each
+// bucket's weights for every query side by side, unused queries 0), so a
+// row element is loaded once and multiplied into all queries by one
+// vector op; N queries cost about one pass over the rows instead of N.
+void block_dot(const uint16_t* indices, const float* values, size_t nnz,
+               const float* queries, float* out);
+// Same for int8 codes (quantized rows), unscaled.
+void block_dot(const uint16_t* indices, const int8_t* codes, size_t nnz,
+               const float* queries, float* out);
+
+// Name of the kernel selected for this CPU, e.g. "avx2". For logging.
+const char* active_kernel();
+
+} // namespace simd
@@ -0,0 +1,636 @@
+#include "snapshot.hpp"
+#include "vector_db.hpp"
+
+#include <cerrno>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <limits>
+#include <mutex>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Snapshot layout. All integers are in host byte order (a snapshot is not
+// portable across endianness; the header records the order it was written
+// in). Every section starts on a 64-byte boundary, so once the file is
+// mapped the arrays can be used in place and stay cache-line aligned.
+//
+//   Header
+//   row_offsets     uint64[num_rows + 1]   row i is [off[i], off[i+1])
+//   row_indices     uint16[nnz]
+//   row_values      float[nnz]
+//   posting_offsets uint64[EMBED_DIM + 1]  bucket b is [off[b], off[b+1])
+//   postings        PostingRef[nnz]
+//   blob            char[blob_bytes]       strings and CBOR metadata
+//   fields          FieldRef[num_rows * 5] chunk_id, doc_id, text, metadata,
+//                                          content hash
+//   docs            DocRef[num_docs]
+//   doc_slots       uint32[num_rows]
+//   ann             char[ann_bytes]        AnnIndex::save() output; empty
+//                                          without an HNSW graph
+//
+// Only live entries are written, renumbered densely in slot order.
+// Version 3 is the same without the graph, which is then rebuilt at load;
+// version 2 also lacks content hashes (4 fields per row). Both are still
+// loaded.
+
+namespace {
+
+constexpr char SNAPSHOT_MAGIC[8] = {'V', 'D', 'B', 'S', 'N', 'A', 'P', '\0'};
+constexpr uint32_t SNAPSHOT_VERSION = 4;
+constexpr uint32_t SNAPSHOT_VERSION_UNGRAPHED = 3;
+constexpr uint32_t SNAPSHOT_VERSION_UNHASHED = 2;
+constexpr uint32_t BYTE_ORDER_MARK = 0x01020304;
+constexpr size_t SECTION_ALIGN = 64;
+constexpr size_t FIELDS_PER_ROW = 5;
+constexpr size_t FIELDS_PER_ROW_UNHASHED = 4;
+
+struct FieldRef {
+    uint64_t offset; // into the blob
+    uint64_t length;
+};
+
+struct PostingRef {
+    uint32_t slot;
+    float weight;
+};
+
+struct DocRef {
+    FieldRef id;
+    uint64_t first; // doc's slots are doc_slots[first, first + count)
+    uint64_t count;
+};
+
+struct Header {
+    char magic[8];
+    uint32_t version;
+    uint32_t byte_order;
+    uint32_t embed_dim;
+    uint32_t embedder_version; // 0 in snapshots written before it existed
+    uint64_t wal_lsn; // last WAL record reflected in the snapshot
+    uint64_t num_rows;
+    uint64_t nnz;
+    uint64_t num_docs;
+    uint64_t blob_bytes;
+    uint64_t row_offsets_at;
+    uint64_t row_indices_at;
+    uint64_t row_values_at;
+    uint64_t posting_offsets_at;
+    uint64_t postings_at;
+    uint64_t blob_at;
+    uint64_t fields_at;
+    uint64_t docs_at;
+    uint64_t doc_slots_at;
+    uint64_t file_bytes;
+    // Version 4 on; earlier headers end above, their first section
+    // starting past these.
+    uint64_t ann_at;
+    uint64_t ann_bytes;
+};
+
+// Walks CBOR without building anything: metadata is checked at load but
+// stays encoded.
+struct CborValidator : nlohmann::json_sax<nlohmann::json> {
+    bool null() override { return true; }
+    bool boolean(bool) override { return true; }
+    bool number_integer(number_integer_t) override { return true; }
+    bool number_unsigned(number_unsigned_t) override { return true; }
+    bool number_float(number_float_t, const string_t&) override { return true; }
+    bool string(string_t&) override { return true; }
+    bool binary(binary_t&) override { return true; }
+    bool start_object(std::size_t) override { return true; }
+    bool key(string_t&) override { return true; }
+    bool end_object() override { return true; }
+    bool start_array(std::size_t) override { return true; }
+    bool end_array() override { return true; }
+    bool parse_error(std::size_t, const std::string&, const nlohmann::json::exception&) override {
+        return false;
+    }
+};
+
+std::runtime_error snapshot_error(const std::string& path, const std::string& what) {
+    return std::runtime_error("Snapshot " + path + ": " + what);
+}
+
+// Sequential writer that builds the whole file image in memory; finish()
+// writes it out. The header is reserved up front and filled in by
+// finish() once every section offset is known.
+class SnapshotWriter {
+public:
+    explicit SnapshotWriter(const std::string& path) : path_(path) {
+        fd_ = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (fd_ < 0) {
+            throw snapshot_error(path_, "cannot create: " + std::string(strerror(errno)));
+        }
+        Header blank{};
+        write(&blank, sizeof(blank));
+    }
+
+    ~SnapshotWriter() {
+        if (fd_ >= 0) {
+            ::close(fd_);
+        }
+    }
+
+    SnapshotWriter(const SnapshotWriter&) = delete;
+    SnapshotWriter& operator=(const SnapshotWriter&) = delete;
+
+    void write(const void* data, size_t n) {
+        const char* p = static_cast<const char*>(data);
+        buf_.insert(buf_.end(), p, p + n);
+        pos_ += n;
+    }
+
+    // Pad to the next section boundary and return its file offset.
+    uint64_t begin_section() {
+        static const char zeros[SECTION_ALIGN] = {};
+        write(zeros, (SECTION_ALIGN - pos_ % SECTION_ALIGN) % SECTION_ALIGN);
+        return pos_;
+    }
+
+    uint64_t pos() const { return pos_; }
+
+    // Fill in the header, then write, fsync and close the file.
+    void finish(const Header& header) {
+        std::memcpy(buf_.data(), &header, sizeof(header));
+        flush();
+        if (::fsync(fd_) < 0) {
+            throw snapshot_error(path_, "fsync failed: " + std::string(strerror(errno)));
+        }
+        ::close(fd_);
+        fd_ = -1;
+    }
+
+private:
+    std::string path_;
+    int fd_ = -1;
+    std::vector<char> buf_;
+    uint64_t pos_ = 0;
+
+    void flush() {
+        size_t done = 0;
+        while (done < buf_.size()) {
+            ssize_t n = ::write(fd_, buf_.data() + done, buf_.size() - done);
+            if (n < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                throw snapshot_error(path_, "write failed: " + std::string(strerror(errno)));
+            }
+            done += static_cast<size_t>(n);
+        }
+        buf_.clear();
+        buf_.shrink_to_fit();
+    }
+};
+
+// Make a completed rename durable.
+void fsync_parent_dir(const std::string& path) {
+    size_t slash = path.find_last_of('/');
+    std::string dir = slash == std::string::npos ? "." : path.substr(0, slash);
+    int fd = ::open(dir.c_str(), O_RDONLY);
+    if (fd >= 0) {
+        ::fsync(fd);
+        ::close(fd);
+    }
+}
+
+} // namespace
+
+MappedFile::MappedFile(const std::string& path) {
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        throw std::runtime_error("Cannot open " + path + ": " + strerror(errno));
+    }
+    struct stat st;
+    if (::fstat(fd, &st) < 0) {
+        int err = errno;
+        ::close(fd);
+        throw std::runtime_error("Cannot stat " + path + ": " + strerror(err));
+    }
+    size_ = static_cast<size_t>(st.st_size);
+    if (size_ > 0) {
+        addr_ = ::mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (addr_ == MAP_FAILED) {
+            int err = errno;
+            ::close(fd);
+            addr_ = nullptr;
+            throw std::runtime_error("Cannot map " + path + ": " + strerror(err));
+        }
+    }
+    // The mapping keeps the file alive; the descriptor is no longer needed.
+    ::close(fd);
+}
+
+MappedFile::~MappedFile() {
+    if (addr_ != nullptr) {
+        ::munmap(addr_, size_);
+    }
+}
+
+uint64_t VectorDB::save_snapshot(const std::string& path) const {
+    std::string tmp_path = path + ".tmp";
+    SnapshotWriter out(tmp_path);
+
+    // Stores wait while the file image is built in memory, which runs at
+    // copy speed; the writes and fsync after it take no lock.
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    // A failed commit left writes in memory the log may not have.
+    check_writable();
+
+    // Live slots keep their relative order but are renumbered densely.
+    constexpr uint32_t NONE = std::numeric_limits<uint32_t>::max();
+    std::vector<uint32_t> live_slots;
+    std::vector<uint32_t> new_slot(rows_.size(), NONE);
+    for (uint32_t slot = 0; slot < rows_.size(); ++slot) {
+        if (live_[slot]) {
+            new_slot[slot] = static_cast<uint32_t>(live_slots.size());
+            live_slots.push_back(slot);
+        }
+    }
+
+    Header header{};
+    std::memcpy(header.magic, SNAPSHOT_MAGIC, sizeof(header.magic));
+    header.version = SNAPSHOT_VERSION;
+    header.byte_order = BYTE_ORDER_MARK;
+    header.embed_dim = EMBED_DIM;
+    header.embedder_version = EMBEDDER_VERSION;
+    header.wal_lsn = applied_lsn_;
+    header.num_rows = live_slots.size();
+    header.nnz = live_nnz_;
+    header.num_docs = doc_index_.size();
+
+    // Live docs, in handle order.
+    std::vector<const Doc*> docs;
+    docs.reserve(doc_index_.size());
+    for (const Doc& doc : docs_) {
+        if (!doc.slots.empty()) {
+            docs.push_back(&doc);
+        }
+    }
+
+    header.row_offsets_at = out.begin_section();
+    uint64_t offset = 0;
+    out.write(&offset, sizeof(offset));
+    for (uint32_t slot : live_slots) {
+        offset += rows_[slot].nnz;
+        out.write(&offset, sizeof(offset));
+    }
+
+    header.row_indices_at = out.begin_section();
+    for (uint32_t slot : live_slots) {
+        out.write(row_indices(rows_[slot]), rows_[slot].nnz * sizeof(uint16_t));
+    }
+    header.row_values_at = out.begin_section();
+    if (quantize_) {
+        // Snapshots hold floats either way: the kept ones of lossy rows,
+        // the decoded codes of the rest, which lost nothing.
+        std::vector<float> values;
+        for (uint32_t slot : live_slots) {
+            const RowRef& row = rows_[slot];
+            auto lossy = lossy_values_.find(slot);
+            if (lossy != lossy_values_.end()) {
+                out.write(lossy->second.data(), row.nnz * sizeof(float));
+                continue;
+            }
+            const int8_t* code = row_codes_.data() + row.offset;
+            values.assign(code, code + row.nnz);
+            for (float& v : values) {
+                v *= row.scale;
+            }
+            out.write(values.data(), values.size() * sizeof(float));
+        }
+    } else {
+        for (uint32_t slot : live_slots) {
+            out.write(row_values(rows_[slot]), rows_[slot].nnz * sizeof(float));
+        }
+    }
+
+    // Postings, minus those of retired slots, renumbered.
+    header.posting_offsets_at = out.begin_section();
+    offset = 0;
+    out.write(&offset, sizeof(offset));
+    for (const PostingList& list : postings_) {
+        for (uint32_t slot : list.slots) {
+            offset += new_slot[slot] != NONE ? 1 : 0;
+        }
+        out.write(&offset, sizeof(offset));
+    }
+    header.postings_at = out.begin_section();
+    for (const PostingList& list : postings_) {
+        for (size_t i = 0; i < list.slots.size(); ++i) {
+            uint32_t slot = list.slots[i];
+            if (new_slot[slot] != NONE) {
+                float weight = quantize_ ? rows_[slot].scale * list.codes[i] : list.weights[i];
+                PostingRef renumbered{new_slot[slot], weight};
+                out.write(&renumbered, sizeof(renumbered));
+            }
+        }
+    }
+
+    // Blob first, so the fixed-size references that follow know where
+    // each string landed.
+    header.blob_at = out.begin_section();
+    auto put = [&](const void* data, size_t n) {
+        FieldRef ref{out.pos() - header.blob_at, n};
+        out.write(data, n);
+        return ref;
+    };
+    std::vector<FieldRef> fields;
+    fields.reserve(live_slots.size() * FIELDS_PER_ROW);
+    for (uint32_t slot : live_slots) {
+        const std::string_view doc_id = docs_[doc_of_slot_[slot]].id;
+        fields.push_back(put(chunk_ids_[slot].data(), chunk_ids_[slot].size()));
+        fields.push_back(put(doc_id.data(), doc_id.size()));
+        fields.push_back(put(texts_[slot].data(), texts_[slot].size()));
+        fields.push_back(put(metadata_[slot].data(), metadata_[slot].size()));
+        fields.push_back(put(content_hashes_[slot].data(), content_hashes_[slot].size()));
+    }
+    std::vector<DocRef> doc_refs;
+    doc_refs.reserve(docs.size());
+    uint64_t first = 0;
+    for (const Doc* doc : docs) {
+        doc_refs.push_back({put(doc->id.data(), doc->id.size()), first, doc->slots.size()});
+        first += doc->slots.size();
+    }
+    header.blob_bytes = out.pos() - header.blob_at;
+
+    header.fields_at = out.begin_section();
+    out.write(fields.data(), fields.size() * sizeof(FieldRef));
+    header.docs_at = out.begin_section();
+    out.write(doc_refs.data(), doc_refs.size() * sizeof(DocRef));
+    header.doc_slots_at = out.begin_section();
+    for (const Doc* doc : docs) {
+        for (uint32_t slot : doc->slots) {
+            out.write(&new_slot[slot], sizeof(uint32_t));
+        }
+    }
+    if (ann_) {
+        std::string graph;
+        ann_->save(graph, new_slot, row_scorer());
+        header.ann_at = out.begin_section();
+        header.ann_bytes = graph.size();
+        out.write(graph.data(), graph.size());
+    }
+    header.file_bytes = out.pos();
+
+    lock.unlock();
+    out.finish(header);
+
+    if (std::rename(tmp_path.c_str(), path.c_str()) < 0) {
+        throw snapshot_error(path, "rename failed: " + std::string(strerror(errno)));
+    }
+    fsync_parent_dir(path);
+    return header.wal_lsn;
+}
+
+void VectorDB::load_snapshot(const std::string& path) {
+    auto map = std::make_unique<MappedFile>(path);
+    const char* base = map->data();
+    size_t size = map->size();
+
+    Header h;
+    if (size < sizeof(h)) {
+        throw snapshot_error(path, "truncated header");
+    }
+    std::memcpy(&h, base, sizeof(h));
+    if (std::memcmp(h.magic, SNAPSHOT_MAGIC, sizeof(h.magic)) != 0) {
+        throw snapshot_error(path, "not a snapshot file");
+    }
+    if (h.version != SNAPSHOT_VERSION && h.version != SNAPSHOT_VERSION_UNGRAPHED &&
+        h.version != SNAPSHOT_VERSION_UNHASHED) {
+        throw snapshot_error(path, "unsupported version " + std::to_string(h.version));
+    }
+    const bool hashed = h.version != SNAPSHOT_VERSION_UNHASHED;
+    if (h.version != SNAPSHOT_VERSION) {
+        h.ann_at = 0;
+        h.ann_bytes = 0;
+    }
+    const size_t fields_per_row = hashed ? FIELDS_PER_ROW : FIELDS_PER_ROW_UNHASHED;
+    if (h.byte_order != BYTE_ORDER_MARK) {
+        throw snapshot_error(path, "written on a machine with a different byte order");
+    }
+    if (h.embed_dim != EMBED_DIM) {
+        throw snapshot_error(path, "built for EMBED_DIM " + std::to_string(h.embed_dim) +
+                                   ", this server uses " + std::to_string(EMBED_DIM));
+    }
+    if (h.file_bytes != size) {
+        throw snapshot_error(path, "size mismatch (expected " + std::to_string(h.file_bytes) +
+                                   " bytes, found " + std::to_string(size) + ")");
+    }
+
+    // Bounds- and alignment-checked pointer to a section of count elements.
+    auto section = [&](uint64_t at, uint64_t count, size_t elem) -> const char* {
+        if (at % SECTION_ALIGN != 0 || at > size || count > (size - at) / elem) {
+            throw snapshot_error(path, "corrupt section table");
+        }
+        return base + at;
+    };
+    auto* row_offsets = reinterpret_cast<const uint64_t*>(
+        section(h.row_offsets_at, h.num_rows + 1, sizeof(uint64_t)));
+    auto* indices = reinterpret_cast<const uint16_t*>(
+        section(h.row_indices_at, h.nnz, sizeof(uint16_t)));
+    auto* values = reinterpret_cast<const float*>(
+        section(h.row_values_at, h.nnz, sizeof(float)));
+    auto* posting_offsets = reinterpret_cast<const uint64_t*>(
+        section(h.posting_offsets_at, EMBED_DIM + 1, sizeof(uint64_t)));
+    auto* postings = reinterpret_cast<const PostingRef*>(
+        section(h.postings_at, h.nnz, sizeof(PostingRef)));
+    const char* blob = section(h.blob_at, h.blob_bytes, 1);
+    auto* fields = reinterpret_cast<const FieldRef*>(
+        section(h.fields_at, h.num_rows * fields_per_row, sizeof(FieldRef)));
+    auto* docs = reinterpret_cast<const DocRef*>(section(h.docs_at, h.num_docs, sizeof(DocRef)));
+    auto* doc_slots = reinterpret_cast<const uint32_t*>(
+        section(h.doc_slots_at, h.num_rows, sizeof(uint32_t)));
+    const char* graph = section(h.ann_at, h.ann_bytes, 1);
+
+    // Everything the search paths index with is validated here, so a
+    // corrupt file fails at startup instead of reading out of bounds later.
+    if (h.num_rows > std::numeric_limits<uint32_t>::max() || h.num_docs > h.num_rows ||
+        row_offsets[0] != 0 || row_offsets[h.num_rows] != h.nnz ||
+        posting_offsets[0] != 0 || posting_offsets[EMBED_DIM] != h.nnz) {
+        throw snapshot_error(path, "corrupt offsets");
+    }
+    for (uint64_t i = 0; i < h.num_rows; ++i) {
+        if (row_offsets[i + 1] < row_offsets[i] || row_offsets[i + 1] - row_offsets[i] > EMBED_DIM) {
+            throw snapshot_error(path, "corrupt row offsets");
+        }
+    }
+    for (uint64_t i = 0; i < h.nnz; ++i) {
+        if (indices[i] >= EMBED_DIM || postings[i].slot >= h.num_rows) {
+            throw snapshot_error(path, "corrupt embedding data");
+        }
+    }
+    for (size_t b = 0; b < EMBED_DIM; ++b) {
+        if (posting_offsets[b + 1] < posting_offsets[b]) {
+            throw snapshot_error(path, "corrupt posting offsets");
+        }
+    }
+    auto field = [&](const FieldRef& ref) -> const char* {
+        if (ref.offset > h.blob_bytes || ref.length > h.blob_bytes - ref.offset) {
+            throw snapshot_error(path, "corrupt string table");
+        }
+        return blob + ref.offset;
+    };
+    auto metadata_of = [&](const FieldRef& ref) {
+        const auto* cbor = reinterpret_cast<const uint8_t*>(field(ref));
+        try {
+            return nlohmann::json::from_cbor(cbor, cbor + ref.length);
+        } catch (const nlohmann::json::exception& e) {
+            throw snapshot_error(path, std::string("corrupt metadata: ") + e.what());
+        }
+    };
+    size_t n = h.num_rows;
+
+    if (h.embedder_version != EMBEDDER_VERSION) {
+        // The rows were embedded differently from how queries now are.
+        // Keep the entries but recompute their embeddings from the text,
+        // storing them as if new; the mapping is not kept.
+        std::vector<VectorEntry> entries(n);
+        for (size_t i = 0; i < n; ++i) {
+            const FieldRef* f = fields + i * fields_per_row;
+            VectorEntry& e = entries[i];
+            e.chunk_id.assign(field(f[0]), f[0].length);
+            e.doc_id.assign(field(f[1]), f[1].length);
+            e.text.assign(field(f[2]), f[2].length);
+            e.metadata = metadata_of(f[3]);
+            if (hashed) {
+                e.content_hash.assign(field(f[4]), f[4].length);
+            }
+            e.embedding = embed(e.text);
+        }
+
+        std::lock_guard<std::mutex> writes(write_mutex_);
+        std::unique_lock<std::shared_mutex> lock(mutex_);
+        if (!rows_.empty()) {
+            throw std::logic_error("load_snapshot called on a non-empty VectorDB");
+        }
+        for (auto& entry : entries) {
+            store_locked(std::move(entry));
+        }
+        applied_lsn_ = h.wal_lsn;
+        return;
+    }
+
+    std::lock_guard<std::mutex> writes(write_mutex_);
+    std::unique_lock<std::shared_mutex> lock(mutex_);
+    if (!rows_.empty()) {
+        throw std::logic_error("load_snapshot called on a non-empty VectorDB");
+    }
+
+    // Strings are used in place, like the rows: views into the mapping.
+    rows_.resize(n);
+    chunk_ids_.resize(n);
+    doc_of_slot_.assign(n, std::numeric_limits<uint32_t>::max());
+    doc_pos_.resize(n);
+    texts_.resize(n);
+    metadata_.resize(n);
+    content_hashes_.resize(n);
+    live_.assign(n, 1);
+    slot_of_.reserve(n);
+    if (quantize_) {
+        row_codes_.reserve(h.nnz);
+    }
+    for (size_t i = 0; i < n; ++i) {
+        rows_[i] = {row_offsets[i], static_cast<uint32_t>(row_offsets[i + 1] - row_offsets[i]), 0.0f};
+        if (quantize_) {
+            bool exact;
+            const float* row_values = values + rows_[i].offset;
+            rows_[i].scale = quantize_row(row_values, rows_[i].nnz, row_codes_, exact);
+            if (!exact) {
+                lossy_values_[static_cast<uint32_t>(i)].assign(row_values, row_values + rows_[i].nnz);
+            }
+        }
+
+        const FieldRef* f = fields + i * fields_per_row;
+        chunk_ids_[i] = {field(f[0]), f[0].length};
+        texts_[i] = {field(f[2]), f[2].length};
+        metadata_[i] = {field(f[3]), f[3].length};
+        if (hashed) {
+            content_hashes_[i] = {field(f[4]), f[4].length};
+        }
+        CborValidator validator;
+        if (!nlohmann::json::sax_parse(metadata_[i].begin(), metadata_[i].end(), &validator,
+                                       nlohmann::json::input_format_t::cbor)) {
+            throw snapshot_error(path, "corrupt metadata");
+        }
+        live_bytes_ += chunk_ids_[i].size() + texts_[i].size() + metadata_[i].size() +
+                       content_hashes_[i].size();
+        if (!slot_of_.emplace(chunk_ids_[i], static_cast<uint32_t>(i)).second) {
+            throw snapshot_error(path, "duplicate chunk_id " + std::string(chunk_ids_[i]));
+        }
+    }
+
+    // The docs section is authoritative for doc membership; each row must
+    // belong to exactly one doc.
+    docs_.resize(h.num_docs);
+    doc_index_.reserve(h.num_docs);
+    for (uint32_t d = 0; d < h.num_docs; ++d) {
+        const DocRef& ref = docs[d];
+        if (ref.first > n || ref.count > n - ref.first || ref.count == 0) {
+            throw snapshot_error(path, "corrupt doc index");
+        }
+        Doc& doc = docs_[d];
+        doc.id = {field(ref.id), ref.id.length};
+        live_bytes_ += doc.id.size();
+        doc.slots.assign(doc_slots + ref.first, doc_slots + ref.first + ref.count);
+        for (uint32_t pos = 0; pos < doc.slots.size(); ++pos) {
+            uint32_t slot = doc.slots[pos];
+            if (slot >= n || doc_of_slot_[slot] != std::numeric_limits<uint32_t>::max()) {
+                throw snapshot_error(path, "corrupt doc index");
+            }
+            doc_of_slot_[slot] = d;
+            doc_pos_[slot] = pos;
+        }
+        if (!doc_index_.emplace(doc.id, d).second) {
+            throw snapshot_error(path, "duplicate doc_id " + std::string(doc.id));
+        }
+    }
+    for (size_t i = 0; i < n; ++i) {
+        if (doc_of_slot_[i] == std::numeric_limits<uint32_t>::max()) {
+            throw snapshot_error(path, "corrupt doc index");
+        }
+    }
+
+    // Postings are appended to by later stores, so they are copied out
+    // (coded in their row's scale when quantized, like the rows); embedding
+    // rows are not, and stay in the mapping (only their indices when
+    // quantized, the values having been read into codes above).
+    for (size_t b = 0; b < EMBED_DIM; ++b) {
+        PostingList& list = postings_[b];
+        size_t count = posting_offsets[b + 1] - posting_offsets[b];
+        list.slots.reserve(count);
+        if (quantize_) {
+            list.codes.reserve(count);
+        } else {
+            list.weights.reserve(count);
+        }
+        for (uint64_t i = posting_offsets[b]; i < posting_offsets[b + 1]; ++i) {
+            const PostingRef* p = postings + i;
+            list.slots.push_back(p->slot);
+            if (quantize_) {
+                float scale = rows_[p->slot].scale;
+                list.codes.push_back(
+                    scale > 0.0f ? static_cast<int8_t>(std::lround(p->weight / scale)) : 0);
+            } else {
+                list.weights.push_back(p->weight);
+            }
+        }
+    }
+    mapped_indices_ = indices;
+    mapped_values_ = values;
+    mapped_nnz_ = h.nnz;
+    live_nnz_ = h.nnz;
+    dead_nnz_ = 0;
+    applied_lsn_ = h.wal_lsn;
+    snapshot_map_ = std::move(map);
+
+    // Relink the graph only if the snapshot has none (an older version,
+    // or written without one) or it does not fit these rows.
+    if (ann_ && (h.ann_bytes == 0 || !ann_->load(graph, h.ann_bytes, n))) {
+        rebuild_ann();
+    }
+}
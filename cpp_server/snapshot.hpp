@@ -0,0 +1,22 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+// Read-only mapping of a whole file, unmapped on destruction. Throws
+// std::runtime_error if the file cannot be opened or mapped.
+class MappedFile {
+public:
+    explicit MappedFile(const std::string& path);
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    const char* data() const { return static_cast<const char*>(addr_); }
+    size_t size() const { return size_; }
+
+private:
+    void* addr_ = nullptr;
+    size_t size_ = 0;
+};
@@ -0,0 +1,34 @@
+#include "string_arena.hpp"
+
+#include <cstring>
+
+std::string_view StringArena::append(std::string_view bytes) {
+    if (bytes.empty()) {
+        return {};
+    }
+    size_ += bytes.size();
+
+    char* at;
+    if (bytes.size() > STRING_ARENA_BLOCK_BYTES / 4) {
+        // Too big to share: a dedicated block, slotted in behind the
+        // current one so its free tail stays in use.
+        std::unique_ptr<char[]> block(new char[bytes.size()]);
+        at = block.get();
+        blocks_.insert(blocks_.empty() ? blocks_.end() : blocks_.end() - 1, std::move(block));
+    } else {
+        if (STRING_ARENA_BLOCK_BYTES - block_used_ < bytes.size()) {
+            blocks_.emplace_back(new char[STRING_ARENA_BLOCK_BYTES]);
+            block_used_ = 0;
+        }
+        at = blocks_.back().get() + block_used_;
+        block_used_ += bytes.size();
+    }
+    std::memcpy(at, bytes.data(), bytes.size());
+    return {at, bytes.size()};
+}
+
+void StringArena::clear() {
+    blocks_.clear();
+    block_used_ = STRING_ARENA_BLOCK_BYTES;
+    size_ = 0;
+}
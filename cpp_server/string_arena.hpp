@@ -0,0 +1,36 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <string_view>
+#include <vector>
+
+// Bytes are carved out of blocks of this size; a string over a quarter
+// of it gets a block of its own, so no block wastes more than that.
+constexpr size_t STRING_ARENA_BLOCK_BYTES = 1 << 20;
+
+// Append-only storage for many small strings. Appending copies the bytes
+// into the current block, so storing a string almost never allocates and
+// the footprint stays within a third of the payload.
+// Bytes never move: returned views stay valid until the arena is cleared
+// or destroyed. Nothing is freed individually; owners repack live strings
+// into a fresh arena instead. Not thread-safe.
+class StringArena {
+public:
+    StringArena() = default;
+    StringArena(StringArena&&) = default;
+    StringArena& operator=(StringArena&&) = default;
+
+    // A view of a copy of bytes, owned by the arena.
+    std::string_view append(std::string_view bytes);
+
+    // Bytes handed out so far.
+    size_t size() const { return size_; }
+
+    void clear();
+
+private:
+    std::vector<std::unique_ptr<char[]>> blocks_;
+    size_t block_used_ = STRING_ARENA_BLOCK_BYTES; // no current block yet
+    size_t size_ = 0;
+};
@@ -0,0 +1,116 @@
+#include "thread_pool.hpp"
+
+#include <algorithm>
+#include <exception>
+#include <iostream>
+
+ThreadPool::ThreadPool(size_t num_threads) {
+    if (num_threads == 0) {
+        num_threads = 1;
+    }
+    threads_.reserve(num_threads);
+    for (size_t i = 0; i < num_threads; ++i) {
+        threads_.emplace_back([this] { worker_loop(); });
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    cv_.notify_all();
+    for (auto& t : threads_) {
+        t.join();
+    }
+}
+
+void ThreadPool::submit(std::function<void()> task) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        tasks_.push(std::move(task));
+    }
+    cv_.notify_one();
+}
+
+void ThreadPool::parallel_for(size_t n, const std::function<void(size_t, size_t)>& fn) {
+    if (n == 0) {
+        return;
+    }
+    size_t parts = std::min(n, threads_.size() + 1);
+    if (parts == 1) {
+        fn(0, n);
+        return;
+    }
+
+    std::mutex done_mutex;
+    std::condition_variable done_cv;
+    size_t remaining = parts - 1;
+    std::exception_ptr first_error;
+
+    size_t step = n / parts;
+    size_t extra = n % parts;
+    size_t begin = 0;
+    size_t inline_begin = 0, inline_end = 0;
+    for (size_t p = 0; p < parts; ++p) {
+        size_t end = begin + step + (p < extra ? 1 : 0);
+        if (p == 0) {
+            inline_begin = begin;
+            inline_end = end;
+        } else {
+            submit([&, begin, end] {
+                std::exception_ptr error;
+                try {
+                    fn(begin, end);
+                } catch (...) {
+                    error = std::current_exception();
+                }
+                std::lock_guard<std::mutex> lock(done_mutex);
+                if (error && !first_error) {
+                    first_error = error;
+                }
+                if (--remaining == 0) {
+                    done_cv.notify_one();
+                }
+            });
+        }
+        begin = end;
+    }
+
+    std::exception_ptr inline_error;
+    try {
+        fn(inline_begin, inline_end);
+    } catch (...) {
+        inline_error = std::current_exception();
+    }
+
+    std::unique_lock<std::mutex> lock(done_mutex);
+    done_cv.wait(lock, [&] { return remaining == 0; });
+    if (inline_error) {
+        std::rethrow_exception(inline_error);
+    }
+    if (first_error) {
+        std::rethrow_exception(first_error);
+    }
+}
+
+void ThreadPool::worker_loop() {
+    while (true) {
+        std::function<void()> task;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            cv_.wait(lock, [this] { return stopping_ || !tasks_.empty(); });
+            if (tasks_.empty()) {
+                return; // stopping and fully drained
+            }
+            task = std::move(tasks_.front());
+            tasks_.pop();
+        }
+
+        try {
+            task();
+        } catch (const std::exception& e) {
+            std::cerr << "[vectordb] Worker task failed: " << e.what() << std::endl;
+        }
+    }
+}
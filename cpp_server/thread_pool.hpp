@@ -0,0 +1,39 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+// Fixed-size pool of worker threads consuming a FIFO task queue.
+// The destructor drains queued tasks before joining the workers.
+class ThreadPool {
+public:
+    explicit ThreadPool(size_t num_threads);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    void submit(std::function<void()> task);
+
+    // Splits [0, n) into contiguous ranges, runs fn(begin, end) for each on
+    // the pool threads and the calling thread, and blocks until all ranges
+    // finish. The first exception thrown by fn is rethrown to the caller.
+    // Must not be called from a task already running on this pool.
+    void parallel_for(size_t n, const std::function<void(size_t, size_t)>& fn);
+
+    size_t size() const { return threads_.size(); }
+
+private:
+    std::vector<std::thread> threads_;
+    std::queue<std::function<void()>> tasks_;
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    bool stopping_ = false;
+
+    void worker_loop();
+};
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+// Keeps the k highest-scoring (score, slot) pairs seen so far in a
+// bounded min-heap: O(log k) per accepted candidate and O(1) for the
+// common reject, without ever holding the whole candidate list. Ties
+// rank the lower slot first, so equal scores come out in a stable order
+// whichever path produced them.
+class TopK {
+public:
+    using Item = std::pair<float, uint32_t>;
+
+    explicit TopK(size_t k) : k_(k) {}
+
+    void push(float score, uint32_t slot) {
+        if (heap_.size() < k_) {
+            heap_.emplace_back(score, slot);
+            std::push_heap(heap_.begin(), heap_.end(), better);
+        } else if (k_ > 0 && better({score, slot}, heap_.front())) {
+            std::pop_heap(heap_.begin(), heap_.end(), better);
+            heap_.back() = {score, slot};
+            std::push_heap(heap_.begin(), heap_.end(), better);
+        }
+    }
+
+    size_t k() const { return k_; }
+
+    // Fold in another partial result, e.g. one per scan partition.
+    void merge(const TopK& other) {
+        for (const Item& item : other.heap_) {
+            push(item.first, item.second);
+        }
+    }
+
+    // Best first. Leaves this TopK empty.
+    std::vector<Item> take_sorted() {
+        std::sort_heap(heap_.begin(), heap_.end(), better);
+        std::vector<Item> sorted;
+        sorted.swap(heap_);
+        return sorted;
+    }
+
+private:
+    size_t k_;
+    // With `better` as the comparator the heap front is the worst kept item.
+    std::vector<Item> heap_;
+
+    static bool better(const Item& a, const Item& b) {
+        return a.first > b.first || (a.first == b.first && a.second < b.second);
+    }
+};
@@ -1,76 +1,1341 @@
 #include "vector_db.hpp"
+#include "hnsw.hpp"
+#include "simd.hpp"
 
 #include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <mutex>
+#include <optional>
+#include <stdexcept>
 
-void VectorDB::store(const std::string& chunk_id,
-                     const std::string& doc_id,
-                     const std::string& text,
-                     const nlohmann::json& metadata,
-                     const std::vector<float>& embedding) {
-    // If overwriting, remove old doc_index entry
-    auto it = entries_.find(chunk_id);
-    if (it != entries_.end()) {
-        const std::string& old_doc_id = it->second.doc_id;
-        auto& ids = doc_index_[old_doc_id];
-        ids.erase(std::remove(ids.begin(), ids.end(), chunk_id), ids.end());
-        if (ids.empty()) {
-            doc_index_.erase(old_doc_id);
+namespace {
+
+// Below this many slots per partition, handing work to the search pool
+// costs more than it saves.
+constexpr size_t PARALLEL_SCAN_MIN_SLOTS = 4096;
+
+// A quantized search keeps this many candidates per requested result for
+// the exact re-score. Rounding moves scores by well under a percent, so
+// the true top-k is all but certain to be among them.
+constexpr size_t QUANTIZED_RERANK_FACTOR = 4;
+
+// Per-entry bookkeeping of the result cache beyond key and hits, roughly.
+constexpr size_t RESULT_CACHE_ENTRY_OVERHEAD_BYTES = 128;
+
+// Heap per element of an unordered_map with a string_view key: node with
+// cached hash plus allocator overhead, roughly (libstdc++).
+constexpr size_t HASH_NODE_BYTES = 48;
+
+template <typename Vector>
+size_t capacity_bytes(const Vector& v) {
+    return v.capacity() * sizeof(typename Vector::value_type);
+}
+
+template <typename Map>
+size_t map_bytes(const Map& m) {
+    return m.size() * HASH_NODE_BYTES + m.bucket_count() * sizeof(void*);
+}
+
+// Dot product of a row (idx, val, n) with the query. query_dense is the
+// query scattered into EMBED_DIM floats.
+template <typename Value>
+float sparse_dot(const SparseVector& query, const float* query_dense,
+                 const uint16_t* idx, const Value* val, size_t n) {
+    // Short query against a long row: binary-search each query index in
+    // the row. Measured faster than the gather below until the query has
+    // about 1/16 of the row's non-zeros.
+    if (query.nnz() * 16 < n) {
+        float sum = 0.0f;
+        const uint16_t* lo = idx;
+        const uint16_t* end = idx + n;
+        for (size_t k = 0; k < query.nnz() && lo != end; ++k) {
+            lo = std::lower_bound(lo, end, query.indices[k]);
+            if (lo != end && *lo == query.indices[k]) {
+                sum += query.values[k] * static_cast<float>(val[lo - idx]);
+            }
+        }
+        return sum;
+    }
+
+    // Gather from the dense query at the row's indices. Independent
+    // accumulators hide load latency; hardware gathers measured slower.
+    float s0 = 0.0f, s1 = 0.0f, s2 = 0.0f, s3 = 0.0f;
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        s0 += static_cast<float>(val[i]) * query_dense[idx[i]];
+        s1 += static_cast<float>(val[i + 1]) * query_dense[idx[i + 1]];
+        s2 += static_cast<float>(val[i + 2]) * query_dense[idx[i + 2]];
+        s3 += static_cast<float>(val[i + 3]) * query_dense[idx[i + 3]];
+    }
+    for (; i < n; ++i) {
+        s0 += static_cast<float>(val[i]) * query_dense[idx[i]];
+    }
+    return (s0 + s1) + (s2 + s3);
+}
+
+// StoreBatch WAL payload: uint32 EMBEDDER_VERSION and uint32 count, then
+// per entry the chunk_id, doc_id, text, CBOR metadata and content hash as
+// uint32-length-prefixed bytes, then uint32 nnz and the embedding's
+// indices and values. Host byte order. StoreBatchUnhashed lacks the
+// content hash, StoreBatchUnversioned the version too.
+void put_bytes(std::string& out, const void* data, size_t n) {
+    uint32_t len = static_cast<uint32_t>(n);
+    out.append(reinterpret_cast<const char*>(&len), sizeof(len));
+    out.append(static_cast<const char*>(data), n);
+}
+
+std::string encode_store_batch(const std::vector<VectorEntry>& entries) {
+    std::string out;
+    uint32_t version = EMBEDDER_VERSION;
+    out.append(reinterpret_cast<const char*>(&version), sizeof(version));
+    uint32_t count = static_cast<uint32_t>(entries.size());
+    out.append(reinterpret_cast<const char*>(&count), sizeof(count));
+    for (const VectorEntry& e : entries) {
+        put_bytes(out, e.chunk_id.data(), e.chunk_id.size());
+        put_bytes(out, e.doc_id.data(), e.doc_id.size());
+        put_bytes(out, e.text.data(), e.text.size());
+        // Encoded in place behind a length patched in afterwards.
+        size_t len_at = out.size();
+        out.append(sizeof(uint32_t), '\0');
+        nlohmann::json::to_cbor(e.metadata, out);
+        uint32_t cbor_len = static_cast<uint32_t>(out.size() - len_at - sizeof(uint32_t));
+        std::memcpy(&out[len_at], &cbor_len, sizeof(cbor_len));
+        put_bytes(out, e.content_hash.data(), e.content_hash.size());
+        uint32_t nnz = static_cast<uint32_t>(e.embedding.nnz());
+        out.append(reinterpret_cast<const char*>(&nnz), sizeof(nnz));
+        out.append(reinterpret_cast<const char*>(e.embedding.indices.data()), nnz * sizeof(uint16_t));
+        out.append(reinterpret_cast<const char*>(e.embedding.values.data()), nnz * sizeof(float));
+    }
+    return out;
+}
+
+class RecordReader {
+public:
+    RecordReader(const char* data, size_t length) : p_(data), end_(data + length) {}
+
+    const char* take(size_t n) {
+        if (static_cast<size_t>(end_ - p_) < n) {
+            throw std::runtime_error("Corrupt WAL record: truncated payload");
+        }
+        const char* at = p_;
+        p_ += n;
+        return at;
+    }
+
+    uint32_t u32() {
+        uint32_t v;
+        std::memcpy(&v, take(sizeof(v)), sizeof(v));
+        return v;
+    }
+
+    std::string bytes() {
+        uint32_t n = u32();
+        return std::string(take(n), n);
+    }
+
+private:
+    const char* p_;
+    const char* end_;
+};
+
+// DeleteDoc and DeleteChunk payloads are just the doc_id or chunk_id.
+
+// Embeddings logged under another EMBEDDER_VERSION are recomputed.
+std::vector<VectorEntry> decode_store_batch(const char* payload, size_t length,
+                                           WriteAheadLog::RecordType type) {
+    RecordReader in(payload, length);
+    bool stale = type == WriteAheadLog::StoreBatchUnversioned || in.u32() != EMBEDDER_VERSION;
+    bool hashed = type == WriteAheadLog::StoreBatch;
+    uint32_t count = in.u32();
+    std::vector<VectorEntry> entries;
+    for (uint32_t i = 0; i < count; ++i) {
+        VectorEntry e;
+        e.chunk_id = in.bytes();
+        e.doc_id = in.bytes();
+        e.text = in.bytes();
+        std::string cbor = in.bytes();
+        try {
+            e.metadata = nlohmann::json::from_cbor(cbor);
+        } catch (const nlohmann::json::exception& ex) {
+            throw std::runtime_error(std::string("Corrupt WAL record: ") + ex.what());
+        }
+        if (hashed) {
+            e.content_hash = in.bytes();
+        }
+        uint32_t nnz = in.u32();
+        if (nnz > EMBED_DIM) {
+            throw std::runtime_error("Corrupt WAL record: embedding too long");
+        }
+        e.embedding.indices.resize(nnz);
+        e.embedding.values.resize(nnz);
+        std::memcpy(e.embedding.indices.data(), in.take(nnz * sizeof(uint16_t)), nnz * sizeof(uint16_t));
+        std::memcpy(e.embedding.values.data(), in.take(nnz * sizeof(float)), nnz * sizeof(float));
+        for (uint16_t idx : e.embedding.indices) {
+            if (idx >= EMBED_DIM) {
+                throw std::runtime_error("Corrupt WAL record: embedding index out of range");
+            }
+        }
+        if (stale) {
+            e.embedding = embed(e.text);
+        }
+        entries.push_back(std::move(e));
+    }
+    return entries;
+}
+
+// Per-thread dense copy of the current query. Scattered once per search
+// so each row can be scored by gathering at its own indices; cleared by
+// touching only the query's indices.
+class QueryScratch {
+public:
+    explicit QueryScratch(const SparseVector& query) : query_(query) {
+        for (size_t i = 0; i < query.nnz(); ++i) {
+            dense()[query.indices[i]] = query.values[i];
+        }
+    }
+    ~QueryScratch() {
+        for (uint16_t idx : query_.indices) {
+            dense()[idx] = 0.0f;
+        }
+    }
+
+    const float* data() const { return dense().data(); }
+
+private:
+    const SparseVector& query_;
+
+    static std::vector<float>& dense() {
+        thread_local std::vector<float> buf(EMBED_DIM, 0.0f);
+        return buf;
+    }
+};
+
+// Queries of a batch laid out for simd::block_dot in a per-thread
+// EMBED_DIM x QUERY_BLOCK buffer, zeroed again on destruction like
+// QueryScratch.
+class QueryBlock {
+public:
+    explicit QueryBlock(const std::vector<const SparseVector*>& queries) : queries_(queries) {
+        for (size_t j = 0; j < queries.size(); ++j) {
+            const SparseVector& q = *queries[j];
+            for (size_t i = 0; i < q.nnz(); ++i) {
+                weights()[static_cast<size_t>(q.indices[i]) * simd::QUERY_BLOCK + j] = q.values[i];
+            }
+        }
+    }
+    ~QueryBlock() {
+        for (size_t j = 0; j < queries_.size(); ++j) {
+            for (uint16_t idx : queries_[j]->indices) {
+                weights()[static_cast<size_t>(idx) * simd::QUERY_BLOCK + j] = 0.0f;
+            }
+        }
+    }
+
+    const float* data() const { return weights().data(); }
+
+private:
+    const std::vector<const SparseVector*>& queries_;
+
+    static std::vector<float>& weights() {
+        thread_local std::vector<float> buf(EMBED_DIM * simd::QUERY_BLOCK, 0.0f);
+        return buf;
+    }
+};
+
+} // namespace
+
+VectorDB::VectorDB(const VectorDBOptions& options)
+    : quantize_(options.quantize), result_cache_(options.result_cache_bytes) {
+    if (options.search_threads > 1) {
+        search_pool_ = std::make_unique<ThreadPool>(options.search_threads - 1);
+    }
+    if (options.hnsw) {
+        ann_ = std::make_unique<HnswIndex>();
+    }
+    compactor_ = std::thread(&VectorDB::compactor_loop, this);
+}
+
+VectorDB::~VectorDB() {
+    {
+        std::lock_guard<std::mutex> lock(compactor_mutex_);
+        compactor_stop_ = true;
+    }
+    compactor_cv_.notify_one();
+    compactor_.join();
+}
+
+void VectorDB::store(VectorEntry entry) {
+    std::vector<VectorEntry> entries;
+    entries.push_back(std::move(entry));
+    store_batch(std::move(entries));
+}
+
+void VectorDB::store_batch(std::vector<VectorEntry> entries) {
+    // Encode outside the lock (wal_ only changes while no write runs; see
+    // attach_wal); append under it so LSN order is apply order.
+    std::string record;
+    if (wal_ != nullptr) {
+        record = encode_store_batch(entries);
+    }
+
+    WriteAheadLog* wal;
+    uint64_t lsn = 0;
+    {
+        std::lock_guard<std::mutex> writes(write_mutex_);
+        std::unique_lock<std::shared_mutex> lock(mutex_);
+        wal = wal_;
+        if (wal != nullptr) {
+            check_writable();
+            lsn = wal->append(WriteAheadLog::StoreBatch, record);
+            applied_lsn_ = lsn;
+        }
+        for (auto& entry : entries) {
+            store_locked(std::move(entry));
+        }
+    }
+
+    // Wait outside the lock, so concurrent stores share one fsync.
+    if (lsn != 0) {
+        commit(wal, lsn);
+    }
+}
+
+size_t VectorDB::delete_doc(const std::string& doc_id) {
+    WriteAheadLog* wal;
+    uint64_t lsn = 0;
+    size_t deleted;
+    {
+        std::lock_guard<std::mutex> writes(write_mutex_);
+        std::unique_lock<std::shared_mutex> lock(mutex_);
+        if (doc_index_.count(doc_id) == 0) {
+            return 0;
+        }
+        wal = wal_;
+        if (wal != nullptr) {
+            check_writable();
+            lsn = wal->append(WriteAheadLog::DeleteDoc, doc_id);
+            applied_lsn_ = lsn;
+        }
+        deleted = delete_doc_locked(doc_id);
+    }
+    if (lsn != 0) {
+        commit(wal, lsn);
+    }
+    return deleted;
+}
+
+size_t VectorDB::delete_chunk(const std::string& chunk_id) {
+    WriteAheadLog* wal;
+    uint64_t lsn = 0;
+    size_t deleted;
+    {
+        std::lock_guard<std::mutex> writes(write_mutex_);
+        std::unique_lock<std::shared_mutex> lock(mutex_);
+        if (slot_of_.count(chunk_id) == 0) {
+            return 0;
+        }
+        wal = wal_;
+        if (wal != nullptr) {
+            check_writable();
+            lsn = wal->append(WriteAheadLog::DeleteChunk, chunk_id);
+            applied_lsn_ = lsn;
+        }
+        deleted = delete_chunk_locked(chunk_id);
+    }
+    if (lsn != 0) {
+        commit(wal, lsn);
+    }
+    return deleted;
+}
+
+void VectorDB::check_writable() const {
+    if (!wal_error_.empty()) {
+        throw std::runtime_error("Store is read-only after a WAL failure: " + wal_error_);
+    }
+}
+
+void VectorDB::commit(WriteAheadLog* wal, uint64_t lsn) {
+    try {
+        wal->commit(lsn);
+    } catch (const std::exception& e) {
+        // The write is already applied in memory but not known to be in
+        // the log. Stop taking writes and snapshots, so only the log, read
+        // back at the next start, decides whether it happened.
+        std::unique_lock<std::shared_mutex> lock(mutex_);
+        if (wal_error_.empty()) {
+            wal_error_ = e.what();
+        }
+        throw;
+    }
+}
+
+void VectorDB::attach_wal(WriteAheadLog* wal) {
+    std::unique_lock<std::shared_mutex> lock(mutex_);
+    wal_ = wal;
+}
+
+void VectorDB::replay_wal_record(uint64_t lsn, WriteAheadLog::RecordType type,
+                                 const char* payload, size_t length) {
+    if (type == WriteAheadLog::DeleteDoc || type == WriteAheadLog::DeleteChunk) {
+        std::string id(payload, length);
+        std::lock_guard<std::mutex> writes(write_mutex_);
+        std::unique_lock<std::shared_mutex> lock(mutex_);
+        if (type == WriteAheadLog::DeleteDoc) {
+            delete_doc_locked(id);
+        } else {
+            delete_chunk_locked(id);
+        }
+        applied_lsn_ = lsn;
+        return;
+    }
+    if (type != WriteAheadLog::StoreBatch && type != WriteAheadLog::StoreBatchUnhashed &&
+        type != WriteAheadLog::StoreBatchUnversioned) {
+        throw std::runtime_error("Unknown WAL record type " + std::to_string(type) +
+                                 " at LSN " + std::to_string(lsn));
+    }
+    std::vector<VectorEntry> entries = decode_store_batch(payload, length, type);
+
+    std::lock_guard<std::mutex> writes(write_mutex_);
+    std::unique_lock<std::shared_mutex> lock(mutex_);
+    for (auto& entry : entries) {
+        store_locked(std::move(entry));
+    }
+    applied_lsn_ = lsn;
+}
+
+uint64_t VectorDB::applied_lsn() const {
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    return applied_lsn_;
+}
+
+float VectorDB::quantize_row(const float* values, size_t n, AlignedVector<int8_t>& out,
+                             bool& exact) {
+    float min_abs = 0.0f;
+    float max_abs = 0.0f;
+    for (size_t i = 0; i < n; ++i) {
+        float a = std::fabs(values[i]);
+        if (a > 0.0f && (min_abs == 0.0f || a < min_abs)) {
+            min_abs = a;
+        }
+        max_abs = std::max(max_abs, a);
+    }
+
+    // Embeddings are normalized counts, so every value is usually a small
+    // multiple of the smallest one. Then that is the scale and the codes
+    // are the counts, with nothing lost.
+    exact = min_abs > 0.0f && max_abs / min_abs < 127.5f;
+    for (size_t i = 0; i < n && exact; ++i) {
+        float steps = values[i] / min_abs;
+        exact = std::fabs(steps - std::round(steps)) < 1e-3f;
+    }
+    float scale = exact ? min_abs : max_abs / 127.0f;
+    for (size_t i = 0; i < n; ++i) {
+        out.push_back(scale > 0.0f ? static_cast<int8_t>(std::lround(values[i] / scale)) : 0);
+    }
+    return scale;
+}
+
+void VectorDB::store_locked(VectorEntry&& entry) {
+    uint32_t doc = intern_doc(entry.doc_id);
+    uint32_t slot = allocate_slot();
+
+    // If overwriting, retire the old slot (its postings stay until
+    // compact()) and keep its chunk_id bytes, which the key still views.
+    auto it = slot_of_.find(entry.chunk_id);
+    if (it != slot_of_.end()) {
+        uint32_t old_slot = it->second;
+        uint32_t old_doc = doc_of_slot_[old_slot];
+        chunk_ids_[slot] = chunk_ids_[old_slot];
+        retire_slot(old_slot);
+        if (old_doc != doc) {
+            touch_doc(old_doc);
+        }
+        it->second = slot;
+    } else {
+        chunk_ids_[slot] = strings_.append(entry.chunk_id);
+        slot_of_.emplace(chunk_ids_[slot], slot);
+        live_bytes_ += chunk_ids_[slot].size();
+    }
+    doc_of_slot_[slot] = doc;
+    doc_pos_[slot] = static_cast<uint32_t>(docs_[doc].slots.size());
+    docs_[doc].slots.push_back(slot);
+    touch_doc(doc);
+
+    const SparseVector& vec = entry.embedding;
+    rows_[slot] = {mapped_nnz_ + row_indices_.size(), static_cast<uint32_t>(vec.nnz()), 0.0f};
+    row_indices_.insert(row_indices_.end(), vec.indices.begin(), vec.indices.end());
+    if (quantize_) {
+        bool exact;
+        rows_[slot].scale = quantize_row(vec.values.data(), vec.nnz(), row_codes_, exact);
+        if (!exact) {
+            lossy_values_[slot] = vec.values;
+        }
+    } else {
+        row_values_.insert(row_values_.end(), vec.values.begin(), vec.values.end());
+    }
+    for (size_t i = 0; i < vec.nnz(); ++i) {
+        PostingList& list = postings_[vec.indices[i]];
+        list.slots.push_back(slot);
+        if (quantize_) {
+            list.codes.push_back(row_codes_[rows_[slot].offset + i]);
+        } else {
+            list.weights.push_back(vec.values[i]);
+        }
+    }
+    live_nnz_ += vec.nnz();
+    if (ann_) {
+        QueryScratch vec_dense(vec);
+        ann_->insert(slot, [&](uint32_t s) { return dot_product(vec, vec_dense.data(), s); });
+    }
+
+    cbor_scratch_.clear();
+    nlohmann::json::to_cbor(entry.metadata, cbor_scratch_);
+    texts_[slot] = strings_.append(entry.text);
+    metadata_[slot] = strings_.append(
+        {reinterpret_cast<const char*>(cbor_scratch_.data()), cbor_scratch_.size()});
+    content_hashes_[slot] = strings_.append(entry.content_hash);
+    live_bytes_ += texts_[slot].size() + metadata_[slot].size() + content_hashes_[slot].size();
+    live_[slot] = 1;
+
+    if (compaction_due()) {
+        request_compaction();
+    }
+}
+
+size_t VectorDB::delete_doc_locked(const std::string& doc_id) {
+    auto it = doc_index_.find(doc_id);
+    if (it == doc_index_.end()) {
+        return 0;
+    }
+    // Retired from the back, so each removal from the list is a pop.
+    uint32_t doc = it->second;
+    auto& slots = docs_[doc].slots;
+    size_t deleted = slots.size();
+    while (!slots.empty()) {
+        uint32_t slot = slots.back();
+        forget_chunk_id(slot);
+        retire_slot(slot);
+    }
+    touch_doc(doc);
+    if (compaction_due()) {
+        request_compaction();
+    }
+    return deleted;
+}
+
+size_t VectorDB::delete_chunk_locked(const std::string& chunk_id) {
+    auto it = slot_of_.find(chunk_id);
+    if (it == slot_of_.end()) {
+        return 0;
+    }
+    uint32_t slot = it->second;
+    uint32_t doc = doc_of_slot_[slot];
+    forget_chunk_id(slot);
+    retire_slot(slot);
+    touch_doc(doc);
+    if (compaction_due()) {
+        request_compaction();
+    }
+    return 1;
+}
+
+uint32_t VectorDB::allocate_slot() {
+    if (!free_slots_.empty()) {
+        uint32_t slot = free_slots_.back();
+        free_slots_.pop_back();
+        return slot;
+    }
+    chunk_ids_.emplace_back();
+    doc_of_slot_.push_back(0);
+    doc_pos_.push_back(0);
+    texts_.emplace_back();
+    metadata_.emplace_back();
+    content_hashes_.emplace_back();
+    live_.push_back(0);
+    rows_.push_back({0, 0, 0.0f});
+    return static_cast<uint32_t>(rows_.size() - 1);
+}
+
+void VectorDB::retire_slot(uint32_t slot) {
+    // Swap with the doc's last slot: O(1) however large the doc.
+    auto& slots = docs_[doc_of_slot_[slot]].slots;
+    uint32_t moved = slots.back();
+    slots[doc_pos_[slot]] = moved;
+    doc_pos_[moved] = doc_pos_[slot];
+    slots.pop_back();
+
+    live_[slot] = 0;
+    live_nnz_ -= rows_[slot].nnz;
+    dead_nnz_ += rows_[slot].nnz;
+    retired_slots_.push_back(slot);
+
+    size_t bytes = texts_[slot].size() + metadata_[slot].size() + content_hashes_[slot].size();
+    live_bytes_ -= bytes;
+    dead_bytes_ += bytes;
+    lossy_values_.erase(slot);
+    chunk_ids_[slot] = {};
+    texts_[slot] = {};
+    metadata_[slot] = {};
+    content_hashes_[slot] = {};
+}
+
+void VectorDB::forget_chunk_id(uint32_t slot) {
+    // The key views these bytes; an overwrite moves them to the new slot
+    // instead, so only here do they die.
+    slot_of_.erase(chunk_ids_[slot]);
+    live_bytes_ -= chunk_ids_[slot].size();
+    dead_bytes_ += chunk_ids_[slot].size();
+}
+
+uint32_t VectorDB::intern_doc(std::string_view doc_id) {
+    auto it = doc_index_.find(doc_id);
+    if (it != doc_index_.end()) {
+        return it->second;
+    }
+    uint32_t doc;
+    if (!free_docs_.empty()) {
+        doc = free_docs_.back();
+        free_docs_.pop_back();
+    } else {
+        doc = static_cast<uint32_t>(docs_.size());
+        docs_.emplace_back();
+    }
+    docs_[doc].id = strings_.append(doc_id);
+    doc_index_.emplace(docs_[doc].id, doc);
+    live_bytes_ += doc_id.size();
+    return doc;
+}
+
+void VectorDB::touch_doc(uint32_t doc) {
+    ++generation_;
+    Doc& d = docs_[doc];
+    if (!d.slots.empty()) {
+        d.generation = generation_;
+        return;
+    }
+    doc_index_.erase(d.id);
+    live_bytes_ -= d.id.size();
+    dead_bytes_ += d.id.size();
+    d = Doc();
+    free_docs_.push_back(doc);
+}
+
+bool VectorDB::compaction_due() const {
+    // Retired rows cost scan time on every query, and retired strings
+    // memory; once either outnumbers the live ones, compact (amortized
+    // O(1) per retired entry).
+    return (dead_nnz_ > live_nnz_ && dead_nnz_ > EMBED_DIM) ||
+           (dead_bytes_ > live_bytes_ && dead_bytes_ > STRING_ARENA_BLOCK_BYTES);
+}
+
+void VectorDB::request_compaction() {
+    {
+        std::lock_guard<std::mutex> lock(compactor_mutex_);
+        compaction_requested_ = true;
+    }
+    compactor_cv_.notify_one();
+}
+
+void VectorDB::compactor_loop() {
+    std::unique_lock<std::mutex> lock(compactor_mutex_);
+    for (;;) {
+        compactor_cv_.wait(lock, [this] { return compactor_stop_ || compaction_requested_; });
+        if (compactor_stop_) {
+            return;
+        }
+        compaction_requested_ = false;
+        lock.unlock();
+        compact();
+        lock.lock();
+    }
+}
+
+void VectorDB::compact() {
+    // Writers wait for the whole pass, so nothing the repack is built from
+    // changes before it is swapped in. Searches only wait for the swap.
+    std::lock_guard<std::mutex> writes(write_mutex_);
+
+    std::vector<RowRef> rows;
+    AlignedVector<uint16_t> indices;
+    AlignedVector<float> values;
+    AlignedVector<int8_t> codes;
+    StringArena strings;
+    std::vector<std::string_view> chunk_ids;
+    std::vector<std::string_view> texts;
+    std::vector<std::string_view> metadata;
+    std::vector<std::string_view> content_hashes;
+    std::unordered_map<std::string_view, uint32_t> slot_of;
+    std::vector<std::string_view> doc_ids;
+    std::unordered_map<std::string_view, uint32_t> doc_index;
+    std::vector<PostingList> postings(EMBED_DIM);
+    std::unique_ptr<AnnIndex::RemovalPlan> relink;
+    std::unique_ptr<MappedFile> mapping;
+    {
+        std::shared_lock<std::shared_mutex> lock(mutex_);
+        // Re-checked: an earlier pass may already have covered this request.
+        if (!compaction_due()) {
+            return;
+        }
+
+        // Repack live rows in slot order, which also restores sequential
+        // scans after freed slots have been reused out of order.
+        rows = rows_;
+        indices.reserve(live_nnz_);
+        if (quantize_) {
+            codes.reserve(live_nnz_);
+        } else {
+            values.reserve(live_nnz_);
+        }
+        for (size_t slot = 0; slot < rows.size(); ++slot) {
+            RowRef& row = rows[slot];
+            if (!live_[slot]) {
+                row = {0, 0, 0.0f};
+                continue;
+            }
+            size_t offset = indices.size();
+            const uint16_t* idx = row_indices(row);
+            indices.insert(indices.end(), idx, idx + row.nnz);
+            if (quantize_) {
+                const int8_t* code = row_codes_.data() + row.offset;
+                codes.insert(codes.end(), code, code + row.nnz);
+            } else {
+                const float* val = row_values(row);
+                values.insert(values.end(), val, val + row.nnz);
+            }
+            row.offset = offset;
+        }
+
+        // Repack live strings too. The maps are keyed by views of the old
+        // bytes, so they are rebuilt over the new ones.
+        chunk_ids.resize(rows.size());
+        texts.resize(rows.size());
+        metadata.resize(rows.size());
+        content_hashes.resize(rows.size());
+        slot_of.reserve(slot_of_.size());
+        for (uint32_t slot = 0; slot < rows.size(); ++slot) {
+            if (live_[slot]) {
+                chunk_ids[slot] = strings.append(chunk_ids_[slot]);
+                texts[slot] = strings.append(texts_[slot]);
+                metadata[slot] = strings.append(metadata_[slot]);
+                content_hashes[slot] = strings.append(content_hashes_[slot]);
+                slot_of.emplace(chunk_ids[slot], slot);
+            }
+        }
+        doc_ids.resize(docs_.size());
+        doc_index.reserve(doc_index_.size());
+        for (uint32_t doc = 0; doc < docs_.size(); ++doc) {
+            if (!docs_[doc].slots.empty()) {
+                doc_ids[doc] = strings.append(docs_[doc].id);
+                doc_index.emplace(doc_ids[doc], doc);
+            }
+        }
+
+        for (size_t bucket = 0; bucket < EMBED_DIM; ++bucket) {
+            const PostingList& list = postings_[bucket];
+            PostingList& kept = postings[bucket];
+            for (size_t i = 0; i < list.slots.size(); ++i) {
+                if (!live_[list.slots[i]]) {
+                    continue;
+                }
+                kept.slots.push_back(list.slots[i]);
+                if (quantize_) {
+                    kept.codes.push_back(list.codes[i]);
+                } else {
+                    kept.weights.push_back(list.weights[i]);
+                }
+            }
+        }
+
+        // The graph routes through retired rows, which are about to go;
+        // work out how to relink their neighbours around them.
+        if (ann_) {
+            relink = ann_->plan_remove(retired_slots_, row_scorer());
         }
     }
 
-    entries_[chunk_id] = VectorEntry{chunk_id, doc_id, text, metadata, embedding};
-    doc_index_[doc_id].push_back(chunk_id);
+    // Swapped, so the old arrays, links and snapshot mapping are freed
+    // after the lock is released.
+    std::unique_lock<std::shared_mutex> lock(mutex_);
+    rows_.swap(rows);
+    row_indices_.swap(indices);
+    row_values_.swap(values);
+    row_codes_.swap(codes);
+    std::swap(strings_, strings);
+    chunk_ids_.swap(chunk_ids);
+    texts_.swap(texts);
+    metadata_.swap(metadata);
+    content_hashes_.swap(content_hashes);
+    slot_of_.swap(slot_of);
+    for (uint32_t doc = 0; doc < docs_.size(); ++doc) {
+        docs_[doc].id = doc_ids[doc];
+    }
+    doc_index_.swap(doc_index);
+    postings_.swap(postings);
+    dead_bytes_ = 0;
+
+    // Every live row and string is now on the heap; drop the snapshot
+    // mapping.
+    mapped_indices_ = nullptr;
+    mapped_values_ = nullptr;
+    mapped_nnz_ = 0;
+    mapping = std::move(snapshot_map_);
+
+    if (relink) {
+        ann_->apply_remove(*relink);
+    }
+
+    // Retired slots are no longer named anywhere; they may be reused.
+    free_slots_.insert(free_slots_.end(), retired_slots_.begin(), retired_slots_.end());
+    retired_slots_.clear();
+    dead_nnz_ = 0;
+}
+
+void VectorDB::rebuild_ann() {
+    ann_->clear();
+    for (uint32_t slot = 0; slot < rows_.size(); ++slot) {
+        if (!live_[slot]) {
+            continue;
+        }
+        SparseVector row = row_vector(slot);
+        QueryScratch row_dense(row);
+        ann_->insert(slot, [&](uint32_t s) { return dot_product(row, row_dense.data(), s); });
+    }
 }
 
-std::vector<SearchResult> VectorDB::search(const std::vector<float>& query_embedding,
+PairScorer VectorDB::row_scorer() const {
+    // Scores are asked for one `from` row at a time, so each is scattered
+    // once.
+    struct State {
+        uint32_t from = std::numeric_limits<uint32_t>::max();
+        SparseVector row;
+        std::optional<QueryScratch> dense;
+    };
+    auto state = std::make_shared<State>();
+    return [this, state](uint32_t from, uint32_t to) {
+        if (from != state->from) {
+            state->dense.reset();
+            state->row = row_vector(from);
+            state->dense.emplace(state->row);
+            state->from = from;
+        }
+        return dot_product(state->row, state->dense->data(), to);
+    };
+}
+
+SparseVector VectorDB::row_vector(uint32_t slot) const {
+    const RowRef& row = rows_[slot];
+    SparseVector vec;
+    const uint16_t* idx = row_indices(row);
+    vec.indices.assign(idx, idx + row.nnz);
+    if (quantize_) {
+        const int8_t* code = row_codes_.data() + row.offset;
+        vec.values.reserve(row.nnz);
+        for (size_t i = 0; i < row.nnz; ++i) {
+            vec.values.push_back(row.scale * code[i]);
+        }
+    } else {
+        const float* val = row_values(row);
+        vec.values.assign(val, val + row.nnz);
+    }
+    return vec;
+}
+
+size_t VectorDB::size() const {
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    return slot_of_.size();
+}
+
+VectorDBStats VectorDB::stats() const {
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    VectorDBStats stats;
+    stats.entries = slot_of_.size();
+    stats.docs = doc_index_.size();
+    stats.slots = chunk_ids_.size();
+    stats.live_nnz = live_nnz_;
+    stats.dead_nnz = dead_nnz_;
+    stats.live_string_bytes = live_bytes_;
+    stats.dead_string_bytes = dead_bytes_;
+    stats.mapped_bytes = snapshot_map_ ? snapshot_map_->size() : 0;
+
+    size_t bytes = strings_.size() + capacity_bytes(cbor_scratch_);
+    bytes += capacity_bytes(chunk_ids_) + capacity_bytes(doc_of_slot_) +
+             capacity_bytes(doc_pos_) + capacity_bytes(texts_) + capacity_bytes(metadata_) +
+             capacity_bytes(content_hashes_) + capacity_bytes(live_) + capacity_bytes(retired_slots_) + capacity_bytes(free_slots_);
+    bytes += capacity_bytes(rows_) + capacity_bytes(row_indices_) + capacity_bytes(row_values_) +
+             capacity_bytes(row_codes_) + map_bytes(lossy_values_);
+    for (const auto& [slot, values] : lossy_values_) {
+        bytes += capacity_bytes(values);
+    }
+    bytes += capacity_bytes(postings_);
+    for (const PostingList& list : postings_) {
+        bytes += capacity_bytes(list.slots) + capacity_bytes(list.weights) +
+                 capacity_bytes(list.codes);
+    }
+    bytes += capacity_bytes(docs_) + capacity_bytes(free_docs_);
+    for (const auto& doc : docs_) {
+        bytes += capacity_bytes(doc.slots);
+    }
+    bytes += map_bytes(slot_of_) + map_bytes(doc_index_);
+    stats.heap_bytes = bytes;
+    return stats;
+}
+
+nlohmann::json SearchHit::metadata() const {
+    const auto* cbor = reinterpret_cast<const uint8_t*>(metadata_cbor.data());
+    return nlohmann::json::from_cbor(cbor, cbor + metadata_cbor.size());
+}
+
+std::vector<SearchResult> VectorDB::search(const SparseVector& query_embedding,
                                             int top_k,
-                                            const std::string& doc_id_filter) const {
-    std::vector<std::pair<float, const VectorEntry*>> scored;
+                                            const std::string& doc_id_filter,
+                                            SearchMode mode,
+                                            size_t ef_search) const {
+    std::vector<SearchResult> results;
+    search(query_embedding, top_k, doc_id_filter, mode, ef_search, [&](const SearchHit& hit) {
+        results.push_back({std::string(hit.chunk_id), hit.score, std::string(hit.text),
+                           hit.metadata()});
+    });
+    return results;
+}
+
+void VectorDB::search(const SparseVector& query_embedding,
+                      int top_k,
+                      const std::string& doc_id_filter,
+                      SearchMode mode,
+                      size_t ef_search,
+                      const std::function<void(const SearchHit&)>& visit) const {
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+
+    mode = resolve_mode(mode, doc_id_filter);
+    if (top_k <= 0) {
+        return;
+    }
+
+    for (const auto& [score, slot] : find_hits(query_embedding, static_cast<size_t>(top_k),
+                                               doc_id_filter, mode, ef_search)) {
+        visit({chunk_ids_[slot], score, texts_[slot], metadata_[slot]});
+    }
+}
+
+void VectorDB::search_batch(const std::vector<SparseVector>& queries,
+                            int top_k,
+                            const std::string& doc_id_filter,
+                            SearchMode mode,
+                            size_t ef_search,
+                            const std::function<void(size_t, const SearchHit&)>& visit) const {
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+
+    mode = resolve_mode(mode, doc_id_filter);
+    if (top_k <= 0) {
+        return;
+    }
+
+    std::vector<std::vector<TopK::Item>> hits(queries.size());
+    if (mode == SearchMode::Scan) {
+        find_hits_batch(queries, static_cast<size_t>(top_k), doc_id_filter, hits);
+    } else {
+        for (size_t i = 0; i < queries.size(); ++i) {
+            hits[i] = find_hits(queries[i], static_cast<size_t>(top_k), doc_id_filter, mode,
+                                ef_search);
+        }
+    }
+
+    for (size_t i = 0; i < hits.size(); ++i) {
+        for (const auto& [score, slot] : hits[i]) {
+            visit(i, {chunk_ids_[slot], score, texts_[slot], metadata_[slot]});
+        }
+    }
+}
+
+void VectorDB::lookup(
+    const std::vector<std::string>& chunk_ids,
+    const std::function<void(size_t, std::string_view, const SearchHit&)>& visit) const {
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    for (size_t i = 0; i < chunk_ids.size(); ++i) {
+        auto it = slot_of_.find(chunk_ids[i]);
+        if (it == slot_of_.end()) {
+            continue;
+        }
+        uint32_t slot = it->second;
+        visit(i, content_hashes_[slot], {chunk_ids_[slot], 0.0f, texts_[slot], metadata_[slot]});
+    }
+}
 
+std::vector<std::string> VectorDB::doc_chunk_ids(const std::string& doc_id) const {
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    std::vector<std::string> ids;
+    auto it = doc_index_.find(doc_id);
+    if (it == doc_index_.end()) {
+        return ids;
+    }
+    const auto& slots = docs_[it->second].slots;
+    ids.reserve(slots.size());
+    for (uint32_t slot : slots) {
+        ids.emplace_back(chunk_ids_[slot]);
+    }
+    return ids;
+}
+
+SearchMode VectorDB::resolve_mode(SearchMode mode, const std::string& doc_id_filter) const {
+    // A doc's chunks are few, so scanning them beats walking postings or
+    // a graph that span the whole corpus.
+    if (mode == SearchMode::Auto || (mode == SearchMode::Approx && !doc_id_filter.empty())) {
+        return doc_id_filter.empty() ? SearchMode::Index : SearchMode::Scan;
+    } else if (mode == SearchMode::Approx && !ann_) {
+        return SearchMode::Index;
+    }
+    return mode;
+}
+
+std::vector<TopK::Item> VectorDB::find_hits(const SparseVector& query_embedding,
+                                            size_t top_k,
+                                            const std::string& doc_id_filter,
+                                            SearchMode mode,
+                                            size_t ef_search) const {
+    std::string key;
+    uint64_t generation = 0;
+    std::vector<TopK::Item> hits;
+    bool cached = result_cache_.capacity_bytes() > 0;
+    if (cached) {
+        key = result_cache_key(query_embedding, top_k, doc_id_filter, mode, ef_search);
+        generation = result_generation(doc_id_filter);
+        if (cached_hits(key, generation, hits)) {
+            return hits;
+        }
+    }
+
+    // Quantized codes only approximate lossy rows: gather extra
+    // candidates and re-score those.
+    TopK top(top_k);
+    TopK candidates(quantize_ ? top.k() * QUANTIZED_RERANK_FACTOR : 0);
+    TopK& found = quantize_ ? candidates : top;
+    if (mode == SearchMode::Index) {
+        search_index(query_embedding, doc_id_filter, found);
+    } else if (mode == SearchMode::Approx) {
+        search_ann(query_embedding, ef_search, found);
+    } else {
+        search_scan(query_embedding, doc_id_filter, found);
+    }
+    if (quantize_) {
+        rerank(query_embedding, candidates, top);
+    }
+    hits = top.take_sorted();
+
+    if (cached) {
+        cache_hits(std::move(key), generation, hits);
+    }
+    return hits;
+}
+
+void VectorDB::find_hits_batch(const std::vector<SparseVector>& queries, size_t top_k,
+                               const std::string& doc_id_filter,
+                               std::vector<std::vector<TopK::Item>>& hits) const {
+    bool cached = result_cache_.capacity_bytes() > 0;
+    std::vector<std::string> keys(cached ? queries.size() : 0);
+    uint64_t generation = cached ? result_generation(doc_id_filter) : 0;
+
+    std::vector<size_t> pending;
+    for (size_t i = 0; i < queries.size(); ++i) {
+        if (cached) {
+            keys[i] = result_cache_key(queries[i], top_k, doc_id_filter, SearchMode::Scan, 0);
+            if (cached_hits(keys[i], generation, hits[i])) {
+                continue;
+            }
+        }
+        pending.push_back(i);
+    }
+
+    size_t keep = quantize_ ? top_k * QUANTIZED_RERANK_FACTOR : top_k;
+    for (size_t begin = 0; begin < pending.size(); begin += simd::QUERY_BLOCK) {
+        size_t end = std::min(pending.size(), begin + simd::QUERY_BLOCK);
+        std::vector<const SparseVector*> block;
+        for (size_t j = begin; j < end; ++j) {
+            block.push_back(&queries[pending[j]]);
+        }
+
+        // A lone query takes the single-query kernels, so its scores match
+        // search() to the last bit.
+        std::vector<TopK> found(block.size(), TopK(keep));
+        if (block.size() == 1) {
+            search_scan(*block[0], doc_id_filter, found[0]);
+        } else {
+            search_scan_batch(block, doc_id_filter, found);
+        }
+
+        for (size_t j = 0; j < block.size(); ++j) {
+            size_t i = pending[begin + j];
+            TopK top(top_k);
+            if (quantize_) {
+                rerank(*block[j], found[j], top);
+            } else {
+                top = std::move(found[j]);
+            }
+            hits[i] = top.take_sorted();
+            if (cached) {
+                cache_hits(std::move(keys[i]), generation, hits[i]);
+            }
+        }
+    }
+}
+
+std::string VectorDB::result_cache_key(const SparseVector& query, size_t top_k,
+                                       const std::string& doc_id_filter, SearchMode mode,
+                                       size_t ef_search) {
+    // Exact parameters and embedding bytes, so texts that embed the same
+    // (case, punctuation) share an entry. ef_search only shapes graph
+    // searches; other modes ignore it, so it is left out of their keys.
+    std::string key;
+    uint32_t mode_id = static_cast<uint32_t>(mode);
+    size_t effort = mode == SearchMode::Approx ? ef_search : 0;
+    key.append(reinterpret_cast<const char*>(&top_k), sizeof(top_k));
+    key.append(reinterpret_cast<const char*>(&effort), sizeof(effort));
+    key.append(reinterpret_cast<const char*>(&mode_id), sizeof(mode_id));
+    uint32_t filter_len = static_cast<uint32_t>(doc_id_filter.size());
+    key.append(reinterpret_cast<const char*>(&filter_len), sizeof(filter_len));
+    key.append(doc_id_filter);
+    key.append(reinterpret_cast<const char*>(query.indices.data()),
+               query.nnz() * sizeof(uint16_t));
+    key.append(reinterpret_cast<const char*>(query.values.data()),
+               query.nnz() * sizeof(float));
+    return key;
+}
+
+uint64_t VectorDB::result_generation(const std::string& doc_id_filter) const {
+    if (doc_id_filter.empty()) {
+        return generation_;
+    }
+    auto it = doc_index_.find(doc_id_filter);
+    return it == doc_index_.end() ? 0 : docs_[it->second].generation;
+}
+
+bool VectorDB::cached_hits(const std::string& key, uint64_t generation,
+                           std::vector<TopK::Item>& hits) const {
+    std::lock_guard<std::mutex> lock(result_cache_mutex_);
+    const CachedSearch* hit = result_cache_.find(key);
+    if (hit != nullptr && hit->generation == generation) {
+        result_cache_hits_.fetch_add(1, std::memory_order_relaxed);
+        hits = hit->hits;
+        return true;
+    }
+    return false;
+}
+
+void VectorDB::cache_hits(std::string key, uint64_t generation,
+                          const std::vector<TopK::Item>& hits) const {
+    result_cache_misses_.fetch_add(1, std::memory_order_relaxed);
+    size_t bytes = RESULT_CACHE_ENTRY_OVERHEAD_BYTES + key.size() +
+                   hits.size() * sizeof(TopK::Item);
+    std::lock_guard<std::mutex> lock(result_cache_mutex_);
+    result_cache_.insert(std::move(key), CachedSearch{generation, hits}, bytes);
+}
+
+void VectorDB::search_index(const SparseVector& query,
+                            const std::string& doc_id_filter,
+                            TopK& top) const {
+    // Per-thread score accumulator indexed by slot. Only the slots a query
+    // touches are visited and reset, so cost follows the postings of the
+    // query's buckets rather than the corpus size.
+    thread_local std::vector<float> acc;
+    thread_local std::vector<uint32_t> touched;
+    if (acc.size() < rows_.size()) {
+        acc.resize(rows_.size(), 0.0f);
+    }
+    uint32_t doc = 0;
+    if (!doc_id_filter.empty()) {
+        auto it = doc_index_.find(doc_id_filter);
+        if (it == doc_index_.end()) {
+            return;
+        }
+        doc = it->second;
+    }
+
+    // Quantized weights share their row's scale, so codes are summed and
+    // scaled once per row at the end.
+    for (size_t k = 0; k < query.nnz(); ++k) {
+        float q = query.values[k];
+        const PostingList& list = postings_[query.indices[k]];
+        for (size_t i = 0; i < list.slots.size(); ++i) {
+            uint32_t slot = list.slots[i];
+            if (acc[slot] == 0.0f) {
+                touched.push_back(slot);
+            }
+            acc[slot] += q * (quantize_ ? static_cast<float>(list.codes[i]) : list.weights[i]);
+        }
+    }
+
+    for (uint32_t slot : touched) {
+        float score = quantize_ ? acc[slot] * rows_[slot].scale : acc[slot];
+        if (live_[slot] && score > 0.0f &&
+            (doc_id_filter.empty() || doc_of_slot_[slot] == doc)) {
+            top.push(score, slot);
+        }
+        acc[slot] = 0.0f;
+    }
+    touched.clear();
+}
+
+void VectorDB::search_ann(const SparseVector& query, size_t ef_search, TopK& top) const {
+    QueryScratch query_dense(query);
+    ann_->search([&](uint32_t slot) { return dot_product(query, query_dense.data(), slot); },
+                 ef_search, [this](uint32_t slot) { return live_[slot] != 0; }, top);
+}
+
+void VectorDB::search_scan(const SparseVector& query,
+                           const std::string& doc_id_filter,
+                           TopK& top) const {
     if (!doc_id_filter.empty()) {
         // Filtered search: only entries matching doc_id
         auto it = doc_index_.find(doc_id_filter);
-        if (it != doc_index_.end()) {
-            for (const auto& cid : it->second) {
-                auto eit = entries_.find(cid);
-                if (eit != entries_.end()) {
-                    float score = dot_product(query_embedding, eit->second.embedding);
-                    scored.emplace_back(score, &eit->second);
+        if (it == doc_index_.end()) {
+            return;
+        }
+        QueryScratch query_dense(query);
+        for (uint32_t slot : docs_[it->second].slots) {
+            float score = dot_product(query, query_dense.data(), slot);
+            if (score > 0.0f) {
+                top.push(score, slot);
+            }
+        }
+        return;
+    }
+
+    // Unfiltered: split the slots into contiguous ranges, one per search
+    // thread, each keeping its own top-k; merge them at the end.
+    size_t n = rows_.size();
+    size_t parts = 1;
+    if (search_pool_) {
+        parts = std::min(search_pool_->size() + 1, n / PARALLEL_SCAN_MIN_SLOTS);
+    }
+    if (parts <= 1) {
+        scan_range(query, 0, n, top);
+        return;
+    }
+
+    std::vector<TopK> partial(parts, TopK(top.k()));
+    search_pool_->parallel_for(parts, [&](size_t begin, size_t end) {
+        for (size_t p = begin; p < end; ++p) {
+            scan_range(query, n * p / parts, n * (p + 1) / parts, partial[p]);
+        }
+    });
+    for (const TopK& t : partial) {
+        top.merge(t);
+    }
+}
+
+void VectorDB::scan_range(const SparseVector& query, size_t begin, size_t end,
+                          TopK& top) const {
+    QueryScratch query_dense(query);
+    for (size_t slot = begin; slot < end; ++slot) {
+        if (!live_[slot]) {
+            continue;
+        }
+        float score = dot_product(query, query_dense.data(), static_cast<uint32_t>(slot));
+        if (score > 0.0f) {
+            top.push(score, static_cast<uint32_t>(slot));
+        }
+    }
+}
+
+void VectorDB::search_scan_batch(const std::vector<const SparseVector*>& queries,
+                                 const std::string& doc_id_filter,
+                                 std::vector<TopK>& tops) const {
+    QueryBlock block(queries);
+    if (!doc_id_filter.empty()) {
+        auto it = doc_index_.find(doc_id_filter);
+        if (it == doc_index_.end()) {
+            return;
+        }
+        float scores[simd::QUERY_BLOCK];
+        for (uint32_t slot : docs_[it->second].slots) {
+            score_block(block.data(), slot, scores);
+            for (size_t j = 0; j < tops.size(); ++j) {
+                if (scores[j] > 0.0f) {
+                    tops[j].push(scores[j], slot);
                 }
             }
         }
-    } else {
-        // Unfiltered: scan all entries
-        for (const auto& [cid, entry] : entries_) {
-            float score = dot_product(query_embedding, entry.embedding);
-            scored.emplace_back(score, &entry);
+        return;
+    }
+
+    // Partitioned like search_scan; helpers read the caller's block, which
+    // outlives parallel_for.
+    size_t n = rows_.size();
+    size_t parts = 1;
+    if (search_pool_) {
+        parts = std::min(search_pool_->size() + 1, n / PARALLEL_SCAN_MIN_SLOTS);
+    }
+    if (parts <= 1) {
+        scan_block_range(block.data(), 0, n, tops);
+        return;
+    }
+
+    std::vector<std::vector<TopK>> partial(parts,
+                                           std::vector<TopK>(tops.size(), TopK(tops[0].k())));
+    search_pool_->parallel_for(parts, [&](size_t begin, size_t end) {
+        for (size_t p = begin; p < end; ++p) {
+            scan_block_range(block.data(), n * p / parts, n * (p + 1) / parts, partial[p]);
+        }
+    });
+    for (const auto& part : partial) {
+        for (size_t j = 0; j < tops.size(); ++j) {
+            tops[j].merge(part[j]);
         }
     }
+}
 
-    // Sort descending by score
-    std::sort(scored.begin(), scored.end(),
-              [](const auto& a, const auto& b) { return a.first > b.first; });
+void VectorDB::scan_block_range(const float* block, size_t begin, size_t end,
+                                std::vector<TopK>& tops) const {
+    float scores[simd::QUERY_BLOCK];
+    for (size_t slot = begin; slot < end; ++slot) {
+        if (!live_[slot]) {
+            continue;
+        }
+        score_block(block, static_cast<uint32_t>(slot), scores);
+        for (size_t j = 0; j < tops.size(); ++j) {
+            if (scores[j] > 0.0f) {
+                tops[j].push(scores[j], static_cast<uint32_t>(slot));
+            }
+        }
+    }
+}
 
-    // Take top_k
-    std::vector<SearchResult> results;
-    int count = std::min(top_k, static_cast<int>(scored.size()));
-    for (int i = 0; i < count; ++i) {
-        results.push_back({
-            scored[i].second->chunk_id,
-            scored[i].first,
-            scored[i].second->text,
-            scored[i].second->metadata
-        });
+void VectorDB::score_block(const float* block, uint32_t slot, float* scores) const {
+    const RowRef& row = rows_[slot];
+    if (quantize_) {
+        simd::block_dot(row_indices(row), row_codes_.data() + row.offset, row.nnz, block, scores);
+        for (size_t j = 0; j < simd::QUERY_BLOCK; ++j) {
+            scores[j] *= row.scale;
+        }
+        return;
     }
+    simd::block_dot(row_indices(row), row_values(row), row.nnz, block, scores);
+}
 
-    return results;
+void VectorDB::rerank(const SparseVector& query, TopK& candidates, TopK& top) const {
+    QueryScratch query_dense(query);
+    for (const auto& candidate : candidates.take_sorted()) {
+        uint32_t slot = candidate.second;
+        auto lossy = lossy_values_.find(slot);
+        if (lossy == lossy_values_.end()) {
+            top.push(candidate.first, slot);
+            continue;
+        }
+        float score = sparse_dot(query, query_dense.data(), row_indices(rows_[slot]),
+                                 lossy->second.data(), rows_[slot].nnz);
+        if (score > 0.0f) {
+            top.push(score, slot);
+        }
+    }
 }
 
-float VectorDB::dot_product(const std::vector<float>& a, const std::vector<float>& b) {
-    float sum = 0.0f;
-    size_t n = std::min(a.size(), b.size());
-    for (size_t i = 0; i < n; ++i) {
-        sum += a[i] * b[i];
+float VectorDB::dot_product(const SparseVector& query, const float* query_dense,
+                            uint32_t slot) const {
+    const RowRef& row = rows_[slot];
+    if (quantize_) {
+        return row.scale * sparse_dot(query, query_dense, row_indices(row),
+                                      row_codes_.data() + row.offset, row.nnz);
     }
-    return sum;
+    return sparse_dot(query, query_dense, row_indices(row), row_values(row), row.nnz);
 }
@@ -1,17 +1,41 @@
 #pragma once
 
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
 #include <string>
+#include <string_view>
+#include <thread>
 #include <unordered_map>
 #include <vector>
 
 #include <nlohmann/json.hpp>
 
+#include "aligned_allocator.hpp"
+#include "ann_index.hpp"
+#include "embedder.hpp"
+#include "lru_cache.hpp"
+#include "snapshot.hpp"
+#include "string_arena.hpp"
+#include "thread_pool.hpp"
+#include "top_k.hpp"
+#include "wal.hpp"
+
 struct VectorEntry {
     std::string chunk_id;
     std::string doc_id;
     std::string text;
     nlohmann::json metadata;
-    std::vector<float> embedding;
+    SparseVector embedding;
+
+    // Opaque to the store; clients set it to a digest of whatever the
+    // entry was derived from, to tell later whether it needs redoing.
+    // Empty if not given.
+    std::string content_hash;
 };
 
 struct SearchResult {
@@ -21,27 +45,406 @@ struct SearchResult {
     nlohmann::json metadata;
 };
 
+// A search result that refers into the store instead of copying it. Only
+// valid inside the visitor it is passed to.
+struct SearchHit {
+    std::string_view chunk_id;
+    float score;
+    std::string_view text;
+    std::string_view metadata_cbor;
+
+    // Decoded from metadata_cbor on each call; a caller that never asks
+    // for metadata never pays for it.
+    nlohmann::json metadata() const;
+};
+
+enum class SearchMode {
+    Auto,   // inverted index when unfiltered, doc scan when filtered
+    Index,  // inverted index only
+    Scan,   // brute force over every candidate; for verifying the index
+    Approx, // HNSW graph when unfiltered, doc scan when filtered; may miss
+            // some of the true top-k
+};
+
+struct VectorDBOptions {
+    // Threads (the caller included) one unfiltered scan is split across;
+    // 1 keeps every search on the caller.
+    size_t search_threads = 1;
+
+    // Store embedding rows and inverted index weights as int8 codes with
+    // a per-row scale instead of floats. Most rows are small multiples of
+    // their smallest value and lose nothing; the few that would keep
+    // their floats too, and every search re-scores those among its best
+    // candidates with them.
+    bool quantize = false;
+
+    // Maintain an HNSW graph for SearchMode::Approx. Without one, Approx
+    // falls back to the exact inverted index.
+    bool hnsw = false;
+
+    // Memory for remembered search results, reused until a store changes
+    // what they cover; 0 disables the cache.
+    size_t result_cache_bytes = 0;
+};
+
+// What VectorDB::stats() reports.
+struct VectorDBStats {
+    size_t entries = 0;
+    size_t docs = 0;
+    size_t slots = 0;    // live entries plus retired ones awaiting compaction
+    size_t live_nnz = 0; // embedding elements of live entries
+    size_t dead_nnz = 0; // and of retired ones
+
+    // Chunk and doc id, text, metadata and content hash bytes of live and
+    // of retired entries.
+    size_t live_string_bytes = 0;
+    size_t dead_string_bytes = 0;
+
+    // Approximate heap the store's own arrays, arena and maps take, HNSW
+    // graph and result cache not included; a mapped snapshot is counted
+    // separately.
+    size_t heap_bytes = 0;
+    size_t mapped_bytes = 0;
+};
+
+// Thread-safe: concurrent searches share a reader lock, stores and
+// deletes take the writer lock and are serialized.
 class VectorDB {
 public:
-    // Insert or overwrite an entry by chunk_id.
-    void store(const std::string& chunk_id,
-               const std::string& doc_id,
-               const std::string& text,
-               const nlohmann::json& metadata,
-               const std::vector<float>& embedding);
-
-    // Brute-force cosine similarity search.
-    // If doc_id_filter is non-empty, only search within that doc_id.
-    std::vector<SearchResult> search(const std::vector<float>& query_embedding,
+    explicit VectorDB(const VectorDBOptions& options = VectorDBOptions());
+    ~VectorDB();
+
+    // Insert or overwrite an entry by chunk_id. Taken by value: callers
+    // move their fields in, and nothing is copied until the entry's bytes
+    // land in the store's own arrays.
+    void store(VectorEntry entry);
+
+    // Insert or overwrite several entries under a single writer lock.
+    // Later entries win if the batch repeats a chunk_id.
+    void store_batch(std::vector<VectorEntry> entries);
+
+    // Remove every entry of a document, or one entry by chunk_id. Returns
+    // how many entries were removed; nothing is logged if none were.
+    // Their rows stay allocated until a background compaction reclaims
+    // them, which starts once dead rows outnumber live ones.
+    size_t delete_doc(const std::string& doc_id);
+    size_t delete_chunk(const std::string& chunk_id);
+
+    // Cosine similarity search. If doc_id_filter is non-empty, only search
+    // within that doc_id. Every exact mode returns the same ranking;
+    // entries that share no bucket with the query (score 0) are never
+    // returned. ef_search is the Approx beam width (0 = HNSW_EF_SEARCH);
+    // wider finds more of the true top-k at more cost.
+    std::vector<SearchResult> search(const SparseVector& query_embedding,
                                      int top_k,
-                                     const std::string& doc_id_filter = "") const;
+                                     const std::string& doc_id_filter = "",
+                                     SearchMode mode = SearchMode::Auto,
+                                     size_t ef_search = 0) const;
+
+    // Same search, but hands each hit to visit, best first, while the
+    // reader lock is held, so the caller can serialize only what it needs
+    // without copying entries. visit must not call back into the store.
+    void search(const SparseVector& query_embedding,
+                int top_k,
+                const std::string& doc_id_filter,
+                SearchMode mode,
+                size_t ef_search,
+                const std::function<void(const SearchHit&)>& visit) const;
+
+    // Several searches sharing top_k, filter and mode, under one reader
+    // lock. Where the mode scans rows (a doc filter, or Scan), each row is
+    // scored against up to simd::QUERY_BLOCK queries as it is loaded, so a
+    // batch costs about one pass over the rows rather than one per query;
+    // index and graph searches run query by query. visit gets each hit
+    // with its query's position: query 0's hits best first, then query
+    // 1's, and so on.
+    void search_batch(const std::vector<SparseVector>& queries,
+                      int top_k,
+                      const std::string& doc_id_filter,
+                      SearchMode mode,
+                      size_t ef_search,
+                      const std::function<void(size_t, const SearchHit&)>& visit) const;
+
+    // Under one reader lock, hands visit each of chunk_ids that is stored:
+    // its position in chunk_ids, its content hash (empty if stored
+    // without one) and the entry, scored 0. visit must not call back into
+    // the store.
+    void lookup(const std::vector<std::string>& chunk_ids,
+                const std::function<void(size_t, std::string_view, const SearchHit&)>& visit)
+        const;
+
+    // The chunk_ids of a document's entries, in no particular order.
+    std::vector<std::string> doc_chunk_ids(const std::string& doc_id) const;
+
+    // Write every live entry to `path` (via a temporary file and rename,
+    // so a crash never leaves a torn snapshot). Stores wait while the file
+    // image is built in memory (transiently as large as the snapshot), not
+    // for the writes or the fsync; searches proceed. Returns the
+    // LSN of the last WAL record the snapshot covers. Throws
+    // std::runtime_error on I/O failure.
+    uint64_t save_snapshot(const std::string& path) const;
+
+    // Map a snapshot written by save_snapshot. Embedding rows and strings
+    // are read in place from the mapping rather than copied (metadata is
+    // only validated), and so is a saved HNSW graph; one is rebuilt only
+    // for snapshots without it. A snapshot from another
+    // EMBEDDER_VERSION is re-embedded from its text instead. Must be
+    // called before any store. Throws std::runtime_error if the file is
+    // unreadable or not a valid snapshot.
+    void load_snapshot(const std::string& path);
+
+    size_t size() const;
+
+    // Takes the reader lock; meant for monitoring, not the request path.
+    VectorDBStats stats() const;
+
+    // Log every store and delete to `wal` before applying it; either
+    // returns once the log has committed it. Attach before serving
+    // requests and detach (nullptr) after: stores read the pointer
+    // without the lock.
+    //
+    // If the log fails to commit a write, it throws, and its outcome is
+    // unknown: the write stays visible to searches, but the store turns
+    // read-only (later stores, deletes and save_snapshot throw) until a
+    // restart replays the log, which has the final say.
+    void attach_wal(WriteAheadLog* wal);
+
+    // Re-apply a record read back by WriteAheadLog::replay. Throws
+    // std::runtime_error if the payload does not decode.
+    void replay_wal_record(uint64_t lsn, WriteAheadLog::RecordType type,
+                           const char* payload, size_t length);
+
+    // LSN of the last logged store or delete that has been applied.
+    uint64_t applied_lsn() const;
+
+    uint64_t result_cache_hits() const { return result_cache_hits_.load(std::memory_order_relaxed); }
+    uint64_t result_cache_misses() const { return result_cache_misses_.load(std::memory_order_relaxed); }
 
 private:
-    // Primary store: chunk_id -> entry
-    std::unordered_map<std::string, VectorEntry> entries_;
+    mutable std::shared_mutex mutex_;
+    // Taken before the writer lock by every store and delete, and held by
+    // compact() for a whole pass; see there.
+    std::mutex write_mutex_;
+
+    // Entries live in dense slots; every per-entry field is a parallel
+    // array indexed by slot. An overwritten entry moves to a new slot and
+    // a deleted one leaves its slot; either way the old slot is retired:
+    // the postings still name it, so it is only put on free_slots_ for
+    // reuse once compact() has purged them.
+    //
+    // Strings are views into strings_ (or the snapshot mapping), and
+    // metadata is kept as the CBOR it is stored in, decoded only when a
+    // search returns it. A retired entry's bytes (its chunk_id only once
+    // deleted, and its doc_id once the doc has no entries left) stay behind
+    // as dead_bytes_ until compact() repacks the live ones.
+    std::vector<std::string_view> chunk_ids_;
+    std::vector<uint32_t> doc_of_slot_;
+    std::vector<uint32_t> doc_pos_; // index in docs_[doc_of_slot_].slots
+    std::vector<std::string_view> texts_;
+    std::vector<std::string_view> metadata_;
+    std::vector<std::string_view> content_hashes_;
+    std::vector<uint8_t> live_;
+    std::vector<uint32_t> retired_slots_;
+    std::vector<uint32_t> free_slots_;
+
+    // Embeddings, CSR style: slot s owns rows_[s].nnz consecutive elements
+    // starting at rows_[s].offset. Rows are appended in store order, so a
+    // scan streams through two contiguous, cache-line-aligned arrays.
+    // Offsets below mapped_nnz_ address rows mapped from a snapshot; the
+    // rest address row_indices_/row_values_, shifted by mapped_nnz_.
+    // Retired rows stay in place until compact().
+    //
+    // When quantized, row_values_ stays empty and row_codes_ holds
+    // value / scale rounded to int8 instead. It covers mapped rows too
+    // (a snapshot stores floats), so it is indexed by offset unshifted.
+    // lossy_values_ keeps the floats of the rows whose codes lost
+    // something, by slot; searches re-score their candidates from it.
+    struct RowRef {
+        size_t offset;
+        uint32_t nnz;
+        float scale; // quantized rows only
+    };
+    bool quantize_;
+    std::vector<RowRef> rows_;
+    AlignedVector<uint16_t> row_indices_;
+    AlignedVector<float> row_values_;
+    AlignedVector<int8_t> row_codes_;
+    std::unordered_map<uint32_t, std::vector<float>> lossy_values_;
+    size_t live_nnz_ = 0;
+    size_t dead_nnz_ = 0;
+
+    StringArena strings_;
+    std::vector<uint8_t> cbor_scratch_; // reused to encode stored metadata
+    size_t live_bytes_ = 0;
+    size_t dead_bytes_ = 0;
+
+    std::unique_ptr<MappedFile> snapshot_map_;
+    const uint16_t* mapped_indices_ = nullptr;
+    const float* mapped_values_ = nullptr;
+    size_t mapped_nnz_ = 0;
+
+    const uint16_t* row_indices(const RowRef& row) const {
+        return row.offset < mapped_nnz_ ? mapped_indices_ + row.offset
+                                        : row_indices_.data() + (row.offset - mapped_nnz_);
+    }
+    const float* row_values(const RowRef& row) const {
+        return row.offset < mapped_nnz_ ? mapped_values_ + row.offset
+                                        : row_values_.data() + (row.offset - mapped_nnz_);
+    }
+
+    // chunk_id -> live slot. Keys view chunk_ids_ bytes; an overwrite
+    // keeps the old bytes, which stay valid until compact().
+    std::unordered_map<std::string_view, uint32_t> slot_of_;
+
+    // Interned doc_ids: entries name their doc by an index into docs_.
+    // A doc whose last entry goes is released and its index reused.
+    struct Doc {
+        std::string_view id;
+        std::vector<uint32_t> slots; // live ones, in no particular order
+        uint64_t generation = 0;     // see generation_
+    };
+    std::vector<Doc> docs_;
+    std::vector<uint32_t> free_docs_;
+    std::unordered_map<std::string_view, uint32_t> doc_index_; // doc_id -> docs_ index
+
+    // Inverted index: bucket -> every row with a non-zero value in that
+    // bucket, and the value. That is kept as the row's own code when
+    // quantized (scaled by rows_[slot].scale), as a float otherwise.
+    // Retired slots keep their postings (live_ filters them) until
+    // compact().
+    struct PostingList {
+        std::vector<uint32_t> slots;
+        std::vector<float> weights;
+        std::vector<int8_t> codes;
+    };
+    std::vector<PostingList> postings_ = std::vector<PostingList>(EMBED_DIM);
+
+    WriteAheadLog* wal_ = nullptr;
+    uint64_t applied_lsn_ = 0;
+    std::string wal_error_; // set once a commit fails; see attach_wal
+
+    // Caller must hold the writer lock (check_writable) or no lock
+    // (commit, which turns the store read-only if the log fails).
+    void check_writable() const;
+    void commit(WriteAheadLog* wal, uint64_t lsn);
+
+    // Every store or delete bumps generation_ and stamps each doc it
+    // changes with the new value. A cached filtered result is current
+    // while its doc's stamp is unchanged; an unfiltered one while
+    // generation_ is. A released doc reads as 0, like one never stored:
+    // results cached under 0 are empty, and so correct for it again.
+    uint64_t generation_ = 0;
+
+    // Search results by query embedding and parameters, as slots. Lookups
+    // happen under the reader lock, so a result is never computed across a
+    // store.
+    struct CachedSearch {
+        uint64_t generation;
+        std::vector<TopK::Item> hits;
+    };
+    mutable std::mutex result_cache_mutex_;
+    mutable LruCache<std::string, CachedSearch> result_cache_;
+    mutable std::atomic<uint64_t> result_cache_hits_{0};
+    mutable std::atomic<uint64_t> result_cache_misses_{0};
+
+    // Helpers for partitioned scans; null when search_threads == 1.
+    std::unique_ptr<ThreadPool> search_pool_;
+
+    // Graph over every slot with a row, retired ones included (live_
+    // filters them). compact(), which drops their rows, relinks around
+    // them; snapshots carry the graph. Null unless VectorDBOptions::hnsw.
+    std::unique_ptr<AnnIndex> ann_;
+
+    // Runs compact() off the request path once compaction_due(); woken by
+    // request_compaction(). The repack is built under the reader lock and
+    // only swapped in under the writer lock.
+    std::thread compactor_;
+    std::mutex compactor_mutex_;
+    std::condition_variable compactor_cv_;
+    bool compaction_requested_ = false;
+    bool compactor_stop_ = false;
+    void compactor_loop();
+
+    // Caller must hold the writer lock.
+    void store_locked(VectorEntry&& entry);
+    size_t delete_doc_locked(const std::string& doc_id);
+    size_t delete_chunk_locked(const std::string& chunk_id);
+    uint32_t allocate_slot();
+    void retire_slot(uint32_t slot);
+    // Drops the slot_of_ key of a deleted (not overwritten) entry.
+    void forget_chunk_id(uint32_t slot);
+    uint32_t intern_doc(std::string_view doc_id);
+    // Stamps the doc with a new generation, or releases it if empty.
+    void touch_doc(uint32_t doc);
+    bool compaction_due() const;
+    void request_compaction();
+    void compact();
+    void rebuild_ann();
+
+    // Rates two stored rows against each other, for relinking the graph.
+    // Holds a QueryScratch; use it on one thread, with no other scratch
+    // alive there.
+    PairScorer row_scorer() const;
+
+    // Copy of the row in slot (dequantized if need be).
+    SparseVector row_vector(uint32_t slot) const;
+
+    // Append the int8 codes of n values to out; returns the scale that
+    // maps a code back to its value. exact is set if no value was rounded.
+    static float quantize_row(const float* values, size_t n, AlignedVector<int8_t>& out,
+                              bool& exact);
+
+    // The mode Auto (or an Approx that cannot apply) stands for.
+    SearchMode resolve_mode(SearchMode mode, const std::string& doc_id_filter) const;
+
+    // Caller must hold the reader lock. The ranked (score, slot) hits for a
+    // resolved mode, from the result cache when still current.
+    std::vector<TopK::Item> find_hits(const SparseVector& query, size_t top_k,
+                                      const std::string& doc_id_filter, SearchMode mode,
+                                      size_t ef_search) const;
+    // Same for a batch in SearchMode::Scan; hits[i] answers queries[i].
+    void find_hits_batch(const std::vector<SparseVector>& queries, size_t top_k,
+                         const std::string& doc_id_filter,
+                         std::vector<std::vector<TopK::Item>>& hits) const;
+
+    // Result cache entries are keyed by query and parameters and hold the
+    // generation they were computed at (see generation_). Caller must hold
+    // the reader lock.
+    static std::string result_cache_key(const SparseVector& query, size_t top_k,
+                                        const std::string& doc_id_filter, SearchMode mode,
+                                        size_t ef_search);
+    uint64_t result_generation(const std::string& doc_id_filter) const;
+    bool cached_hits(const std::string& key, uint64_t generation,
+                     std::vector<TopK::Item>& hits) const;
+    void cache_hits(std::string key, uint64_t generation,
+                    const std::vector<TopK::Item>& hits) const;
+
+    // Caller must hold the reader lock. Push every positive-scoring
+    // candidate into `top`.
+    void search_index(const SparseVector& query, const std::string& doc_id_filter,
+                      TopK& top) const;
+    void search_scan(const SparseVector& query, const std::string& doc_id_filter,
+                     TopK& top) const;
+    void scan_range(const SparseVector& query, size_t begin, size_t end, TopK& top) const;
+    void search_ann(const SparseVector& query, size_t ef_search, TopK& top) const;
+
+    // search_scan for up to simd::QUERY_BLOCK queries in one pass;
+    // tops[j] collects queries[j]'s candidates. block is the queries laid
+    // out for simd::block_dot.
+    void search_scan_batch(const std::vector<const SparseVector*>& queries,
+                           const std::string& doc_id_filter, std::vector<TopK>& tops) const;
+    void scan_block_range(const float* block, size_t begin, size_t end,
+                          std::vector<TopK>& tops) const;
+    // scores[j] = dot product of the row in slot with query j of block.
+    void score_block(const float* block, uint32_t slot, float* scores) const;
 
-    // Secondary index: doc_id -> [chunk_ids]
-    std::unordered_map<std::string, std::vector<std::string>> doc_index_;
+    // Re-score quantized candidates exactly (lossy rows from their kept
+    // floats) and keep the best in top.
+    void rerank(const SparseVector& query, TopK& candidates, TopK& top) const;
 
-    static float dot_product(const std::vector<float>& a, const std::vector<float>& b);
+    // Dot product of the row in `slot` with the query. query_dense is the
+    // query scattered into EMBED_DIM floats (zero elsewhere). Approximate
+    // when quantized.
+    float dot_product(const SparseVector& query, const float* query_dense,
+                      uint32_t slot) const;
 };
@@ -0,0 +1,439 @@
+#include "wal.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <chrono>
+#include <cinttypes>
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <dirent.h>
+#include <fcntl.h>
+#include <iostream>
+#include <stdexcept>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+// On disk every record is this header followed by `length` payload bytes.
+// The CRC covers the payload, then lsn, type and reserved.
+struct RecordHeader {
+    uint32_t length;
+    uint32_t crc;
+    uint64_t lsn;
+    uint32_t type;
+    uint32_t reserved;
+};
+
+constexpr size_t CRC_COVERED_HEADER = sizeof(RecordHeader) - offsetof(RecordHeader, lsn);
+
+// Records are bounded by the request frame size; anything longer is a
+// corrupt length field, not a record.
+constexpr uint32_t MAX_RECORD_BYTES = 64 << 20;
+
+// CRC-32 (IEEE 802.3, as in zlib), table driven.
+uint32_t crc32_update(uint32_t crc, const void* data, size_t n) {
+    static const auto table = [] {
+        std::array<uint32_t, 256> t{};
+        for (uint32_t i = 0; i < 256; ++i) {
+            uint32_t c = i;
+            for (int k = 0; k < 8; ++k) {
+                c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+            }
+            t[i] = c;
+        }
+        return t;
+    }();
+    const auto* p = static_cast<const uint8_t*>(data);
+    crc = ~crc;
+    for (size_t i = 0; i < n; ++i) {
+        crc = table[(crc ^ p[i]) & 0xFF] ^ (crc >> 8);
+    }
+    return ~crc;
+}
+
+uint32_t record_crc(uint32_t payload_crc, const RecordHeader& header) {
+    return crc32_update(payload_crc, &header.lsn, CRC_COVERED_HEADER);
+}
+
+std::string segment_name(uint64_t first_lsn) {
+    char name[48];
+    std::snprintf(name, sizeof(name), "wal-%020" PRIu64 ".log", first_lsn);
+    return name;
+}
+
+bool parse_segment_name(const char* name, uint64_t& first_lsn) {
+    unsigned long long lsn = 0;
+    int consumed = 0;
+    if (std::sscanf(name, "wal-%20llu.log%n", &lsn, &consumed) != 1 ||
+        name[consumed] != '\0' || std::strlen(name) != segment_name(lsn).size()) {
+        return false;
+    }
+    first_lsn = lsn;
+    return true;
+}
+
+std::string read_file(const std::string& path) {
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        throw std::runtime_error("Cannot open " + path + ": " + strerror(errno));
+    }
+    std::string data;
+    char buf[1 << 16];
+    while (true) {
+        ssize_t n = ::read(fd, buf, sizeof(buf));
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            int err = errno;
+            ::close(fd);
+            throw std::runtime_error("Cannot read " + path + ": " + strerror(err));
+        }
+        if (n == 0) {
+            break;
+        }
+        data.append(buf, static_cast<size_t>(n));
+    }
+    ::close(fd);
+    return data;
+}
+
+void fsync_dir(const std::string& dir) {
+    int fd = ::open(dir.c_str(), O_RDONLY);
+    if (fd >= 0) {
+        ::fsync(fd);
+        ::close(fd);
+    }
+}
+
+// Segments replay cannot apply are renamed with this suffix, which
+// parse_segment_name does not accept, so later startups skip them.
+const char* const DAMAGED_SUFFIX = ".damaged";
+
+void write_file(const std::string& path, const char* data, size_t n) {
+    int fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        throw std::runtime_error("Cannot create " + path + ": " + strerror(errno));
+    }
+    while (n > 0) {
+        ssize_t w = ::write(fd, data, n);
+        if (w < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            int err = errno;
+            ::close(fd);
+            throw std::runtime_error("Cannot write " + path + ": " + strerror(err));
+        }
+        data += w;
+        n -= static_cast<size_t>(w);
+    }
+    ::fsync(fd);
+    ::close(fd);
+}
+
+void move_aside(const std::string& path) {
+    std::string target = path + DAMAGED_SUFFIX;
+    if (::rename(path.c_str(), target.c_str()) < 0) {
+        throw std::runtime_error("Cannot rename " + path + ": " + strerror(errno));
+    }
+}
+
+} // namespace
+
+bool parse_fsync_policy(const std::string& name, FsyncPolicy& policy) {
+    if (name == "always") {
+        policy = FsyncPolicy::Always;
+    } else if (name == "interval") {
+        policy = FsyncPolicy::Interval;
+    } else if (name == "never") {
+        policy = FsyncPolicy::Never;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+WriteAheadLog::WriteAheadLog(const std::string& dir, FsyncPolicy policy)
+    : dir_(dir), policy_(policy) {}
+
+WriteAheadLog::~WriteAheadLog() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    work_cv_.notify_one();
+    if (flusher_.joinable()) {
+        flusher_.join();
+    }
+    if (fd_ >= 0) {
+        ::close(fd_);
+    }
+}
+
+size_t WriteAheadLog::replay(uint64_t after_lsn, const ReplayFn& fn) {
+    DIR* d = ::opendir(dir_.c_str());
+    if (d == nullptr) {
+        throw std::runtime_error("Cannot open WAL dir " + dir_ + ": " + strerror(errno));
+    }
+    while (dirent* ent = ::readdir(d)) {
+        uint64_t first_lsn;
+        if (parse_segment_name(ent->d_name, first_lsn)) {
+            segments_.push_back({first_lsn, dir_ + "/" + ent->d_name});
+        }
+    }
+    ::closedir(d);
+    std::sort(segments_.begin(), segments_.end(),
+              [](const Segment& a, const Segment& b) { return a.first_lsn < b.first_lsn; });
+
+    size_t replayed = 0;
+    uint64_t prev_lsn = 0;
+    for (size_t i = 0; i < segments_.size(); ++i) {
+        const Segment& segment = segments_[i];
+        std::string data = read_file(segment.path);
+        size_t pos = 0;
+        bool torn = false;
+        while (pos < data.size()) {
+            RecordHeader header;
+            const char* payload = nullptr;
+            torn = data.size() - pos < sizeof(header);
+            if (!torn) {
+                std::memcpy(&header, data.data() + pos, sizeof(header));
+                payload = data.data() + pos + sizeof(header);
+                torn = header.length > MAX_RECORD_BYTES ||
+                    header.length > data.size() - pos - sizeof(header) ||
+                    record_crc(crc32_update(0, payload, header.length), header) != header.crc;
+            }
+            if (torn) {
+                break;
+            }
+            // The oldest surviving record may follow ones a checkpoint
+            // removed, but must not skip past the snapshot; after it the
+            // LSNs run without holes.
+            uint64_t expected = prev_lsn == 0 ? std::min(header.lsn, after_lsn + 1) : prev_lsn + 1;
+            if (header.lsn != expected || header.lsn == 0) {
+                break;
+            }
+            if (header.lsn > after_lsn) {
+                fn(header.lsn, static_cast<RecordType>(header.type), payload, header.length);
+                ++replayed;
+            }
+            prev_lsn = header.lsn;
+            pos += sizeof(header) + header.length;
+        }
+        if (pos == data.size()) {
+            continue;
+        }
+        if (torn && i + 1 == segments_.size()) {
+            // Only the tail a crash interrupted can be torn; cut it so the
+            // segment ends on a record boundary.
+            std::cerr << "[vectordb] WAL " << segment.path << ": dropping "
+                      << data.size() - pos << " bytes of torn record at offset " << pos
+                      << std::endl;
+            if (::truncate(segment.path.c_str(), static_cast<off_t>(pos)) < 0) {
+                throw std::runtime_error("Cannot truncate " + segment.path + ": " + strerror(errno));
+            }
+            break;
+        }
+        // Damage before the newest segment, or an LSN hole, means later
+        // records cannot be applied in order. Replay stops here and moves
+        // everything after the break aside, intact, for inspection.
+        std::cerr << "[vectordb] WAL " << segment.path << ": "
+                  << (torn ? "damaged" : "out-of-sequence") << " record at offset " << pos
+                  << " after LSN " << prev_lsn << "; moving the rest of the log aside as *"
+                  << DAMAGED_SUFFIX << std::endl;
+        size_t keep = i + 1;
+        if (pos == 0) {
+            move_aside(segment.path);
+            keep = i;
+        } else {
+            write_file(segment.path + DAMAGED_SUFFIX, data.data() + pos, data.size() - pos);
+            if (::truncate(segment.path.c_str(), static_cast<off_t>(pos)) < 0) {
+                throw std::runtime_error("Cannot truncate " + segment.path + ": " + strerror(errno));
+            }
+        }
+        for (size_t j = i + 1; j < segments_.size(); ++j) {
+            move_aside(segments_[j].path);
+        }
+        segments_.resize(keep);
+        fsync_dir(dir_);
+        break;
+    }
+
+    last_lsn_ = written_lsn_ = synced_lsn_ = std::max(after_lsn, prev_lsn);
+    open_segment(last_lsn_ + 1);
+    flusher_ = std::thread(&WriteAheadLog::flusher_loop, this);
+    return replayed;
+}
+
+uint64_t WriteAheadLog::append(RecordType type, const std::string& payload) {
+    if (payload.size() > MAX_RECORD_BYTES) {
+        throw std::runtime_error("WAL record too large: " + std::to_string(payload.size()) + " bytes");
+    }
+    uint32_t payload_crc = crc32_update(0, payload.data(), payload.size());
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!error_.empty()) {
+        throw std::runtime_error("WAL write failed: " + error_);
+    }
+    RecordHeader header{};
+    header.length = static_cast<uint32_t>(payload.size());
+    header.lsn = ++last_lsn_;
+    header.type = type;
+    header.crc = record_crc(payload_crc, header);
+    buffer_.append(reinterpret_cast<const char*>(&header), sizeof(header));
+    buffer_.append(payload);
+    bytes_since_checkpoint_ += sizeof(header) + payload.size();
+    work_cv_.notify_one();
+    return header.lsn;
+}
+
+void WriteAheadLog::commit(uint64_t lsn) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    done_cv_.wait(lock, [&] {
+        uint64_t durable = policy_ == FsyncPolicy::Always ? synced_lsn_ : written_lsn_;
+        return durable >= lsn || !error_.empty();
+    });
+    uint64_t durable = policy_ == FsyncPolicy::Always ? synced_lsn_ : written_lsn_;
+    if (durable < lsn) {
+        throw std::runtime_error("WAL write failed: " + error_);
+    }
+}
+
+size_t WriteAheadLog::bytes_since_checkpoint() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return bytes_since_checkpoint_;
+}
+
+void WriteAheadLog::checkpoint(uint64_t lsn) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    bytes_since_checkpoint_ = 0;
+
+    // A closed segment only holds LSNs below the next segment's first one.
+    // The last segment is the open one and is never removed.
+    size_t removable = 0;
+    while (removable + 1 < segments_.size() && segments_[removable + 1].first_lsn <= lsn + 1) {
+        ++removable;
+    }
+    for (size_t i = 0; i < removable; ++i) {
+        if (::unlink(segments_[i].path.c_str()) < 0 && errno != ENOENT) {
+            std::cerr << "[vectordb] Cannot remove " << segments_[i].path << ": "
+                      << strerror(errno) << std::endl;
+        }
+    }
+    segments_.erase(segments_.begin(), segments_.begin() + removable);
+}
+
+void WriteAheadLog::open_segment(uint64_t first_lsn) {
+    std::string path = dir_ + "/" + segment_name(first_lsn);
+    // A segment already named first_lsn holds no valid record (replay
+    // would have moved last_lsn_ past it), so truncating loses nothing.
+    int fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_APPEND, 0644);
+    if (fd < 0) {
+        throw std::runtime_error("Cannot create " + path + ": " + strerror(errno));
+    }
+    fsync_dir(dir_);
+    if (fd_ >= 0) {
+        ::close(fd_);
+    }
+    fd_ = fd;
+    segment_bytes_ = 0;
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (segments_.empty() || segments_.back().path != path) {
+        segments_.push_back({first_lsn, path});
+    }
+}
+
+void WriteAheadLog::flusher_loop() {
+    auto last_sync = std::chrono::steady_clock::now();
+    const auto interval = std::chrono::milliseconds(WAL_SYNC_INTERVAL_MS);
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (true) {
+        auto ready = [&] { return stopping_ || !buffer_.empty(); };
+        if (policy_ == FsyncPolicy::Interval) {
+            work_cv_.wait_for(lock, interval, ready);
+        } else {
+            work_cv_.wait(lock, ready);
+        }
+        bool stop = stopping_ && buffer_.empty();
+        std::string batch;
+        batch.swap(buffer_);
+        uint64_t batch_first = written_lsn_ + 1;
+        uint64_t batch_last = last_lsn_;
+        uint64_t synced = synced_lsn_;
+        lock.unlock();
+
+        // Commits that arrive while this batch is written and synced pile
+        // up in buffer_ and go out together in the next round.
+        bool did_sync = false;
+        std::string error;
+        try {
+            if (!batch.empty()) {
+                if (segment_bytes_ >= WAL_SEGMENT_BYTES) {
+                    if (policy_ != FsyncPolicy::Never) {
+                        sync();
+                    }
+                    open_segment(batch_first);
+                }
+                write_all(batch);
+            }
+            auto now = std::chrono::steady_clock::now();
+            bool want_sync = policy_ == FsyncPolicy::Always ||
+                (policy_ == FsyncPolicy::Interval && (stop || now - last_sync >= interval));
+            if (want_sync && synced < batch_last) {
+                sync();
+                did_sync = true;
+                last_sync = now;
+            }
+        } catch (const std::exception& e) {
+            error = e.what();
+        }
+
+        lock.lock();
+        if (!error.empty()) {
+            std::cerr << "[vectordb] WAL disabled: " << error << std::endl;
+            error_ = error;
+            done_cv_.notify_all();
+            return;
+        }
+        written_lsn_ = batch_last;
+        if (did_sync) {
+            synced_lsn_ = batch_last;
+        }
+        done_cv_.notify_all();
+        if (stop) {
+            return;
+        }
+    }
+}
+
+void WriteAheadLog::write_all(const std::string& data) {
+    size_t done = 0;
+    while (done < data.size()) {
+        ssize_t n = ::write(fd_, data.data() + done, data.size() - done);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            throw std::runtime_error("write failed: " + std::string(strerror(errno)));
+        }
+        done += static_cast<size_t>(n);
+    }
+    segment_bytes_ += data.size();
+}
+
+void WriteAheadLog::sync() {
+#ifdef __APPLE__
+    int rc = ::fsync(fd_);
+#else
+    int rc = ::fdatasync(fd_);
+#endif
+    if (rc < 0) {
+        throw std::runtime_error("fsync failed: " + std::string(strerror(errno)));
+    }
+}
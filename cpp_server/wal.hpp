@@ -0,0 +1,111 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Segment size at which the log rolls over to a new file.
+constexpr size_t WAL_SEGMENT_BYTES = 64 << 20;
+
+// Upper bound on how long FsyncPolicy::Interval leaves writes unsynced.
+constexpr int WAL_SYNC_INTERVAL_MS = 100;
+
+// How durable a committed record is when commit() returns.
+enum class FsyncPolicy {
+    Always,   // fsynced: survives power loss
+    Interval, // written to the OS, fsynced at most WAL_SYNC_INTERVAL_MS later
+    Never,    // written to the OS; survives a process crash, not power loss
+};
+
+// Parses "always", "interval" or "never". Returns false for anything else.
+bool parse_fsync_policy(const std::string& name, FsyncPolicy& policy);
+
+// Append-only write-ahead log of opaque records, each numbered with a
+// log sequence number (LSN) and CRC-checked. Records go to segment files
+// <dir>/wal-<first lsn>.log, which roll over once they reach
+// WAL_SEGMENT_BYTES so that checkpoints can drop whole files.
+//
+// A single background thread writes buffered records, so concurrent
+// commits share one write and one fsync (group commit).
+class WriteAheadLog {
+public:
+    enum RecordType : uint32_t {
+        StoreBatchUnversioned = 1, // logs written before EMBEDDER_VERSION
+        StoreBatchUnhashed = 2,    // and before content hashes
+        DeleteDoc = 3,
+        DeleteChunk = 4,
+        StoreBatch = 5,
+    };
+
+    using ReplayFn = std::function<void(uint64_t lsn, RecordType type,
+                                        const char* payload, size_t length)>;
+
+    WriteAheadLog(const std::string& dir, FsyncPolicy policy);
+
+    // Flushes (and, unless the policy is Never, fsyncs) pending records.
+    ~WriteAheadLog();
+
+    WriteAheadLog(const WriteAheadLog&) = delete;
+    WriteAheadLog& operator=(const WriteAheadLog&) = delete;
+
+    // Feed every record with an LSN above after_lsn to fn, oldest first,
+    // then open a fresh segment for appends. Replay stops at the first
+    // record that is torn or breaks the LSN sequence. A torn tail of the
+    // newest segment (a crash mid-write) is cut off with a warning; damage
+    // anywhere earlier moves the rest of the log aside as *.damaged rather
+    // than replaying past a hole. Must be called exactly once, before the
+    // first append. Returns the number of records replayed.
+    size_t replay(uint64_t after_lsn, const ReplayFn& fn);
+
+    // Queue a record and return its LSN. Only copies into a buffer, so the
+    // caller can hold its own lock to make LSN order match apply order.
+    uint64_t append(RecordType type, const std::string& payload);
+
+    // Block until the record numbered lsn is as durable as the policy
+    // promises. Throws std::runtime_error if the log can no longer write.
+    void commit(uint64_t lsn);
+
+    // Bytes appended since the last checkpoint().
+    size_t bytes_since_checkpoint() const;
+
+    // Called once a snapshot covers every record up to lsn: deletes closed
+    // segments holding nothing newer.
+    void checkpoint(uint64_t lsn);
+
+private:
+    struct Segment {
+        uint64_t first_lsn;
+        std::string path;
+    };
+
+    std::string dir_;
+    FsyncPolicy policy_;
+
+    mutable std::mutex mutex_;
+    std::condition_variable work_cv_;
+    std::condition_variable done_cv_;
+    std::string buffer_;
+    uint64_t last_lsn_ = 0;      // highest LSN handed out
+    uint64_t written_lsn_ = 0;   // highest LSN handed to write()
+    uint64_t synced_lsn_ = 0;    // highest LSN fsynced
+    size_t bytes_since_checkpoint_ = 0;
+    std::string error_;          // non-empty once a write has failed
+    bool stopping_ = false;
+
+    // Owned by the flusher thread once it is running, except closed
+    // segments, which checkpoint() prunes under mutex_.
+    std::vector<Segment> segments_;
+    int fd_ = -1;
+    size_t segment_bytes_ = 0;
+    std::thread flusher_;
+
+    void open_segment(uint64_t first_lsn);
+    void flusher_loop();
+    void write_all(const std::string& data);
+    void sync();
+};
@@ -7,6 +7,7 @@ set -euo pipefail
 
 PROJECT_DIR="$(cd "$(dirname "$0")" && pwd)"
 CPP_SERVER_BIN="$PROJECT_DIR/cpp_server/build/vectordb_server"
+CPP_DATA_DIR="$PROJECT_DIR/vectordb_data"
 CPP_SERVER_PID=""
 VENV_DIR="$PROJECT_DIR/venv"
 
@@ -139,7 +140,7 @@ if lsof -i :"$CPP_PORT" &>/dev/null || ss -tlnp 2>/dev/null | grep -q ":${CPP_PO
     echo -e "${GREEN}cpp_server already running on port $CPP_PORT.${RESET}"
 else
     echo -e "${YELLOW}Starting cpp_server on port $CPP_PORT...${RESET}"
-    "$CPP_SERVER_BIN" &
+    "$CPP_SERVER_BIN" --data-dir "$CPP_DATA_DIR" &
     CPP_SERVER_PID=$!
     sleep 1
 
@@ -8,9 +8,8 @@ import time
 
 import pdfplumber
 
-from client import CppClient
+from client import make_client
 from config import (
-    CPP_SERVER_PORT,
     DEFAULT_SOURCE_LANG,
     DEFAULT_TARGET_LANG,
     GROQ_MODEL_TRANSLATE,
@@ -56,11 +55,18 @@ _progress_start: float = 0.0
 
 
 def progress_callback(current: int, total: int, skipped: int):
-    """Real-time progress bar with ETA, printed on one line."""
+    """Real-time progress bar with ETA, printed on one line. A total of 0
+    (chunks still streaming in from the parser) shows just the count."""
     global _progress_start
     if current == 1:
         _progress_start = time.time()
 
+    status = f"[SKIP: {skipped}] " if skipped else ""
+    if total <= 0:
+        sys.stdout.write(f"\r   Progress: {current} chunks  {status}")
+        sys.stdout.flush()
+        return
+
     elapsed = time.time() - _progress_start
     if current > 0 and elapsed > 0:
         rate = current / elapsed
@@ -73,7 +79,6 @@ def progress_callback(current: int, total: int, skipped: int):
     filled = int(bar_width * current / total) if total > 0 else 0
     bar = "\u2588" * filled + "\u2591" * (bar_width - filled)
 
-    status = f"[SKIP: {skipped}] " if skipped else ""
     line = f"\r   Progress: {bar}  {current}/{total} chunks  {status}[ETA: {eta}]"
     sys.stdout.write(line)
     sys.stdout.flush()
@@ -170,9 +175,9 @@ def main():
     ensure_directories()
 
     # --- Server check ---
-    cpp_client = CppClient()
+    cpp_client = make_client()
     if cpp_client.is_alive():
-        print(ok(f"cpp_server connected (port: {CPP_SERVER_PORT})"))
+        print(ok(f"cpp_server connected ({cpp_client.address})"))
     else:
         print(warn("cpp_server not reachable \u2014 VectorDB features disabled"))
         print(f"   Start it with: ./cpp_server/build/vectordb_server")
@@ -254,6 +259,9 @@ def main():
                         break
                     print(f"   {err('Invalid choice.')}")
 
+    if cpp_client:
+        cpp_client.close()
+
     print("\nDone.")
 
 
@@ -1,4 +1,8 @@
 import hashlib
+from collections import deque
+from collections.abc import Iterable, Iterator
+from concurrent.futures import ProcessPoolExecutor
+from itertools import islice
 
 import pdfplumber
 from pathlib import Path
@@ -6,7 +10,7 @@ from pathlib import Path
 import nltk
 from nltk.tokenize import sent_tokenize
 
-from config import CHUNK_TOKEN_SIZE, CHUNK_OVERLAP_SENTENCES
+from config import CHUNK_TOKEN_SIZE, CHUNK_OVERLAP_SENTENCES, PARSE_WORKERS
 
 # Ensure NLTK sentence tokenizer data is available
 try:
@@ -53,6 +57,70 @@ def extract_text_from_pdf(pdf_path: Path) -> list[dict]:
     return pages
 
 
+# =============================================================================
+# Parallel PDF Extraction (streaming)
+# =============================================================================
+PAGES_PER_TASK = 8         # pages per process-pool task
+TASKS_PER_WORKER = 2       # ranges queued ahead per worker
+
+
+def _extract_page_range(pdf_path: str, first: int, last: int) -> list[dict]:
+    """Process-pool task: pages first..last (1-based, inclusive) with their
+    text already split into sentences, so the parent only chunks."""
+    pages = []
+    with pdfplumber.open(pdf_path) as pdf:
+        for i in range(first, last + 1):
+            text = pdf.pages[i - 1].extract_text() or ""
+            pages.append({"page": i, "text": text, "sentences": _page_sentences(text)})
+    return pages
+
+
+def iter_pdf_pages(pdf_path: Path, workers: int | None = None) -> Iterator[dict]:
+    """
+    Yield {"page": int, "text": str, "sentences": list[str]} dicts in page
+    order as pages are extracted, for split_into_chunks()/iter_chunks().
+
+    Page ranges of PAGES_PER_TASK go to a pool of `workers` processes
+    (default PARSE_WORKERS). Ranges finish in any order but are yielded in
+    page order, and only TASKS_PER_WORKER ranges per worker are queued
+    ahead, so a huge file never sits in memory all at once.
+    """
+    workers = PARSE_WORKERS if workers is None else workers
+    with pdfplumber.open(pdf_path) as pdf:
+        total_pages = len(pdf.pages)
+    workers = max(1, min(workers, -(-total_pages // PAGES_PER_TASK)))
+    print(f"\n   Extracting text from: {pdf_path.name} "
+          f"({total_pages} pages, {workers} workers)")
+
+    ranges = ((first, min(first + PAGES_PER_TASK - 1, total_pages))
+              for first in range(1, total_pages + 1, PAGES_PER_TASK))
+    empty_pages = []
+    for page in _extract_ranges(str(pdf_path), ranges, workers):
+        if len(page["text"].strip()) < 50:
+            empty_pages.append(page["page"])
+        yield page
+
+    if empty_pages:
+        print(f"\n   Empty pages: {empty_pages} (may be image-based or scanned)")
+
+
+def _extract_ranges(pdf_path: str, ranges: Iterator[tuple[int, int]],
+                    workers: int) -> Iterator[dict]:
+    if workers == 1:
+        for first, last in ranges:
+            yield from _extract_page_range(pdf_path, first, last)
+        return
+
+    with ProcessPoolExecutor(max_workers=workers) as pool:
+        queued = deque(pool.submit(_extract_page_range, pdf_path, first, last)
+                       for first, last in islice(ranges, workers * TASKS_PER_WORKER))
+        while queued:
+            pages = queued.popleft().result()
+            for first, last in islice(ranges, 1):
+                queued.append(pool.submit(_extract_page_range, pdf_path, first, last))
+            yield from pages
+
+
 def extract_text_from_txt(txt_path: Path) -> str:
     """Read text from a .txt file."""
     print(f"\n   Reading text from: {txt_path.name}")
@@ -75,6 +143,24 @@ def _generate_doc_id(filename: str) -> str:
     return "doc_" + hashlib.md5(filename.encode()).hexdigest()[:8]
 
 
+def _page_sentences(page_text: str) -> list[str]:
+    """Sentences of one page; none for empty/image pages (< 50 chars)."""
+    if len(page_text.strip()) < 50:
+        return []
+
+    # Paragraph-first splitting, then sentence detection
+    sentences = []
+    for para in page_text.split("\n\n"):
+        para = para.strip()
+        if not para:
+            continue
+        for sent in sent_tokenize(para):
+            sent = sent.strip()
+            if sent:
+                sentences.append(sent)
+    return sentences
+
+
 # =============================================================================
 # Smart Chunking (Sentence-Boundary Aware)
 # =============================================================================
@@ -98,92 +184,76 @@ def split_into_chunks(
     Returns:
         List of chunk metadata dicts per claude.md Section 4.
     """
-    # 1. Collect sentences tagged with page numbers
-    tagged_sentences = []
-    for page_info in pages:
-        page_num = page_info["page"]
-        page_text = page_info["text"]
-
-        # Skip empty/image pages (< 50 chars)
-        if len(page_text.strip()) < 50:
-            continue
-
-        # Paragraph-first splitting, then sentence detection
-        paragraphs = page_text.split("\n\n")
-        for para in paragraphs:
-            para = para.strip()
-            if not para:
-                continue
-            sentences = sent_tokenize(para)
-            for sent in sentences:
-                sent = sent.strip()
-                if sent:
-                    tagged_sentences.append((sent, page_num))
-
-    if not tagged_sentences:
+    chunks = list(iter_chunks(pages, filename))
+    if not chunks:
         print("   No text to chunk.")
         return []
 
-    # 2. Build chunks from sentences
+    # Backfill total_chunks
+    total = len(chunks)
+    for chunk in chunks:
+        chunk["total_chunks"] = total
+
+    print(f"   Split into {total} chunks (sentence-boundary aware)")
+    return chunks
+
+
+def iter_chunks(pages: Iterable[dict], filename: str = "") -> Iterator[dict]:
+    """
+    The chunks split_into_chunks() builds, yielded as soon as each one is
+    complete, so pages may still be arriving (see iter_pdf_pages). Their
+    total_chunks is 0: the count is only known at the end.
+
+    Pages that carry a "sentences" list (from iter_pdf_pages) are not
+    split again.
+    """
     doc_id = _generate_doc_id(filename)
-    chunks = []
+    chunk_index = 0
     current = []        # [(sentence, page_num), ...]
     current_tokens = 0
 
-    i = 0
-    while i < len(tagged_sentences):
-        sent_text, page_num = tagged_sentences[i]
-        sent_tokens = _estimate_tokens(sent_text)
-
-        # If adding this sentence would exceed the target and we have content
-        if current_tokens + sent_tokens > CHUNK_TOKEN_SIZE and current:
-            # Save current chunk
-            chunk_text = " ".join(s for s, _ in current)
-            page_nums = [p for _, p in current]
-            chunks.append({
-                "chunk_id": f"{doc_id}_chunk_{len(chunks):04d}",
-                "doc_id": doc_id,
-                "filename": filename,
-                "page_start": min(page_nums),
-                "page_end": max(page_nums),
-                "chunk_index": len(chunks),
-                "total_chunks": 0,  # Updated after all chunks created
-                "char_count": len(chunk_text),
-                "original_text": chunk_text,
-            })
-
-            # Carry overlap sentences to next chunk
-            overlap_count = min(CHUNK_OVERLAP_SENTENCES, len(current))
-            overlap = current[-overlap_count:]
-            current = list(overlap)
-            current_tokens = sum(_estimate_tokens(s) for s, _ in current)
-            continue  # Re-check sentence i with fresh chunk
-
-        # Add sentence to current chunk (also handles single huge sentences)
-        current.append((sent_text, page_num))
-        current_tokens += sent_tokens
-        i += 1
-
-    # 3. Final chunk
-    if current:
+    def make_chunk() -> dict:
         chunk_text = " ".join(s for s, _ in current)
         page_nums = [p for _, p in current]
-        chunks.append({
-            "chunk_id": f"{doc_id}_chunk_{len(chunks):04d}",
+        return {
+            "chunk_id": f"{doc_id}_chunk_{chunk_index:04d}",
             "doc_id": doc_id,
             "filename": filename,
             "page_start": min(page_nums),
             "page_end": max(page_nums),
-            "chunk_index": len(chunks),
+            "chunk_index": chunk_index,
             "total_chunks": 0,
             "char_count": len(chunk_text),
             "original_text": chunk_text,
-        })
+        }
 
-    # 4. Backfill total_chunks
-    total = len(chunks)
-    for chunk in chunks:
-        chunk["total_chunks"] = total
-
-    print(f"   Split into {total} chunks (sentence-boundary aware)")
-    return chunks
+    for page_info in pages:
+        page_num = page_info["page"]
+        sentences = page_info.get("sentences")
+        if sentences is None:
+            sentences = _page_sentences(page_info["text"])
+
+        for sent_text in sentences:
+            sent_tokens = _estimate_tokens(sent_text)
+
+            # If adding this sentence would exceed the target and we have
+            # content, emit the chunk and carry overlap sentences over
+            if current_tokens + sent_tokens > CHUNK_TOKEN_SIZE and current:
+                yield make_chunk()
+                chunk_index += 1
+                overlap_count = min(CHUNK_OVERLAP_SENTENCES, len(current))
+                current = current[-overlap_count:] if overlap_count > 0 else []
+                current_tokens = sum(_estimate_tokens(s) for s, _ in current)
+
+                # Overlap that leaves no room for the sentence is dropped
+                if current_tokens + sent_tokens > CHUNK_TOKEN_SIZE:
+                    current = []
+                    current_tokens = 0
+
+            # Add sentence to current chunk (also handles single huge sentences)
+            current.append((sent_text, page_num))
+            current_tokens += sent_tokens
+
+    # Final chunk
+    if current:
+        yield make_chunk()
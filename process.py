@@ -3,13 +3,29 @@ Pipeline integration — Flow 1: Parse → Store → Translate → Update Vector
 Milestone 5: Wire together all components with non-blocking error handling.
 """
 
+import hashlib
 import shutil
 import time
+from collections.abc import Iterable, Iterator
+from itertools import chain
 from pathlib import Path
 
+import config
 from client import CppClient
-from config import OUTPUT_DIR, PROCESSED_DIR
-from parse import extract_text_from_pdf, extract_text_from_txt, split_into_chunks
+from config import (
+    CPP_SERVER_INCREMENTAL,
+    CPP_SERVER_STREAM_STORE,
+    OUTPUT_DIR,
+    PARSE_WORKERS,
+    PROCESSED_DIR,
+)
+from parse import (
+    extract_text_from_pdf,
+    extract_text_from_txt,
+    iter_chunks,
+    iter_pdf_pages,
+    split_into_chunks,
+)
 from translate import translate_text
 
 
@@ -21,6 +37,7 @@ class FileStats:
         self.filename = filename
         self.chunks_total = 0
         self.chunks_translated = 0
+        self.chunks_reused = 0
         self.chunks_skipped = 0
         self.chunks_stored = 0
         self.chunks_store_failed = 0
@@ -37,6 +54,8 @@ class FileStats:
         if self.chunks_store_failed:
             print(f"      Store failures:      {self.chunks_store_failed}")
         print(f"      Translated:          {self.chunks_translated}")
+        if self.chunks_reused:
+            print(f"      Unchanged (reused):  {self.chunks_reused}")
         if self.chunks_skipped:
             print(f"      Skipped:             {self.chunks_skipped}")
         print(f"      Elapsed:             {self.elapsed:.1f}s")
@@ -45,30 +64,105 @@ class FileStats:
 # =============================================================================
 # VectorDB helpers (non-blocking)
 # =============================================================================
-def _store_chunks(client: CppClient | None, chunks: list[dict], stats: FileStats):
-    """Store original chunks in VectorDB. Failures are logged and skipped."""
+STORE_BATCH_SIZE = 64      # chunks per store_batch request
+STREAM_MAX_PENDING = 256   # records queued for the streaming store before translation waits
+DIFF_BATCH_SIZE = 256      # chunks per diff_chunks request
+
+
+def _content_hash(chunk: dict) -> str:
+    """Digest of what a chunk's translation depends on: its text and the
+    translation settings."""
+    digest = hashlib.blake2b(digest_size=16)
+    for part in (config.GROQ_MODEL_TRANSLATE, config.SOURCE_LANG, config.TARGET_LANG,
+                 chunk["original_text"]):
+        digest.update(part.encode("utf-8"))
+        digest.update(b"\0")
+    return digest.hexdigest()
+
+
+def _chunk_record(chunk: dict, translated: str | None = None) -> dict:
+    """Build the VectorDB store record for a chunk.
+
+    Only a translated chunk carries its content hash, so one stored
+    without a translation is translated again on the next run.
+    """
+    metadata = {
+        "filename": chunk["filename"],
+        "page_start": chunk["page_start"],
+        "page_end": chunk["page_end"],
+        "chunk_index": chunk["chunk_index"],
+        "total_chunks": chunk["total_chunks"],
+        "char_count": chunk["char_count"],
+    }
+    record = {
+        "chunk_id": chunk["chunk_id"],
+        "doc_id": chunk["doc_id"],
+        "text": chunk["original_text"],
+        "metadata": metadata,
+    }
+    if translated is not None:
+        metadata["translated_text"] = translated
+        record["content_hash"] = _content_hash(chunk)
+    return record
+
+
+def _store_records(client: CppClient, records: list[dict], label: str) -> tuple[int, int]:
+    """Store records in batches; returns (stored, failed).
+
+    A failed batch is retried chunk by chunk so one bad chunk only skips
+    itself, not its whole batch.
+    """
+    stored = failed = 0
+    for start in range(0, len(records), STORE_BATCH_SIZE):
+        batch = records[start:start + STORE_BATCH_SIZE]
+        try:
+            client.store_chunks(batch)
+            stored += len(batch)
+            continue
+        except Exception:
+            pass
+
+        for record in batch:
+            try:
+                client.store_chunk(
+                    chunk_id=record["chunk_id"],
+                    doc_id=record["doc_id"],
+                    text=record["text"],
+                    metadata=record["metadata"],
+                    content_hash=record.get("content_hash"),
+                )
+                stored += 1
+            except Exception as e:
+                failed += 1
+                print(f"   [WARN] Failed to {label} chunk {record['chunk_id']}: {e}")
+    return stored, failed
+
+
+def _clear_previous(client: CppClient, doc_id: str):
+    try:
+        client.delete_doc(doc_id)
+    except Exception as e:
+        print(f"   [WARN] Failed to clear previous chunks of {doc_id}: {e}")
+
+
+def _store_chunks(client: CppClient | None, chunks: list[dict], stats: FileStats,
+                  clear: bool = True):
+    """Store original chunks in VectorDB. Failures are logged and skipped.
+
+    Unless clear is False (_diff_previous() has already dealt with them),
+    chunks left over from an earlier run of the same document are removed
+    first, so a re-processed file that now splits into fewer chunks does
+    not keep answering from stale ones.
+    """
     if client is None:
         return
 
-    for chunk in chunks:
-        try:
-            client.store_chunk(
-                chunk_id=chunk["chunk_id"],
-                doc_id=chunk["doc_id"],
-                text=chunk["original_text"],
-                metadata={
-                    "filename": chunk["filename"],
-                    "page_start": chunk["page_start"],
-                    "page_end": chunk["page_end"],
-                    "chunk_index": chunk["chunk_index"],
-                    "total_chunks": chunk["total_chunks"],
-                    "char_count": chunk["char_count"],
-                },
-            )
-            stats.chunks_stored += 1
-        except Exception as e:
-            stats.chunks_store_failed += 1
-            print(f"   [WARN] Failed to store chunk {chunk['chunk_id']}: {e}")
+    if clear:
+        _clear_previous(client, chunks[0]["doc_id"])
+    records = [_chunk_record(chunk) for chunk in chunks]
+    stored, failed = _store_records(client, records, "store")
+    stats.chunks_stored += stored
+    stats.chunks_store_failed += failed
 
 
 def _update_translated(client: CppClient | None, results: list[tuple[dict, str]]):
@@ -76,24 +170,117 @@ def _update_translated(client: CppClient | None, results: list[tuple[dict, str]]
     if client is None:
         return
 
-    for chunk, translated in results:
+    records = [_chunk_record(chunk, translated) for chunk, translated in results]
+    _store_records(client, records, "update translated")
+
+
+def _translate_streaming(
+    client: CppClient, chunks: Iterable[dict], stats: FileStats, on_progress=None,
+    doc_id: str | None = None, clear: bool = True,
+) -> list[tuple[dict, str]]:
+    """Translate chunks while storing them: each one goes to the VectorDB
+    as soon as its translation finishes (or fails, then without one), so
+    the server works during translation instead of after it.
+
+    chunks may be a list or, with doc_id given, a stream still being
+    parsed. Batches the server rejected are retried chunk by chunk at the
+    end; a chunk translation never reached is stored untranslated. clear
+    is as for _store_chunks().
+    """
+    if clear:
+        _clear_previous(client, doc_id or chunks[0]["doc_id"])
+    pending: dict[str, dict] = {}
+    if isinstance(chunks, list):
+        pending.update((chunk["chunk_id"], chunk) for chunk in chunks)
+    else:
+        chunks = _tracked(chunks, pending)
+    pipeline = client.store_pipeline(batch_size=STORE_BATCH_SIZE,
+                                     max_pending=STREAM_MAX_PENDING)
+
+    def on_chunk(chunk: dict, translated: str | None):
+        pending.pop(chunk["chunk_id"], None)
+        pipeline.put(_chunk_record(chunk, translated))
+
+    try:
+        return translate_text(chunks, on_progress=on_progress, on_chunk=on_chunk)
+    finally:
+        for chunk in pending.values():
+            pipeline.put(_chunk_record(chunk))
+        stored, failed = pipeline.close()
+        retried, still_failed = _store_records(client, failed, "store")
+        stats.chunks_stored += stored + retried
+        stats.chunks_store_failed += still_failed
+
+
+def _tracked(chunks: Iterable[dict], seen: dict[str, dict]) -> Iterator[dict]:
+    for chunk in chunks:
+        seen[chunk["chunk_id"]] = chunk
+        yield chunk
+
+
+# =============================================================================
+# Incremental re-processing
+# =============================================================================
+def _has_previous(client: CppClient, doc_id: str) -> bool:
+    """Whether the VectorDB holds chunks of doc_id; False if it cannot say
+    (e.g. a server without diff_chunks)."""
+    try:
+        return bool(client.diff_chunks(doc_id, [])["stale"])
+    except Exception:
+        return False
+
+
+def _diff_previous(
+    client: CppClient, chunks: list[dict], stats: FileStats,
+) -> tuple[list[dict], dict[str, str]] | None:
+    """Compare chunks with what an earlier run of their document stored.
+
+    Returns the chunks that need translating and, by chunk_id, the stored
+    translations of the others. Stored chunks the document no longer has
+    are deleted; unchanged ones whose metadata moved (pages, chunk count)
+    are re-stored with their translation, which costs no API call. None if
+    the server could not compare; then the whole document is redone.
+    """
+    doc_id = chunks[0]["doc_id"]
+    reused: dict[str, str] = {}
+    stored_metadata: dict[str, dict] = {}
+    stale: set[str] | None = None
+    try:
+        for start in range(0, len(chunks), DIFF_BATCH_SIZE):
+            batch = chunks[start:start + DIFF_BATCH_SIZE]
+            diff = client.diff_chunks(doc_id, [(c["chunk_id"], _content_hash(c)) for c in batch],
+                                      fields=["metadata"])
+            for entry in diff["unchanged"]:
+                metadata = entry.get("metadata") or {}
+                if "translated_text" in metadata:
+                    reused[entry["chunk_id"]] = metadata["translated_text"]
+                    stored_metadata[entry["chunk_id"]] = metadata
+            # Each batch's stale list holds every stored chunk it did not
+            # name; those no batch named are in all of them.
+            batch_stale = set(diff["stale"])
+            stale = batch_stale if stale is None else stale & batch_stale
+    except Exception as e:
+        print(f"   [WARN] Failed to compare with previous chunks of {doc_id}: {e}")
+        return None
+
+    for chunk_id in sorted(stale or ()):
         try:
-            client.store_chunk(
-                chunk_id=chunk["chunk_id"],
-                doc_id=chunk["doc_id"],
-                text=chunk["original_text"],
-                metadata={
-                    "filename": chunk["filename"],
-                    "page_start": chunk["page_start"],
-                    "page_end": chunk["page_end"],
-                    "chunk_index": chunk["chunk_index"],
-                    "total_chunks": chunk["total_chunks"],
-                    "char_count": chunk["char_count"],
-                    "translated_text": translated,
-                },
-            )
+            client.delete_chunk(chunk_id)
         except Exception as e:
-            print(f"   [WARN] Failed to update translated chunk {chunk['chunk_id']}: {e}")
+            print(f"   [WARN] Failed to delete stale chunk {chunk_id}: {e}")
+
+    moved = []
+    for chunk in chunks:
+        translated = reused.get(chunk["chunk_id"])
+        if translated is not None:
+            record = _chunk_record(chunk, translated)
+            if record["metadata"] != stored_metadata[chunk["chunk_id"]]:
+                moved.append(record)
+    stored, failed = _store_records(client, moved, "update")
+    stats.chunks_stored += stored
+    stats.chunks_store_failed += failed
+
+    return [c for c in chunks if c["chunk_id"] not in reused], reused
 
 
 # =============================================================================
@@ -106,7 +293,11 @@ def _run_pipeline(
     client: CppClient | None,
     on_progress=None,
 ) -> bool:
-    """Shared pipeline: chunk → store → translate → update → save → move."""
+    """Shared pipeline: chunk → store → translate → update → save → move.
+
+    With CPP_SERVER_STREAM_STORE the store and update steps become one,
+    running alongside translation.
+    """
     stats = FileStats(filename)
 
     # Check for empty content
@@ -121,22 +312,97 @@ def _run_pipeline(
         print(f"   No chunks created from {filename}. Skipping.")
         return False
     stats.chunks_total = len(chunks)
+    return _translate_and_save(chunks, stats, file_path, client, on_progress)
 
-    # 2. Store originals in VectorDB
-    _store_chunks(client, chunks, stats)
 
-    # 3. Translate
-    results = translate_text(chunks, on_progress=on_progress)
+def _run_pipeline_streaming(
+    chunks: Iterator[dict],
+    filename: str,
+    file_path: Path,
+    client: CppClient | None,
+    on_progress=None,
+) -> bool:
+    """_run_pipeline() over chunks still being parsed: translation starts
+    with the first one. Their total_chunks metadata stays 0."""
+    stats = FileStats(filename)
+    first = next(chunks, None)
+    if first is None:
+        print(f"   No chunks created from {filename}. Skipping.")
+        return False
+
+    def counted() -> Iterator[dict]:
+        for chunk in chain([first], chunks):
+            stats.chunks_total += 1
+            yield chunk
+
+    return _translate_and_save(counted(), stats, file_path, client, on_progress,
+                               doc_id=first["doc_id"])
+
+
+def _translate_and_save(
+    chunks: Iterable[dict],
+    stats: FileStats,
+    file_path: Path,
+    client: CppClient | None,
+    on_progress=None,
+    doc_id: str | None = None,
+) -> bool:
+    """Steps 2-5 of the pipeline plus the move; see _run_pipeline().
+
+    With CPP_SERVER_INCREMENTAL, a document the VectorDB already holds is
+    first compared with it (see _diff_previous()): only chunks that changed
+    go through steps 2-4, and the output reuses the stored translations of
+    the rest.
+    """
+    filename = stats.filename
+    reused: dict[str, str] = {}
+    incremental = None
+    if (client is not None and CPP_SERVER_INCREMENTAL
+            and _has_previous(client, doc_id or chunks[0]["doc_id"])):
+        # The comparison needs every chunk, so a stream is parsed to the
+        # end first
+        chunks = list(chunks)
+        incremental = _diff_previous(client, chunks, stats)
+    all_chunks = chunks
+    if incremental is not None:
+        chunks, reused = incremental
+        stats.chunks_reused = len(reused)
+        print(f"   {len(reused)} of {len(all_chunks)} chunks unchanged since the last run")
+
+    streaming = client is not None and CPP_SERVER_STREAM_STORE
+    if streaming:
+        # 2-4. Translate, storing each chunk with its translation
+        results = _translate_streaming(client, chunks, stats, on_progress, doc_id=doc_id,
+                                       clear=incremental is None)
+    else:
+        # 2. Store originals in VectorDB (all of them, so a stream is
+        # parsed to the end first)
+        if client is not None and not isinstance(chunks, list):
+            chunks = list(chunks)
+        if incremental is None:
+            _store_chunks(client, chunks, stats)
+        elif chunks:
+            _store_chunks(client, chunks, stats, clear=False)
+
+        # 3. Translate
+        results = translate_text(chunks, on_progress=on_progress)
     stats.chunks_translated = len(results)
-    stats.chunks_skipped = stats.chunks_total - len(results)
+    stats.chunks_skipped = stats.chunks_total - len(results) - len(reused)
 
-    if not results:
+    if not results and not reused:
         print(f"   No chunks translated for {filename}. Skipping save.")
         stats.print_summary()
         return False
 
     # 4. Update VectorDB with translated text
-    _update_translated(client, results)
+    if not streaming:
+        _update_translated(client, results)
+
+    if reused:
+        translations = dict(reused)
+        translations.update((chunk["chunk_id"], text) for chunk, text in results)
+        results = [(chunk, translations[chunk["chunk_id"]]) for chunk in all_chunks
+                   if chunk["chunk_id"] in translations]
 
     # 5. Save output file
     translated_text = "\n\n".join(text for _, text in results)
@@ -166,8 +432,17 @@ def process_pdf(
     client: CppClient | None = None,
     on_progress=None,
 ) -> bool:
-    """Process a single PDF: extract → chunk → store → translate → update → save."""
+    """Process a single PDF: extract → chunk → store → translate → update → save.
+
+    With PARSE_WORKERS above 1, pages are extracted in parallel and chunks
+    go to translation as they are produced.
+    """
     try:
+        if PARSE_WORKERS > 1:
+            pages = iter_pdf_pages(pdf_path, PARSE_WORKERS)
+            chunks = iter_chunks(pages, filename=pdf_path.name)
+            return _run_pipeline_streaming(chunks, pdf_path.name, pdf_path, client,
+                                           on_progress)
         pages = extract_text_from_pdf(pdf_path)
         return _run_pipeline(pages, pdf_path.name, pdf_path, client, on_progress)
     except Exception as e:
@@ -8,6 +8,15 @@ from groq import Groq, RateLimitError, APIError
 import config
 from client import CppClient
 
+# Only what the prompt and page citations use; the rest of each chunk's
+# metadata stays on the server.
+SEARCH_FIELDS = [
+    "text",
+    "metadata.translated_text",
+    "metadata.page_start",
+    "metadata.page_end",
+]
+
 # Reuse the lazy Groq client from translate.py
 _client: Groq | None = None
 
@@ -44,7 +53,9 @@ def ask_question(
     """
     # 1. Search VectorDB for relevant chunks
     print("   Searching relevant chunks...")
-    results = client.search(query=query, top_k=top_k, doc_id=doc_id)
+    results = client.search(
+        query=query, top_k=top_k, doc_id=doc_id, fields=SEARCH_FIELDS
+    )
 
     if not results:
         return "No relevant content found. Please rephrase your question.", []
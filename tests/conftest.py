@@ -105,11 +105,28 @@ def mock_groq_client(mock_groq_response):
 # CppClient mock
 # =============================================================================
 
+class FakeStorePipeline:
+    """Stands in for client.StorePipeline, keeping every record put."""
+
+    def __init__(self):
+        self.records = []
+        self.failed = []
+
+    def put(self, record):
+        self.records.append(record)
+
+    def close(self):
+        return len(self.records) - len(self.failed), self.failed
+
+
 @pytest.fixture
 def mock_cpp_client():
     """MagicMock replacing CppClient with store/search methods."""
     client = MagicMock()
     client.store_chunk.return_value = {"status": "ok"}
+    client.store_chunks.side_effect = lambda chunks: len(chunks)
+    client.store_pipeline.return_value = FakeStorePipeline()
+    client.diff_chunks.return_value = {"changed": [], "unchanged": [], "stale": []}
     client.search.return_value = [
         {
             "chunk_id": "doc_abc12345_chunk_0000",
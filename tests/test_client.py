@@ -1,12 +1,15 @@
 """Tests for client.py — CppClient socket communication."""
 
 import json
+import socket
 import struct
+import threading
 from unittest.mock import MagicMock, patch
 
 import pytest
 
-from client import CppClient
+import client as client_module
+from client import CppClient, ShardedClient, make_client
 
 
 def make_mock_socket(response_dict):
@@ -93,6 +96,48 @@ class TestStoreChunk:
             client.store_chunk("c1", "d1", "hello")
         req = mock_send.call_args.args[0]
         assert req["metadata"] == {}  # Default empty dict
+        assert "content_hash" not in req
+
+    def test_content_hash(self):
+        client = CppClient()
+        with patch.object(client, "_send_request", return_value={"status": "ok"}) as mock_send:
+            client.store_chunk("c1", "d1", "hello", content_hash="abc")
+        assert mock_send.call_args.args[0]["content_hash"] == "abc"
+
+
+# =============================================================================
+# store_chunks
+# =============================================================================
+
+class TestStoreChunks:
+    def test_batch_payload(self):
+        client = CppClient()
+        chunks = [
+            {"chunk_id": "c1", "doc_id": "d1", "text": "one", "metadata": {"k": 1}},
+            {"chunk_id": "c2", "doc_id": "d1", "text": "two"},
+        ]
+        with patch.object(client, "_send_request",
+                          return_value={"status": "ok", "stored": 2}) as mock_send:
+            stored = client.store_chunks(chunks)
+        assert stored == 2
+        req = mock_send.call_args.args[0]
+        assert req["action"] == "store_batch"
+        assert [c["chunk_id"] for c in req["chunks"]] == ["c1", "c2"]
+        assert req["chunks"][0]["metadata"] == {"k": 1}
+        assert req["chunks"][1]["metadata"] == {}
+
+    def test_content_hash_passed_through(self):
+        client = CppClient()
+        chunks = [
+            {"chunk_id": "c1", "doc_id": "d1", "text": "one", "content_hash": "h1"},
+            {"chunk_id": "c2", "doc_id": "d1", "text": "two"},
+        ]
+        with patch.object(client, "_send_request",
+                          return_value={"status": "ok", "stored": 2}) as mock_send:
+            client.store_chunks(chunks)
+        sent = mock_send.call_args.args[0]["chunks"]
+        assert sent[0]["content_hash"] == "h1"
+        assert "content_hash" not in sent[1]
 
 
 # =============================================================================
@@ -125,6 +170,139 @@ class TestSearch:
         req = mock_send.call_args.args[0]
         assert "doc_id" not in req
 
+    def test_with_fields(self):
+        client = CppClient()
+        with patch.object(client, "_send_request", return_value={"results": []}) as mock_send:
+            client.search("query", fields=["text", "metadata.page_start"])
+        req = mock_send.call_args.args[0]
+        assert req["fields"] == ["text", "metadata.page_start"]
+
+    def test_without_fields(self):
+        client = CppClient()
+        with patch.object(client, "_send_request", return_value={"results": []}) as mock_send:
+            client.search("query")
+        req = mock_send.call_args.args[0]
+        assert "fields" not in req
+
+    def test_approximate(self):
+        client = CppClient()
+        with patch.object(client, "_send_request", return_value={"results": []}) as mock_send:
+            client.search("query", approximate=True, ef_search=128)
+        req = mock_send.call_args.args[0]
+        assert req["mode"] == "approx"
+        assert req["ef_search"] == 128
+
+    def test_exact_by_default(self):
+        client = CppClient()
+        with patch.object(client, "_send_request", return_value={"results": []}) as mock_send:
+            client.search("query", ef_search=128)
+        req = mock_send.call_args.args[0]
+        assert "mode" not in req
+        assert "ef_search" not in req
+
+
+class TestSearchBatch:
+    def test_success(self):
+        client = CppClient()
+        response = {
+            "status": "ok",
+            "results": [[{"chunk_id": "c1", "score": 0.9}], []],
+        }
+        with patch.object(client, "_send_request", return_value=response) as mock_send:
+            results = client.search_batch(["first", "second"], top_k=3, doc_id="d1")
+        assert results == [[{"chunk_id": "c1", "score": 0.9}], []]
+        assert mock_send.call_args.args[0] == {
+            "action": "search_batch",
+            "queries": ["first", "second"],
+            "top_k": 3,
+            "doc_id": "d1",
+        }
+
+    def test_with_fields(self):
+        client = CppClient()
+        with patch.object(client, "_send_request", return_value={"results": []}) as mock_send:
+            client.search_batch(["q"], fields=["text"])
+        req = mock_send.call_args.args[0]
+        assert req["fields"] == ["text"]
+        assert "doc_id" not in req
+
+
+# =============================================================================
+# delete_doc / delete_chunk
+# =============================================================================
+
+class TestDelete:
+    def test_delete_doc(self):
+        client = CppClient()
+        with patch.object(client, "_send_request",
+                          return_value={"status": "ok", "deleted": 3}) as mock_send:
+            deleted = client.delete_doc("d1")
+        assert deleted == 3
+        assert mock_send.call_args.args[0] == {"action": "delete_doc", "doc_id": "d1"}
+
+    def test_delete_chunk(self):
+        client = CppClient()
+        with patch.object(client, "_send_request",
+                          return_value={"status": "ok", "deleted": 1}) as mock_send:
+            assert client.delete_chunk("c1") is True
+        assert mock_send.call_args.args[0] == {"action": "delete_chunk", "chunk_id": "c1"}
+
+    def test_delete_missing_chunk(self):
+        client = CppClient()
+        with patch.object(client, "_send_request",
+                          return_value={"status": "ok", "deleted": 0}):
+            assert client.delete_chunk("nope") is False
+
+
+# =============================================================================
+# diff_chunks
+# =============================================================================
+
+class TestDiffChunks:
+    def test_payload(self):
+        client = CppClient()
+        response = {
+            "status": "ok",
+            "changed": ["c2"],
+            "unchanged": [{"chunk_id": "c1", "metadata": {"translated_text": "Hola"}}],
+            "stale": ["c3"],
+        }
+        with patch.object(client, "_send_request", return_value=response) as mock_send:
+            diff = client.diff_chunks("d1", [("c1", "h1"), ("c2", "h2")], fields=["metadata"])
+        assert mock_send.call_args.args[0] == {
+            "action": "diff_chunks",
+            "doc_id": "d1",
+            "chunks": [{"chunk_id": "c1", "content_hash": "h1"},
+                       {"chunk_id": "c2", "content_hash": "h2"}],
+            "fields": ["metadata"],
+        }
+        assert diff == {
+            "changed": ["c2"],
+            "unchanged": [{"chunk_id": "c1", "metadata": {"translated_text": "Hola"}}],
+            "stale": ["c3"],
+        }
+
+    def test_defaults(self):
+        client = CppClient()
+        with patch.object(client, "_send_request", return_value={"status": "ok"}) as mock_send:
+            diff = client.diff_chunks("d1", [])
+        assert "fields" not in mock_send.call_args.args[0]
+        assert diff == {"changed": [], "unchanged": [], "stale": []}
+
+
+# =============================================================================
+# Stats
+# =============================================================================
+
+class TestStats:
+    def test_stats(self):
+        client = CppClient()
+        reply = {"status": "ok", "store": {"entries": 4}, "actions": {}}
+        with patch.object(client, "_send_request", return_value=reply) as mock_send:
+            stats = client.stats()
+        assert stats == {"store": {"entries": 4}, "actions": {}}
+        assert mock_send.call_args.args[0] == {"action": "stats"}
+
 
 # =============================================================================
 # Error paths
@@ -156,6 +334,451 @@ class TestErrors:
                 client._send_request({"action": "test"})
 
 
+# =============================================================================
+# Connection pooling
+# =============================================================================
+
+def framed(response_dict):
+    payload = json.dumps(response_dict).encode("utf-8")
+    return [struct.pack("!I", len(payload)), payload]
+
+
+class TestConnectionPool:
+    def test_reuses_socket_across_requests(self):
+        with patch("socket.socket") as mock_sock_cls:
+            mock_sock = MagicMock()
+            mock_sock_cls.return_value = mock_sock
+            mock_sock.recv.side_effect = framed({"status": "ok"}) * 2
+
+            client = CppClient(pool_size=2)
+            client._send_request({"action": "store"})
+            client._send_request({"action": "store"})
+
+        assert mock_sock_cls.call_count == 1
+        mock_sock.connect.assert_called_once()
+        assert mock_sock.sendall.call_count == 2
+        mock_sock.close.assert_not_called()
+
+    def test_pool_size_zero_closes_each_connection(self):
+        with patch("socket.socket") as mock_sock_cls:
+            mock_sock = MagicMock()
+            mock_sock_cls.return_value = mock_sock
+            mock_sock.recv.side_effect = framed({"status": "ok"}) * 2
+
+            client = CppClient(pool_size=0)
+            client._send_request({"action": "store"})
+            client._send_request({"action": "store"})
+
+        assert mock_sock_cls.call_count == 2
+        assert mock_sock.close.call_count == 2
+
+    def test_retries_stale_pooled_socket(self):
+        stale = MagicMock()
+        stale.recv.return_value = b""  # server closed the idle connection
+        fresh = MagicMock()
+        fresh.recv.side_effect = framed({"status": "ok"})
+
+        client = CppClient(pool_size=2)
+        client._pool.append(stale)
+        with patch("socket.socket", return_value=fresh):
+            result = client._send_request({"action": "search"})
+
+        assert result == {"status": "ok"}
+        stale.close.assert_called_once()
+        assert client._pool == [fresh]
+
+    def test_error_response_keeps_socket(self):
+        with patch("socket.socket") as mock_sock_cls:
+            mock_sock = MagicMock()
+            mock_sock_cls.return_value = mock_sock
+            mock_sock.recv.side_effect = framed({"status": "error", "message": "bad"})
+
+            client = CppClient(pool_size=2)
+            with pytest.raises(RuntimeError):
+                client._send_request({"action": "test"})
+
+        assert client._pool == [mock_sock]
+
+    def test_close_drains_pool(self):
+        client = CppClient(pool_size=2)
+        socks = [MagicMock(), MagicMock()]
+        client._pool.extend(socks)
+        client.close()
+        assert client._pool == []
+        for sock in socks:
+            sock.close.assert_called_once()
+
+
+# =============================================================================
+# StorePipeline
+# =============================================================================
+
+class PipelinedSocket:
+    """Fake socket answering each framed JSON request as the server does:
+    in order, echoing the request id. Requests whose id is in fail_ids are
+    answered with an error, as the server does when a request throws."""
+
+    def __init__(self, status="ok", fail_ids=()):
+        self.status = status
+        self.fail_ids = set(fail_ids)
+        self.requests = []
+        self.closed = False
+        self._out = bytearray()
+
+    def settimeout(self, timeout):
+        pass
+
+    def connect(self, address):
+        pass
+
+    def sendall(self, data):
+        request = json.loads(data[4:])
+        self.requests.append(request)
+        status = "error" if request["id"] in self.fail_ids else self.status
+        response = {"status": status, "id": request["id"]}
+        if status == "ok":
+            response["stored"] = len(request["chunks"])
+        self._out.extend(b"".join(framed(response)))
+
+    def recv(self, n):
+        data = bytes(self._out[:n])
+        del self._out[:n]
+        return data
+
+    def close(self):
+        self.closed = True
+
+
+def records(n):
+    return [{"chunk_id": f"c{i}", "doc_id": "d1", "text": "t", "metadata": {}}
+            for i in range(n)]
+
+
+class TestStorePipeline:
+    def test_streams_batches(self):
+        sock = PipelinedSocket()
+        client = CppClient(encoding="json")
+        with patch("socket.socket", return_value=sock):
+            pipeline = client.store_pipeline(batch_size=2, window=2)
+            for record in records(5):
+                pipeline.put(record)
+            stored, failed = pipeline.close()
+
+        assert (stored, failed) == (5, [])
+        assert all(r["action"] == "store_batch" for r in sock.requests)
+        assert [r["id"] for r in sock.requests] == list(range(len(sock.requests)))
+        sent = [c["chunk_id"] for r in sock.requests for c in r["chunks"]]
+        assert sent == [f"c{i}" for i in range(5)]
+        assert max(len(r["chunks"]) for r in sock.requests) <= 2
+        assert sock.closed
+
+    def test_rejected_batches_are_returned(self):
+        sock = PipelinedSocket(status="error")
+        client = CppClient(encoding="json")
+        with patch("socket.socket", return_value=sock):
+            with client.store_pipeline() as pipeline:
+                for record in records(3):
+                    pipeline.put(record)
+
+        assert pipeline.stored == 0
+        assert [r["chunk_id"] for r in pipeline.failed] == ["c0", "c1", "c2"]
+
+    def test_failed_batch_in_window_is_returned_alone(self):
+        sock = PipelinedSocket(fail_ids={1})
+        client = CppClient(encoding="json")
+        with patch("socket.socket", return_value=sock) as make_socket:
+            pipeline = client.store_pipeline(batch_size=2, window=4)
+            for record in records(6):
+                pipeline.put(record)
+            stored, failed = pipeline.close()
+
+        # All batches were in flight together; only the rejected one fails
+        # and the connection survives it.
+        failed_ids = {r["chunk_id"] for r in failed}
+        bad = {c["chunk_id"] for r in sock.requests if r["id"] == 1 for c in r["chunks"]}
+        assert bad and failed_ids == bad
+        assert stored == 6 - len(bad)
+        assert make_socket.call_count == 1
+
+    def test_connection_failure_returns_unacknowledged(self):
+        sock = PipelinedSocket()
+        sock.recv = lambda n: b""  # server went away
+        client = CppClient(encoding="json")
+        with patch("socket.socket", return_value=sock):
+            pipeline = client.store_pipeline(window=1)
+            for record in records(2):
+                pipeline.put(record)
+            stored, failed = pipeline.close()
+
+        assert stored == 0
+        assert sorted(r["chunk_id"] for r in failed) == ["c0", "c1"]
+
+    def test_sender_failure_returns_everything(self):
+        sock = PipelinedSocket()
+        client = CppClient(encoding="json")
+        real_write = client._write_frame
+        calls = []
+
+        def write_frame(sock, request):
+            calls.append(request["id"])
+            if len(calls) > 1:
+                raise RuntimeError("encoder bug")
+            real_write(sock, request)
+
+        client._write_frame = write_frame
+        with patch("socket.socket", return_value=sock):
+            pipeline = client.store_pipeline(batch_size=1, max_pending=1, window=4)
+            accepted = []
+
+            def produce():
+                for record in records(6):
+                    try:
+                        pipeline.put(record)
+                    except RuntimeError:
+                        return
+                    accepted.append(record["chunk_id"])
+
+            put = threading.Thread(target=produce)
+            put.start()
+            put.join(timeout=5)
+            assert not put.is_alive()
+            closer = threading.Thread(target=pipeline.close)
+            closer.start()
+            closer.join(timeout=5)
+            assert not closer.is_alive()
+
+        assert isinstance(pipeline.error, RuntimeError)
+        returned = sorted(r["chunk_id"] for r in pipeline.failed)
+        # c0 was sent but never answered, c1 never sent, the rest queued.
+        assert pipeline.stored == 0
+        assert returned == sorted(accepted)
+        assert {"c0", "c1"} <= set(returned)
+        assert sock.closed
+        with pytest.raises(RuntimeError):
+            pipeline.put(records(1)[0])
+
+    def test_put_after_close(self):
+        client = CppClient(encoding="json")
+        pipeline = client.store_pipeline()
+        assert pipeline.close() == (0, [])
+        with pytest.raises(RuntimeError):
+            pipeline.put(records(1)[0])
+
+
+# =============================================================================
+# ShardedClient
+# =============================================================================
+
+def mock_shards(n):
+    shards = []
+    for i in range(n):
+        shard = MagicMock(spec=CppClient)
+        shard.address = f"host{i}:5005{i}"
+        shards.append(shard)
+    return shards
+
+
+def doc_on(client, index):
+    """A doc_id the client places on shard `index`."""
+    return next(f"doc{i}" for i in range(1000) if client.shard_index(f"doc{i}") == index)
+
+
+class TestShardedClient:
+    def test_from_spec(self):
+        client = ShardedClient.from_spec("a:1, b:2,unix:/tmp/s.sock")
+        assert [s.address for s in client.shards] == ["a:1", "b:2", "unix:/tmp/s.sock"]
+
+    def test_from_spec_rejects_bad_address(self):
+        with pytest.raises(ValueError):
+            ShardedClient.from_spec("a:1,nohost")
+
+    def test_make_client(self):
+        with patch("config.CPP_SERVER_SHARDS", "a:1,b:2"):
+            assert isinstance(make_client(), ShardedClient)
+        with patch("config.CPP_SERVER_SHARDS", ""):
+            assert isinstance(make_client(), CppClient)
+
+    def test_routing_is_stable(self):
+        client = ShardedClient(mock_shards(3))
+        index = client.shard_index("doc_abc12345")
+        assert index == ShardedClient(mock_shards(3)).shard_index("doc_abc12345")
+        assert {client.shard_index(f"doc{i}") for i in range(100)} == {0, 1, 2}
+
+    def test_filtered_search_hits_one_shard(self):
+        shards = mock_shards(3)
+        client = ShardedClient(shards)
+        doc = doc_on(client, 1)
+        shards[1].search.return_value = [{"chunk_id": "c1", "score": 0.5}]
+        assert client.search("q", doc_id=doc) == [{"chunk_id": "c1", "score": 0.5}]
+        shards[0].search.assert_not_called()
+        shards[2].search.assert_not_called()
+
+    def test_unfiltered_search_merges_top_k(self):
+        shards = mock_shards(2)
+        shards[0].search.return_value = [{"chunk_id": "a", "score": 0.9},
+                                         {"chunk_id": "b", "score": 0.4}]
+        shards[1].search.return_value = [{"chunk_id": "c", "score": 0.7},
+                                         {"chunk_id": "d", "score": 0.6}]
+        results = ShardedClient(shards).search("q", top_k=3)
+        assert [r["chunk_id"] for r in results] == ["a", "c", "d"]
+
+    def test_merge_requests_score_and_drops_it(self):
+        shards = mock_shards(2)
+        for i, shard in enumerate(shards):
+            shard.search.return_value = [{"chunk_id": f"c{i}", "score": i}]
+        results = ShardedClient(shards).search("q", top_k=1, fields=["chunk_id"])
+        assert results == [{"chunk_id": "c1"}]
+        assert shards[0].search.call_args.args[3] == ["chunk_id", "score"]
+
+    def test_search_batch_merges_per_query(self):
+        shards = mock_shards(2)
+        shards[0].search_batch.return_value = [[{"chunk_id": "a", "score": 0.1}], []]
+        shards[1].search_batch.return_value = [[{"chunk_id": "b", "score": 0.2}],
+                                               [{"chunk_id": "c", "score": 0.3}]]
+        results = ShardedClient(shards).search_batch(["q1", "q2"], top_k=2)
+        assert [[r["chunk_id"] for r in hits] for hits in results] == [["b", "a"], ["c"]]
+
+    def test_store_chunks_groups_by_shard(self):
+        shards = mock_shards(2)
+        for shard in shards:
+            shard.store_chunks.side_effect = len
+        client = ShardedClient(shards)
+        chunks = [{"chunk_id": f"c{i}", "doc_id": doc_on(client, i % 2), "text": "t"}
+                  for i in range(5)]
+        assert client.store_chunks(chunks) == 5
+        assert len(shards[0].store_chunks.call_args.args[0]) == 3
+        assert len(shards[1].store_chunks.call_args.args[0]) == 2
+
+    def test_delete(self):
+        shards = mock_shards(2)
+        shards[0].delete_chunk.return_value = False
+        shards[1].delete_chunk.return_value = True
+        client = ShardedClient(shards)
+        assert client.delete_chunk("c1") is True
+        doc = doc_on(client, 0)
+        client.delete_doc(doc)
+        shards[0].delete_doc.assert_called_once_with(doc)
+        shards[1].delete_doc.assert_not_called()
+
+    def test_diff_chunks_hits_doc_shard(self):
+        shards = mock_shards(2)
+        client = ShardedClient(shards)
+        doc = doc_on(client, 1)
+        client.diff_chunks(doc, [("c1", "h1")])
+        shards[1].diff_chunks.assert_called_once_with(doc, [("c1", "h1")], None)
+        shards[0].diff_chunks.assert_not_called()
+
+    def test_pipeline_routes_records(self):
+        shards = mock_shards(2)
+        pipelines = [MagicMock(), MagicMock()]
+        for shard, pipeline, failed in zip(shards, pipelines, ([], [{"chunk_id": "x"}])):
+            shard.store_pipeline.return_value = pipeline
+            pipeline.close.return_value = (1, failed)
+        client = ShardedClient(shards)
+        with client.store_pipeline() as pipeline:
+            pipeline.put({"chunk_id": "a", "doc_id": doc_on(client, 0)})
+            pipeline.put({"chunk_id": "b", "doc_id": doc_on(client, 1)})
+        assert pipeline.close() == (2, [{"chunk_id": "x"}])
+        assert pipelines[0].put.call_args.args[0]["chunk_id"] == "a"
+        assert pipelines[1].put.call_args.args[0]["chunk_id"] == "b"
+
+
+# =============================================================================
+# Payload encoding
+# =============================================================================
+
+def sent_payload(mock_sock):
+    data = mock_sock.sendall.call_args[0][0]
+    (length,) = struct.unpack("!I", data[:4])
+    assert length == len(data) - 4
+    return data[4:]
+
+
+class TestEncoding:
+    def test_json_request_payload(self):
+        with patch("socket.socket") as mock_sock_cls:
+            mock_sock = MagicMock()
+            mock_sock_cls.return_value = mock_sock
+            mock_sock.recv.side_effect = framed({"status": "ok"})
+
+            client = CppClient(encoding="json")
+            client._send_request({"action": "search", "query": "q"})
+
+        assert json.loads(sent_payload(mock_sock)) == {"action": "search", "query": "q"}
+
+    def test_msgpack_request_payload(self):
+        msgpack = pytest.importorskip("msgpack")
+        with patch("socket.socket") as mock_sock_cls:
+            mock_sock = MagicMock()
+            mock_sock_cls.return_value = mock_sock
+            response = msgpack.packb({"status": "ok", "results": []}, use_bin_type=True)
+            mock_sock.recv.side_effect = [struct.pack("!I", len(response)), response]
+
+            client = CppClient(encoding="msgpack")
+            result = client._send_request({"action": "search", "query": "q"})
+
+        assert client.encoding == "msgpack"
+        assert msgpack.unpackb(sent_payload(mock_sock), raw=False) == {
+            "action": "search", "query": "q",
+        }
+        assert result == {"status": "ok", "results": []}
+
+    def test_decodes_json_response_in_msgpack_mode(self):
+        # Framing errors are always reported as JSON, whatever was sent
+        assert CppClient._decode(b' {"status": "error"}') == {"status": "error"}
+
+    def test_falls_back_to_json_without_msgpack(self):
+        with patch.object(client_module, "msgpack", None):
+            client = CppClient(encoding="msgpack")
+        assert client.encoding == "json"
+
+    def test_unknown_encoding(self):
+        with pytest.raises(ValueError, match="Unknown encoding"):
+            CppClient(encoding="xml")
+
+
+# =============================================================================
+# Unix domain socket transport
+# =============================================================================
+
+class TestUnixSocket:
+    def test_request_uses_af_unix(self):
+        with patch("socket.socket") as mock_sock_cls:
+            mock_sock = MagicMock()
+            mock_sock_cls.return_value = mock_sock
+            mock_sock.recv.side_effect = framed({"status": "ok"})
+
+            client = CppClient(socket_path="/tmp/vectordb.sock")
+            client._send_request({"action": "search"})
+
+        mock_sock_cls.assert_called_once_with(socket.AF_UNIX, socket.SOCK_STREAM)
+        mock_sock.connect.assert_called_once_with("/tmp/vectordb.sock")
+
+    def test_is_alive_uses_af_unix(self):
+        with patch("socket.socket") as mock_sock_cls:
+            mock_sock = MagicMock()
+            mock_sock_cls.return_value = mock_sock
+            client = CppClient(socket_path="/tmp/vectordb.sock")
+            assert client.is_alive() is True
+
+        mock_sock_cls.assert_called_once_with(socket.AF_UNIX, socket.SOCK_STREAM)
+        mock_sock.connect.assert_called_once_with("/tmp/vectordb.sock")
+
+    def test_tcp_without_socket_path(self):
+        with patch("socket.socket") as mock_sock_cls:
+            mock_sock = MagicMock()
+            mock_sock_cls.return_value = mock_sock
+            client = CppClient(socket_path="")
+            client.is_alive()
+
+        mock_sock_cls.assert_called_once_with(socket.AF_INET, socket.SOCK_STREAM)
+        mock_sock.connect.assert_called_once_with(("localhost", 50051))
+
+    def test_address(self):
+        assert CppClient(socket_path="/run/v.sock").address == "unix:/run/v.sock"
+        assert CppClient(socket_path="").address == "localhost:50051"
+
+
 # =============================================================================
 # _recv_exact
 # =============================================================================
@@ -183,6 +806,9 @@ class TestConfig:
         client = CppClient()
         assert client.host == "localhost"
         assert client.port == 50051
+        assert client.pool_size == 4
+        assert client.encoding == ("msgpack" if client_module.msgpack else "json")
+        assert client.socket_path == ""
 
     def test_custom_host_port(self):
         client = CppClient(host="192.168.1.1", port=9999)
@@ -1,6 +1,7 @@
 """Tests for parse.py — text extraction and chunking."""
 
-from unittest.mock import patch
+from concurrent.futures import ThreadPoolExecutor
+from unittest.mock import MagicMock, patch
 
 import pytest
 
@@ -9,6 +10,8 @@ from parse import (
     _generate_doc_id,
     extract_text_from_pdf,
     extract_text_from_txt,
+    iter_chunks,
+    iter_pdf_pages,
     split_into_chunks,
 )
 
@@ -130,6 +133,90 @@ class TestSplitIntoChunks:
         assert split_into_chunks(pages, filename="test.pdf") == []
 
 
+    def test_overlap_larger_than_chunk(self):
+        """Overlap that leaves no room for the next sentence is dropped."""
+        sentence = " ".join(["word"] * 30) + "."
+        pages = [{"page": 1, "text": " ".join([sentence] * 4)}]
+        with patch("parse.CHUNK_TOKEN_SIZE", 50), \
+             patch("parse.CHUNK_OVERLAP_SENTENCES", 2):
+            chunks = split_into_chunks(pages, filename="test.pdf")
+        assert len(chunks) == 4
+
+    def test_no_overlap(self, sample_pages):
+        with patch("parse.CHUNK_TOKEN_SIZE", 50), \
+             patch("parse.CHUNK_OVERLAP_SENTENCES", 0):
+            chunks = split_into_chunks(sample_pages, filename="test.pdf")
+        joined = " ".join(c["original_text"] for c in chunks)
+        assert len(chunks) > 1
+        assert len(joined.split()) == sum(len(p["text"].split()) for p in sample_pages)
+
+
+# =============================================================================
+# iter_chunks
+# =============================================================================
+
+class TestIterChunks:
+    def test_matches_split_into_chunks(self, sample_pages):
+        with patch("parse.CHUNK_TOKEN_SIZE", 50):
+            streamed = list(iter_chunks(sample_pages, filename="test.pdf"))
+            chunks = split_into_chunks(sample_pages, filename="test.pdf")
+        assert [c["total_chunks"] for c in streamed] == [0] * len(chunks)
+        for c in chunks:
+            c["total_chunks"] = 0
+        assert streamed == chunks
+
+    def test_yields_before_all_pages_read(self, sample_pages):
+        read = []
+
+        def pages():
+            for page in sample_pages:
+                read.append(page["page"])
+                yield page
+
+        with patch("parse.CHUNK_TOKEN_SIZE", 50):
+            next(iter_chunks(pages(), filename="test.pdf"))
+        assert len(read) < len(sample_pages)
+
+    def test_uses_presplit_sentences(self):
+        pages = [{"page": 3, "text": "ignored", "sentences": ["One.", "Two."]}]
+        chunks = list(iter_chunks(pages, filename="test.pdf"))
+        assert chunks[0]["original_text"] == "One. Two."
+        assert chunks[0]["page_start"] == 3
+
+
+# =============================================================================
+# iter_pdf_pages
+# =============================================================================
+
+def fake_pdf(texts):
+    pdf = MagicMock()
+    pdf.__enter__.return_value = pdf
+    pdf.pages = [MagicMock(**{"extract_text.return_value": t}) for t in texts]
+    return pdf
+
+
+class TestIterPdfPages:
+    TEXTS = [f"Page {i} has a sentence that is long enough to keep. And another one."
+             for i in range(1, 8)]
+
+    def test_single_worker(self, tmp_path):
+        with patch("pdfplumber.open", return_value=fake_pdf(self.TEXTS)), \
+             patch("parse.PAGES_PER_TASK", 3):
+            pages = list(iter_pdf_pages(tmp_path / "big.pdf", workers=1))
+        assert [p["page"] for p in pages] == list(range(1, 8))
+        assert pages[0]["sentences"] == [
+            "Page 1 has a sentence that is long enough to keep.", "And another one."]
+
+    def test_pool_keeps_page_order(self, tmp_path):
+        # Threads stand in for processes so the patched pdfplumber is seen.
+        with patch("pdfplumber.open", return_value=fake_pdf(self.TEXTS)), \
+             patch("parse.PAGES_PER_TASK", 2), \
+             patch("parse.ProcessPoolExecutor", ThreadPoolExecutor):
+            pages = list(iter_pdf_pages(tmp_path / "big.pdf", workers=3))
+        assert [p["page"] for p in pages] == list(range(1, 8))
+        assert [p["text"] for p in pages] == self.TEXTS
+
+
 # =============================================================================
 # extract_text_from_pdf (requires reportlab fixture)
 # =============================================================================
@@ -6,7 +6,18 @@ from unittest.mock import MagicMock, patch, call
 
 import pytest
 
-from process import FileStats, _store_chunks, _run_pipeline, process_pdf, process_txt
+from process import (
+    FileStats,
+    _chunk_record,
+    _content_hash,
+    _run_pipeline,
+    _run_pipeline_streaming,
+    _store_chunks,
+    _translate_streaming,
+    _update_translated,
+    process_pdf,
+    process_txt,
+)
 
 
 # =============================================================================
@@ -43,10 +54,34 @@ class TestStoreChunks:
         stats = FileStats("test.pdf")
         _store_chunks(mock_cpp_client, sample_chunks, stats)
         assert stats.chunks_stored == 2
-        assert mock_cpp_client.store_chunk.call_count == 2
+        mock_cpp_client.store_chunks.assert_called_once()
+        records = mock_cpp_client.store_chunks.call_args.args[0]
+        assert [r["chunk_id"] for r in records] == [c["chunk_id"] for c in sample_chunks]
+        assert records[0]["text"] == sample_chunks[0]["original_text"]
+        mock_cpp_client.store_chunk.assert_not_called()
+
+    def test_clears_previous_chunks(self, sample_chunks, mock_cpp_client):
+        stats = FileStats("test.pdf")
+        _store_chunks(mock_cpp_client, sample_chunks, stats)
+        mock_cpp_client.delete_doc.assert_called_once_with(sample_chunks[0]["doc_id"])
+
+    def test_delete_failure_still_stores(self, sample_chunks, mock_cpp_client):
+        mock_cpp_client.delete_doc.side_effect = RuntimeError("unknown action")
+        stats = FileStats("test.pdf")
+        _store_chunks(mock_cpp_client, sample_chunks, stats)
+        assert stats.chunks_stored == 2
+
+    def test_batches_by_size(self, sample_chunks, mock_cpp_client):
+        stats = FileStats("test.pdf")
+        with patch("process.STORE_BATCH_SIZE", 1):
+            _store_chunks(mock_cpp_client, sample_chunks, stats)
+        assert stats.chunks_stored == 2
+        assert mock_cpp_client.store_chunks.call_count == 2
 
     def test_partial_failure(self, sample_chunks):
+        """A failed batch falls back to per-chunk stores."""
         client = MagicMock()
+        client.store_chunks.side_effect = RuntimeError("batch rejected")
         client.store_chunk.side_effect = [
             {"status": "ok"},
             RuntimeError("connection lost"),
@@ -57,6 +92,105 @@ class TestStoreChunks:
         assert stats.chunks_store_failed == 1
 
 
+# =============================================================================
+# _update_translated
+# =============================================================================
+
+class TestUpdateTranslated:
+    def test_none_client(self, sample_chunks):
+        _update_translated(None, [(sample_chunks[0], "Bonjour")])
+
+    def test_includes_translation(self, sample_chunks, mock_cpp_client):
+        _update_translated(mock_cpp_client, [(sample_chunks[0], "Bonjour")])
+        records = mock_cpp_client.store_chunks.call_args.args[0]
+        assert records[0]["metadata"]["translated_text"] == "Bonjour"
+
+    def test_chunk_record_without_translation(self, sample_chunks):
+        record = _chunk_record(sample_chunks[0])
+        assert "translated_text" not in record["metadata"]
+        assert record["metadata"]["page_start"] == 1
+
+
+# =============================================================================
+# _translate_streaming
+# =============================================================================
+
+class TestTranslateStreaming:
+    def test_stores_each_chunk_as_translated(self, sample_chunks, mock_cpp_client):
+        def translate(chunks, on_progress=None, on_chunk=None):
+            on_chunk(chunks[0], "Bonjour")
+            on_chunk(chunks[1], None)
+            return [(chunks[0], "Bonjour")]
+
+        stats = FileStats("test.pdf")
+        with patch("process.translate_text", side_effect=translate):
+            results = _translate_streaming(mock_cpp_client, sample_chunks, stats)
+
+        assert results == [(sample_chunks[0], "Bonjour")]
+        mock_cpp_client.delete_doc.assert_called_once_with(sample_chunks[0]["doc_id"])
+        records = mock_cpp_client.store_pipeline.return_value.records
+        assert [r["chunk_id"] for r in records] == [c["chunk_id"] for c in sample_chunks]
+        assert records[0]["metadata"]["translated_text"] == "Bonjour"
+        assert "translated_text" not in records[1]["metadata"]
+        assert stats.chunks_stored == 2
+        mock_cpp_client.store_chunks.assert_not_called()
+
+    def test_retries_failed_records(self, sample_chunks, mock_cpp_client):
+        pipeline = mock_cpp_client.store_pipeline.return_value
+        pipeline.failed = [_chunk_record(sample_chunks[1])]
+        stats = FileStats("test.pdf")
+        with patch("process.translate_text", return_value=[]):
+            _translate_streaming(mock_cpp_client, sample_chunks, stats)
+
+        mock_cpp_client.store_chunks.assert_called_once_with(pipeline.failed)
+        assert stats.chunks_stored == 2
+        assert stats.chunks_store_failed == 0
+
+    def test_stores_untranslated_chunks_on_error(self, sample_chunks, mock_cpp_client):
+        stats = FileStats("test.pdf")
+        with patch("process.translate_text", side_effect=RuntimeError("quota")), \
+             pytest.raises(RuntimeError):
+            _translate_streaming(mock_cpp_client, sample_chunks, stats)
+
+        records = mock_cpp_client.store_pipeline.return_value.records
+        assert len(records) == 2
+        assert stats.chunks_stored == 2
+
+    def test_pipeline_uses_streaming(self, tmp_dirs, sample_pages, mock_cpp_client):
+        chunk = {
+            "chunk_id": "c1", "doc_id": "d1", "filename": "test.pdf",
+            "page_start": 1, "page_end": 1, "chunk_index": 0,
+            "total_chunks": 1, "char_count": 50, "original_text": "Hello",
+        }
+        src_file = tmp_dirs["input"] / "test.pdf"
+        src_file.write_text("fake pdf")
+
+        with patch("process.split_into_chunks", return_value=[chunk]), \
+             patch("process.translate_text", return_value=[(chunk, "OK")]), \
+             patch("process._store_chunks") as mock_store, \
+             patch("process._update_translated") as mock_update:
+            _run_pipeline(sample_pages, "test.pdf", src_file, mock_cpp_client)
+        mock_store.assert_not_called()
+        mock_update.assert_not_called()
+        mock_cpp_client.store_pipeline.assert_called_once()
+
+    def test_pipeline_without_streaming(self, tmp_dirs, sample_pages, mock_cpp_client):
+        chunk = {
+            "chunk_id": "c1", "doc_id": "d1", "filename": "test.pdf",
+            "page_start": 1, "page_end": 1, "chunk_index": 0,
+            "total_chunks": 1, "char_count": 50, "original_text": "Hello",
+        }
+        src_file = tmp_dirs["input"] / "test.pdf"
+        src_file.write_text("fake pdf")
+
+        with patch("process.CPP_SERVER_STREAM_STORE", False), \
+             patch("process.split_into_chunks", return_value=[chunk]), \
+             patch("process.translate_text", return_value=[(chunk, "OK")]):
+            _run_pipeline(sample_pages, "test.pdf", src_file, mock_cpp_client)
+        mock_cpp_client.store_pipeline.assert_not_called()
+        assert mock_cpp_client.store_chunks.call_count == 2
+
+
 # =============================================================================
 # _run_pipeline
 # =============================================================================
@@ -168,6 +302,178 @@ class TestRunPipeline:
         assert mock_translate.call_args.kwargs.get("on_progress") is callback
 
 
+# =============================================================================
+# _run_pipeline_streaming
+# =============================================================================
+
+class TestRunPipelineStreaming:
+    def test_counts_streamed_chunks(self, tmp_dirs, sample_chunks, mock_cpp_client):
+        src_file = tmp_dirs["input"] / "test.pdf"
+        src_file.write_text("fake pdf")
+
+        def translate(chunks, on_progress=None, on_chunk=None):
+            results = []
+            for chunk in chunks:
+                on_chunk(chunk, "OK")
+                results.append((chunk, "OK"))
+            return results
+
+        with patch("process.translate_text", side_effect=translate):
+            ok = _run_pipeline_streaming(iter(sample_chunks), "test.pdf", src_file,
+                                         mock_cpp_client)
+        assert ok is True
+        mock_cpp_client.delete_doc.assert_called_once_with(sample_chunks[0]["doc_id"])
+        records = mock_cpp_client.store_pipeline.return_value.records
+        assert len(records) == 2
+        assert (tmp_dirs["output"] / "test_translated.txt").exists()
+
+    def test_no_chunks(self, tmp_dirs):
+        src_file = tmp_dirs["input"] / "test.pdf"
+        assert _run_pipeline_streaming(iter([]), "test.pdf", src_file, None) is False
+
+    def test_store_all_first_without_stream_store(self, tmp_dirs, sample_chunks,
+                                                  mock_cpp_client):
+        src_file = tmp_dirs["input"] / "test.pdf"
+        src_file.write_text("fake pdf")
+        with patch("process.CPP_SERVER_STREAM_STORE", False), \
+             patch("process.translate_text", return_value=[(sample_chunks[0], "OK")]):
+            _run_pipeline_streaming(iter(sample_chunks), "test.pdf", src_file,
+                                    mock_cpp_client)
+        first_store = mock_cpp_client.store_chunks.call_args_list[0].args[0]
+        assert len(first_store) == 2
+
+    def test_process_pdf_streams_with_workers(self, tmp_dirs, sample_chunks):
+        src_file = tmp_dirs["input"] / "test.pdf"
+        src_file.write_text("fake pdf")
+        with patch("process.PARSE_WORKERS", 4), \
+             patch("process.iter_pdf_pages", return_value=iter([])) as mock_pages, \
+             patch("process.iter_chunks", return_value=iter(sample_chunks)), \
+             patch("process.translate_text", return_value=[(sample_chunks[0], "OK")]):
+            assert process_pdf(src_file) is True
+        mock_pages.assert_called_once_with(src_file, 4)
+
+
+# =============================================================================
+# Incremental re-processing
+# =============================================================================
+
+def previous_run(unchanged=(), stale=()):
+    """diff_chunks side effect for a doc stored earlier: the probe sees
+    stored chunks, the comparison finds `unchanged` (chunk dicts with their
+    stored metadata) current and `stale` gone."""
+    def diff(doc_id, chunks, fields=None):
+        if not chunks:
+            return {"changed": [], "unchanged": [], "stale": ["stored"]}
+        listed = {chunk_id for chunk_id, _ in chunks}
+        current = [{"chunk_id": c["chunk_id"], "metadata": c["metadata"]}
+                   for c in unchanged if c["chunk_id"] in listed]
+        return {"changed": [i for i in listed if i not in {c["chunk_id"] for c in current}],
+                "unchanged": current, "stale": list(stale)}
+    return diff
+
+
+class TestContentHash:
+    def test_only_translated_records_carry_it(self, sample_chunks):
+        record = _chunk_record(sample_chunks[0], "Bonjour")
+        assert record["content_hash"] == _content_hash(sample_chunks[0])
+        assert "content_hash" not in _chunk_record(sample_chunks[0])
+
+    def test_covers_text_and_languages(self, sample_chunks):
+        first = _content_hash(sample_chunks[0])
+        assert _content_hash(sample_chunks[1]) != first
+        with patch("config.TARGET_LANG", "ja"):
+            assert _content_hash(sample_chunks[0]) != first
+        edited = dict(sample_chunks[0], page_start=7)
+        assert _content_hash(edited) == first
+
+
+class TestIncremental:
+    def run(self, tmp_dirs, chunks, client, translate):
+        src_file = tmp_dirs["input"] / "test.pdf"
+        src_file.write_text("fake pdf")
+        with patch("process.split_into_chunks", return_value=chunks), \
+             patch("process.translate_text", side_effect=translate) as mock_translate:
+            ok = _run_pipeline([{"page": 1, "text": "x" * 60}], "test.pdf", src_file, client)
+        return ok, mock_translate
+
+    @staticmethod
+    def translate_all(chunks, on_progress=None, on_chunk=None):
+        results = []
+        for chunk in chunks:
+            if on_chunk:
+                on_chunk(chunk, "New " + chunk["chunk_id"])
+            results.append((chunk, "New " + chunk["chunk_id"]))
+        return results
+
+    def test_translates_only_changed_chunks(self, tmp_dirs, sample_chunks, mock_cpp_client):
+        kept = _chunk_record(sample_chunks[0], "Old translation")
+        mock_cpp_client.diff_chunks.side_effect = previous_run(
+            unchanged=[kept], stale=["doc_abc12345_chunk_0002"])
+        ok, mock_translate = self.run(tmp_dirs, sample_chunks, mock_cpp_client,
+                                      self.translate_all)
+
+        assert ok is True
+        assert mock_translate.call_args.args[0] == [sample_chunks[1]]
+        mock_cpp_client.delete_doc.assert_not_called()
+        mock_cpp_client.delete_chunk.assert_called_once_with("doc_abc12345_chunk_0002")
+        records = mock_cpp_client.store_pipeline.return_value.records
+        assert [r["chunk_id"] for r in records] == [sample_chunks[1]["chunk_id"]]
+        mock_cpp_client.store_chunks.assert_not_called()
+
+        content = (tmp_dirs["output"] / "test_translated.txt").read_text(encoding="utf-8")
+        assert content.index("Old translation") < content.index("New doc_abc12345_chunk_0001")
+
+    def test_restores_moved_metadata_without_translating(self, tmp_dirs, sample_chunks,
+                                                          mock_cpp_client):
+        moved = _chunk_record(dict(sample_chunks[0], page_start=5, page_end=5), "Old")
+        mock_cpp_client.diff_chunks.side_effect = previous_run(unchanged=[moved])
+        self.run(tmp_dirs, sample_chunks, mock_cpp_client, self.translate_all)
+
+        restored = mock_cpp_client.store_chunks.call_args.args[0]
+        assert restored == [_chunk_record(sample_chunks[0], "Old")]
+
+    def test_untranslated_chunks_are_redone(self, tmp_dirs, sample_chunks, mock_cpp_client):
+        untranslated = _chunk_record(sample_chunks[0])
+        mock_cpp_client.diff_chunks.side_effect = previous_run(unchanged=[untranslated])
+        _, mock_translate = self.run(tmp_dirs, sample_chunks, mock_cpp_client,
+                                     self.translate_all)
+        assert mock_translate.call_args.args[0] == sample_chunks
+
+    def test_all_unchanged_still_saves(self, tmp_dirs, sample_chunks, mock_cpp_client):
+        kept = [_chunk_record(c, "Old " + c["chunk_id"]) for c in sample_chunks]
+        mock_cpp_client.diff_chunks.side_effect = previous_run(unchanged=kept)
+        ok, mock_translate = self.run(tmp_dirs, sample_chunks, mock_cpp_client,
+                                      self.translate_all)
+        assert ok is True
+        assert mock_translate.call_args.args[0] == []
+        content = (tmp_dirs["output"] / "test_translated.txt").read_text(encoding="utf-8")
+        assert "Old doc_abc12345_chunk_0001" in content
+
+    def test_without_stream_store(self, tmp_dirs, sample_chunks, mock_cpp_client):
+        kept = _chunk_record(sample_chunks[0], "Old")
+        mock_cpp_client.diff_chunks.side_effect = previous_run(unchanged=[kept])
+        with patch("process.CPP_SERVER_STREAM_STORE", False):
+            self.run(tmp_dirs, sample_chunks, mock_cpp_client, self.translate_all)
+        mock_cpp_client.delete_doc.assert_not_called()
+        stored = [r["chunk_id"] for call in mock_cpp_client.store_chunks.call_args_list
+                  for r in call.args[0]]
+        assert stored == [sample_chunks[1]["chunk_id"]] * 2
+
+    def test_diff_failure_redoes_document(self, tmp_dirs, sample_chunks, mock_cpp_client):
+        probe = {"changed": [], "unchanged": [], "stale": ["stored"]}
+        mock_cpp_client.diff_chunks.side_effect = [probe, RuntimeError("boom")]
+        _, mock_translate = self.run(tmp_dirs, sample_chunks, mock_cpp_client,
+                                     self.translate_all)
+        mock_cpp_client.delete_doc.assert_called_once_with(sample_chunks[0]["doc_id"])
+        assert mock_translate.call_args.args[0] == sample_chunks
+
+    def test_disabled(self, tmp_dirs, sample_chunks, mock_cpp_client):
+        with patch("process.CPP_SERVER_INCREMENTAL", False):
+            self.run(tmp_dirs, sample_chunks, mock_cpp_client, self.translate_all)
+        mock_cpp_client.diff_chunks.assert_not_called()
+        mock_cpp_client.delete_doc.assert_called_once()
+
+
 # =============================================================================
 # process_pdf
 # =============================================================================
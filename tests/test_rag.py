@@ -32,6 +32,16 @@ class TestAskQuestion:
         assert "No relevant content" in answer
         assert pages == []
 
+    def test_requests_only_prompt_fields(self):
+        client = MagicMock()
+        client.search.return_value = []
+
+        ask_question("What?", "d1", client)
+        fields = client.search.call_args.kwargs["fields"]
+        assert "text" in fields
+        assert "metadata.translated_text" in fields
+        assert "metadata" not in fields
+
     def test_uses_translated_text(self, mock_groq_response):
         """When metadata has translated_text, it should be used as context."""
         client = MagicMock()
@@ -1,11 +1,12 @@
 """Tests for translate.py — UsageTracker and Groq translation."""
 
+import threading
 from unittest.mock import patch, MagicMock
 
 import pytest
 
 import translate
-from translate import UsageTracker, translate_chunk, translate_text
+from translate import RequestBudget, UsageTracker, translate_chunk, translate_text
 
 
 # =============================================================================
@@ -202,3 +203,145 @@ class TestTranslateText:
         assert callback.call_count == 2
         callback.assert_any_call(1, 2, 0)
         callback.assert_any_call(2, 2, 0)
+
+    def test_streamed_chunks(self, sample_chunks, mock_groq_response):
+        mock_client = MagicMock()
+        mock_client.chat.completions.create.return_value = mock_groq_response("OK", 50, 25)
+        callback = MagicMock()
+
+        with patch("translate._get_client", return_value=mock_client), \
+             patch("time.sleep"):
+            results = translate_text(iter(sample_chunks), on_progress=callback)
+        assert len(results) == 2
+        assert callback.call_args_list == [((1, 0, 0),), ((2, 0, 0),)]
+
+    def test_chunk_callback(self, sample_chunks, mock_groq_response, rate_limit_error):
+        mock_client = MagicMock()
+        mock_client.chat.completions.create.side_effect = [
+            mock_groq_response("Bonjour", 50, 25),
+            rate_limit_error(),
+            rate_limit_error(),
+            rate_limit_error(),
+        ]
+        callback = MagicMock()
+
+        with patch("translate._get_client", return_value=mock_client), \
+             patch("time.sleep"):
+            translate_text(sample_chunks, on_chunk=callback)
+        assert callback.call_args_list == [
+            ((sample_chunks[0], "Bonjour"),),
+            ((sample_chunks[1], None),),
+        ]
+
+
+# =============================================================================
+# RequestBudget
+# =============================================================================
+
+class FakeClock:
+    def __init__(self):
+        self.now = 100.0
+
+    def __call__(self):
+        return self.now
+
+
+class TestRequestBudget:
+    def test_requests_per_min(self):
+        clock = FakeClock()
+        budget = RequestBudget(max_in_flight=10, requests_per_min=2, clock=clock)
+        budget.acquire(0)
+        budget.acquire(0)
+        assert budget._wait_time(0) == pytest.approx(30)
+        clock.now += 30
+        assert budget._wait_time(0) == 0
+
+    def test_tokens_per_min_settles_actual_usage(self):
+        clock = FakeClock()
+        budget = RequestBudget(max_in_flight=10, tokens_per_min=1000, clock=clock)
+        budget.acquire(800)
+        assert budget._wait_time(800) == pytest.approx(36)
+        budget.release(800, 200)  # only 200 were used
+        assert budget._wait_time(800) == 0
+
+    def test_oversized_request_waits_for_full_bucket(self):
+        clock = FakeClock()
+        budget = RequestBudget(max_in_flight=10, tokens_per_min=1000, clock=clock)
+        assert budget._wait_time(5000) == 0
+
+    def test_in_flight_cap(self):
+        budget = RequestBudget(max_in_flight=2, clock=FakeClock())
+        budget.acquire(0)
+        budget.acquire(0)
+        assert budget._wait_time(0) == float("inf")
+        budget.cancel(0)
+        assert budget._wait_time(0) == 0
+
+    def test_throttle_halves_and_pauses(self):
+        clock = FakeClock()
+        budget = RequestBudget(max_in_flight=8, clock=clock)
+        budget.acquire(0)
+        budget.throttle(0, 5)
+        assert budget.limit == 4
+        assert budget._wait_time(0) == pytest.approx(5)
+        clock.now += 5
+        assert budget._wait_time(0) == 0
+
+    def test_success_grows_limit_back(self):
+        budget = RequestBudget(max_in_flight=4, clock=FakeClock())
+        budget.limit = 1.0
+        for _ in range(20):
+            budget.acquire(0)
+            budget.release(0, 0)
+        assert budget.limit == 4
+
+
+# =============================================================================
+# translate_text (concurrent)
+# =============================================================================
+
+class TestTranslateConcurrent:
+    def test_reorders_completions(self, sample_chunks, mock_groq_response):
+        second_done = threading.Event()
+
+        def create(**kwargs):
+            prompt = kwargs["messages"][0]["content"]
+            if prompt.endswith(sample_chunks[0]["original_text"]):
+                # Finishes only after the second chunk has.
+                assert second_done.wait(5)
+                return mock_groq_response("one", 10, 5)
+            second_done.set()
+            return mock_groq_response("two", 10, 5)
+
+        mock_client = MagicMock()
+        mock_client.chat.completions.create.side_effect = create
+        progress = MagicMock()
+        on_chunk = MagicMock()
+
+        with patch("translate._get_client", return_value=mock_client), \
+             patch("config.TRANSLATE_CONCURRENCY", 2), \
+             patch("config.GROQ_REQUESTS_PER_MIN", 0), \
+             patch("config.GROQ_TOKENS_PER_MIN", 0):
+            results = translate_text(sample_chunks, on_progress=progress, on_chunk=on_chunk)
+
+        assert [text for _, text in results] == ["one", "two"]
+        assert progress.call_args_list == [((1, 2, 0),), ((2, 2, 0),)]
+        assert [c.args[1] for c in on_chunk.call_args_list] == ["one", "two"]
+
+    def test_rate_limit_retries(self, sample_chunks, mock_groq_response, rate_limit_error):
+        mock_client = MagicMock()
+        mock_client.chat.completions.create.side_effect = [
+            rate_limit_error(),
+            mock_groq_response("OK", 10, 5),
+            mock_groq_response("OK", 10, 5),
+        ]
+
+        with patch("translate._get_client", return_value=mock_client), \
+             patch("translate.BACKOFF_BASE", 0), \
+             patch("config.TRANSLATE_CONCURRENCY", 2), \
+             patch("config.GROQ_REQUESTS_PER_MIN", 0), \
+             patch("config.GROQ_TOKENS_PER_MIN", 0):
+            results = translate_text(sample_chunks)
+
+        assert len(results) == 2
+        assert mock_client.chat.completions.create.call_count == 3
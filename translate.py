@@ -3,8 +3,13 @@ Translation module — Groq API
 Milestone 2: Full Groq API integration with rate limiting and error handling.
 """
 
+import math
+import threading
 import time
 import logging
+from collections import deque
+from collections.abc import Iterable, Sized
+from concurrent.futures import ThreadPoolExecutor
 
 from groq import Groq, RateLimitError, APIError
 
@@ -22,14 +27,17 @@ class UsageTracker:
         self.total_output_tokens = 0
         self.translations = 0
         self.skipped = 0
+        self._lock = threading.Lock()
 
     def add(self, input_tokens: int, output_tokens: int):
-        self.total_input_tokens += input_tokens
-        self.total_output_tokens += output_tokens
-        self.translations += 1
+        with self._lock:
+            self.total_input_tokens += input_tokens
+            self.total_output_tokens += output_tokens
+            self.translations += 1
 
     def add_skip(self):
-        self.skipped += 1
+        with self._lock:
+            self.skipped += 1
 
     def print_summary(self):
         total = self.total_input_tokens + self.total_output_tokens
@@ -59,10 +67,112 @@ def _get_client() -> Groq:
     return _client
 
 
+# =============================================================================
+# Rate budgeting (concurrent translation)
+# =============================================================================
+class RequestBudget:
+    """Admits API requests under a requests/min and a tokens/min limit.
+
+    Both limits are token buckets refilled continuously and starting full,
+    so a burst up to a minute's allowance goes out at once. A request
+    reserves its worst-case token count up front; release() settles the
+    bucket with what the response reports it actually used (the counts
+    UsageTracker records), so overestimates are handed back.
+
+    Concurrency adapts AIMD-style: each success raises the in-flight cap
+    by about one per cap's worth of requests, up to max_in_flight; a 429
+    halves it and pauses every request for the backoff.
+    """
+
+    def __init__(self, max_in_flight: int, requests_per_min: int = 0,
+                 tokens_per_min: int = 0, clock=time.monotonic):
+        self.max_in_flight = max(1, max_in_flight)
+        self.limit = float(self.max_in_flight)
+        self.in_flight = 0
+        self._rpm = requests_per_min
+        self._tpm = tokens_per_min
+        self._requests = float(requests_per_min)
+        self._tokens = float(tokens_per_min)
+        self._paused_until = 0.0
+        self._clock = clock
+        self._updated = clock()
+        self._cond = threading.Condition()
+
+    def acquire(self, tokens: int):
+        """Block until a request needing up to `tokens` may go out."""
+        with self._cond:
+            while True:
+                wait = self._wait_time(tokens)
+                if wait == 0:
+                    break
+                self._cond.wait(None if math.isinf(wait) else wait)
+            self.in_flight += 1
+            self._requests -= 1
+            self._tokens -= tokens
+
+    def release(self, reserved: int, used: int):
+        """A request succeeded, having used `used` of `reserved` tokens."""
+        with self._cond:
+            self.in_flight -= 1
+            self._tokens = min(self._tokens + reserved - used, float(self._tpm))
+            self.limit = min(self.max_in_flight, self.limit + 1 / self.limit)
+            self._cond.notify_all()
+
+    def cancel(self, reserved: int):
+        """A request failed without being rate-limited."""
+        with self._cond:
+            self.in_flight -= 1
+            self._tokens = min(self._tokens + reserved, float(self._tpm))
+            self._cond.notify_all()
+
+    def throttle(self, reserved: int, wait: float):
+        """A request was rate-limited: back off everyone for `wait` seconds."""
+        with self._cond:
+            self.in_flight -= 1
+            self._tokens = min(self._tokens + reserved, float(self._tpm))
+            self.limit = max(1.0, self.limit / 2)
+            self._paused_until = max(self._paused_until, self._clock() + wait)
+            self._cond.notify_all()
+
+    def _wait_time(self, tokens: int) -> float:
+        """Seconds until a request of `tokens` fits (inf: until a release);
+        0 if it fits now. Call with the lock held."""
+        now = self._clock()
+        elapsed = now - self._updated
+        self._updated = now
+        if self._rpm:
+            self._requests = min(self._requests + elapsed * self._rpm / 60, float(self._rpm))
+        if self._tpm:
+            self._tokens = min(self._tokens + elapsed * self._tpm / 60, float(self._tpm))
+
+        if now < self._paused_until:
+            return self._paused_until - now
+        if self.in_flight >= int(self.limit):
+            return math.inf
+        if self._rpm and self._requests < 1:
+            return (1 - self._requests) * 60 / self._rpm
+        # A request larger than the whole bucket waits for a full one.
+        needed = min(tokens, self._tpm)
+        if self._tpm and self._tokens < needed:
+            return (needed - self._tokens) * 60 / self._tpm
+        return 0.0
+
+
+def _retry_after(error: Exception) -> float | None:
+    """The Retry-After seconds a 429 response carries, if any."""
+    headers = getattr(getattr(error, "response", None), "headers", None)
+    if headers is None:
+        return None
+    try:
+        return float(headers.get("retry-after"))
+    except (TypeError, ValueError):
+        return None
+
+
 # =============================================================================
 # Translation
 # =============================================================================
-REQUEST_DELAY = 0.5        # seconds between API calls
+REQUEST_DELAY = 0.5        # seconds between API calls when translating one at a time
 MAX_RETRIES = 3
 BACKOFF_BASE = 1           # exponential backoff: 1s -> 2s -> 4s
 
@@ -73,9 +183,14 @@ def translate_chunk(
     total_chunks: int,
     source_lang: str | None = None,
     target_lang: str | None = None,
+    budget: RequestBudget | None = None,
 ) -> tuple[str | None, int, int]:
     """
-    Translate a single chunk via Groq API.
+    Translate a single chunk via Groq API. total_chunks is only for
+    progress output; 0 means not known yet.
+
+    With a budget, every attempt waits for its admission, and a rate limit
+    backs off all requests sharing the budget instead of just this one.
 
     Returns:
         (translated_text, input_tokens, output_tokens)
@@ -96,8 +211,11 @@ def translate_chunk(
     max_tokens = max(max_tokens, 256)  # floor to avoid tiny limits
 
     client = _get_client()
+    reserved = estimated_input_tokens + max_tokens
 
     for attempt in range(MAX_RETRIES):
+        if budget is not None:
+            budget.acquire(reserved)
         try:
             response = client.chat.completions.create(
                 model=config.GROQ_MODEL_TRANSLATE,
@@ -110,49 +228,73 @@ def translate_chunk(
             input_tok = response.usage.prompt_tokens
             output_tok = response.usage.completion_tokens
 
-            print(f"   Chunk {chunk_num}/{total_chunks} translated "
+            if budget is not None:
+                budget.release(reserved, input_tok + output_tok)
+            print(f"   Chunk {chunk_num}/{total_chunks or '?'} translated "
                   f"({input_tok}+{output_tok} tokens)")
             return translated, input_tok, output_tok
 
-        except RateLimitError:
-            wait = BACKOFF_BASE * (2 ** attempt)
-            print(f"   Chunk {chunk_num}/{total_chunks} rate-limited, "
+        except RateLimitError as e:
+            wait = max(BACKOFF_BASE * (2 ** attempt), _retry_after(e) or 0)
+            print(f"   Chunk {chunk_num}/{total_chunks or '?'} rate-limited, "
                   f"retrying in {wait}s... (attempt {attempt + 1}/{MAX_RETRIES})")
-            time.sleep(wait)
+            if budget is not None:
+                budget.throttle(reserved, wait)  # the next acquire() waits it out
+            else:
+                time.sleep(wait)
 
         except APIError as e:
             wait = BACKOFF_BASE * (2 ** attempt)
             logger.warning("Groq API error on chunk %d: %s", chunk_num, e)
-            print(f"   Chunk {chunk_num}/{total_chunks} API error, "
+            print(f"   Chunk {chunk_num}/{total_chunks or '?'} API error, "
                   f"retrying in {wait}s... (attempt {attempt + 1}/{MAX_RETRIES})")
+            if budget is not None:
+                budget.cancel(reserved)
             time.sleep(wait)
 
+        except BaseException:
+            if budget is not None:
+                budget.cancel(reserved)
+            raise
+
     # All retries exhausted
-    print(f"   [SKIP] Chunk {chunk_num}/{total_chunks} failed after {MAX_RETRIES} retries")
+    print(f"   [SKIP] Chunk {chunk_num}/{total_chunks or '?'} failed after {MAX_RETRIES} retries")
     return None, 0, 0
 
 
 def translate_text(
-    chunks: list[dict],
+    chunks: Iterable[dict],
     source_lang: str | None = None,
     target_lang: str | None = None,
     on_progress=None,
+    on_chunk=None,
 ) -> list[tuple[dict, str]]:
     """
     Translate metadata-enriched chunks via Groq API.
 
+    With TRANSLATE_CONCURRENCY above 1, up to that many requests run at
+    once under GROQ_REQUESTS_PER_MIN / GROQ_TOKENS_PER_MIN (see
+    RequestBudget) instead of one at a time with a fixed delay. Chunks may
+    finish in any order; callbacks and results still follow input order.
+
     Args:
-        chunks: List of chunk metadata dicts from parse.split_into_chunks().
+        chunks: Chunk metadata dicts from parse.split_into_chunks(), or a
+            stream of them from parse.iter_chunks(): each is sent as soon as
+            it arrives, and progress totals are then 0 (unknown).
         source_lang: Override source language code.
         target_lang: Override target language code.
         on_progress: Optional callback(current, total, skipped) called after each chunk.
+        on_chunk: Optional callback(chunk, translated_text) called as each chunk
+            finishes, with None for a chunk that failed.
 
     Returns:
         List of (chunk_metadata, translated_text) pairs.
         Failed chunks are skipped (not included in output).
     """
-    if not chunks:
-        return []
+    total = len(chunks) if isinstance(chunks, Sized) else 0
+    if config.TRANSLATE_CONCURRENCY > 1:
+        return _translate_concurrent(chunks, total, source_lang, target_lang,
+                                     on_progress, on_chunk)
 
     results: list[tuple[dict, str]] = []
     skipped = 0
@@ -163,19 +305,72 @@ def translate_text(
             time.sleep(REQUEST_DELAY)
 
         translated, in_tok, out_tok = translate_chunk(
-            chunk["original_text"], i, len(chunks),
+            chunk["original_text"], i, total,
             source_lang=source_lang, target_lang=target_lang,
         )
+        skipped += _record_result(chunk, translated, in_tok, out_tok, results)
 
-        if translated is not None:
-            usage_tracker.add(in_tok, out_tok)
-            chunk["translated_text"] = translated
-            results.append((chunk, translated))
-        else:
-            usage_tracker.add_skip()
-            skipped += 1
-
+        if on_chunk:
+            on_chunk(chunk, translated)
         if on_progress:
-            on_progress(i, len(chunks), skipped)
+            on_progress(i, total, skipped)
 
     return results
+
+
+def _translate_concurrent(
+    chunks: Iterable[dict],
+    total: int,
+    source_lang: str | None,
+    target_lang: str | None,
+    on_progress,
+    on_chunk,
+) -> list[tuple[dict, str]]:
+    budget = RequestBudget(config.TRANSLATE_CONCURRENCY, config.GROQ_REQUESTS_PER_MIN,
+                           config.GROQ_TOKENS_PER_MIN)
+    results: list[tuple[dict, str]] = []
+    skipped = 0
+
+    # Submitted (chunk, future) pairs not yet reported. Only the head is
+    # ever reported, which puts completions back into chunk order.
+    queued = deque()
+
+    def report(wait: bool):
+        nonlocal skipped
+        while queued and (wait or queued[0][1].done()):
+            chunk, future = queued.popleft()
+            translated, in_tok, out_tok = future.result()
+            skipped += _record_result(chunk, translated, in_tok, out_tok, results)
+
+            done = len(results) + skipped
+            if on_chunk:
+                on_chunk(chunk, translated)
+            if on_progress:
+                on_progress(done, total, skipped)
+
+    with ThreadPoolExecutor(max_workers=budget.max_in_flight,
+                            thread_name_prefix="translate") as pool:
+        try:
+            for i, chunk in enumerate(chunks, 1):
+                queued.append((chunk, pool.submit(translate_chunk, chunk["original_text"],
+                                                  i, total, source_lang, target_lang, budget)))
+                report(wait=False)
+            report(wait=True)
+        except BaseException:
+            for _, future in queued:
+                future.cancel()
+            raise
+
+    return results
+
+
+def _record_result(chunk: dict, translated: str | None, in_tok: int, out_tok: int,
+                   results: list[tuple[dict, str]]) -> int:
+    """Account for one finished chunk; returns 1 if it was skipped."""
+    if translated is None:
+        usage_tracker.add_skip()
+        return 1
+    usage_tracker.add(in_tok, out_tok)
+    chunk["translated_text"] = translated
+    results.append((chunk, translated))
+    return 0